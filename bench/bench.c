@@ -0,0 +1,580 @@
+/**
+ * @file
+ * @brief Benchmarks of the functions in bignum.h.
+ *
+ * Every operation is timed for numbers of BIGNUM_512 to BIGNUM_4096
+ * elements, which are filled completely, half and with one element
+ * only. If the program is built with -D BENCH_GMP and linked with
+ * -lgmp, the same workloads are run through the GNU MP as a reference.
+ *
+ * The results are written as CSV to stdout:
+ * @code
+ * impl,op,bits,length,iterations,ns_per_op,limbs_per_s
+ * bignum,add,2048,16,4194304,12.3,1.3e+09
+ * @endcode
+ * length is the number of elements of the operands, limbs_per_s is
+ * length divided by the time of one operation.
+ *
+ * The array kernels in use (see bignum_kernels()) are written to stderr,
+ * run with BIGNUM_KERNELS=generic to compare them.
+ *
+ * Usage: bench.out [-t milliseconds] [operation ...]
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bignum.h"
+
+#ifdef BENCH_GMP
+#include <gmp.h>
+#endif
+
+#define BENCH_MAX BIGNUM_4096
+
+/**
+ * @brief Operands of one size and fill level.
+ *
+ * a and b have length elements. d has half of them and m is an odd
+ * modulus of length elements, x and y are less than m. p = x * y is
+ * the input of the modular reductions. bytes holds a as a big-endian
+ * byte string.
+**/
+typedef struct bench_state {
+    size_t bits;
+    size_t n;
+    size_t length;
+
+    bignum_t a, b, d, m, x, y, p, e, r, q;
+    bignum_elem_t a_elem[BENCH_MAX];
+    bignum_elem_t b_elem[BENCH_MAX];
+    bignum_elem_t d_elem[BENCH_MAX];
+    bignum_elem_t m_elem[BENCH_MAX];
+    bignum_elem_t x_elem[BENCH_MAX];
+    bignum_elem_t y_elem[BENCH_MAX];
+    bignum_elem_t p_elem[2*BENCH_MAX];
+    bignum_elem_t e_elem[BENCH_MAX];
+    bignum_elem_t r_elem[2*BENCH_MAX];
+    bignum_elem_t q_elem[2*BENCH_MAX];
+
+    bignum_udiv_ctx_t udiv;
+    bignum_mont_ctx_t mont;
+    bignum_elem_t r2_elem[BENCH_MAX];
+    bignum_barrett_ctx_t barrett;
+    bignum_elem_t mu_elem[BENCH_MAX+2];
+    unsigned char bytes[BENCH_MAX * sizeof(bignum_elem_t)];
+
+    bignum_elem_t scratch[BIGNUM_POWM_SCRATCH(BENCH_MAX) + BIGNUM_MUL_SCRATCH(2*BENCH_MAX) +
+                          BIGNUM_INVERT_SCRATCH(BENCH_MAX)];
+
+#ifdef BENCH_GMP
+    mpz_t ga, gb, gm, ge, gx, gr, gs, gt;
+#endif
+} bench_state_t;
+
+typedef void (*bench_fn_t)(bench_state_t *s, long iterations);
+
+typedef struct bench_case {
+    const char *name;
+    bench_fn_t bignum;
+    bench_fn_t gmp;
+} bench_case_t;
+
+// Results of functions without side effects are added to sink, so
+// the compiler can't drop the calls.
+static volatile bignum_elem_t sink;
+
+static unsigned long long rand_state = 88172645463325252ULL;
+
+static bignum_elem_t rand_elem(void) {
+    // xorshift64, the benchmarks have to be reproducible.
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    return (bignum_elem_t) rand_state;
+}
+
+static void rand_bignum(bignum_t *num, bignum_elem_t *arr, size_t n, size_t length) {
+    // Associate n elements of arr with num and fill length of them.
+    bignum_assoc(num, arr, n);
+    for (size_t i=0; i<n; i++)
+        arr[i] = i < length ? rand_elem() : 0;
+    if (length > 0 && arr[length-1] == 0)
+        arr[length-1] = 1;
+    bignum_sync(num);
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * bignum.h
+**/
+static void bench_cmp(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += bignum_cmp(&s->a, &s->b);
+}
+
+static void bench_set(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_set(&s->r, &s->a);
+}
+
+static void bench_add(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_add(&s->r, &s->a, &s->b);
+}
+
+static void bench_add_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_add_ui(&s->r, &s->a, 12345);
+}
+
+static void bench_mul(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mul(&s->r, &s->a, &s->b);
+}
+
+static void bench_mul_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mul_ui(&s->r, &s->a, 12345);
+}
+
+static void bench_sqr(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_sqr(&s->r, &s->a);
+}
+
+static void bench_mullo(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mullo(&s->r, &s->a, &s->b, s->length);
+}
+
+static void bench_mulhi(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mulhi(&s->r, &s->a, &s->b, s->length, s->scratch);
+}
+
+static void bench_fixed_add(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++) {
+        switch (s->bits) {
+            case 512: bignum512_add(s->r_elem, s->a_elem, s->b_elem); break;
+            case 1024: bignum1024_add(s->r_elem, s->a_elem, s->b_elem); break;
+            case 2048: bignum2048_add(s->r_elem, s->a_elem, s->b_elem); break;
+            default: bignum4096_add(s->r_elem, s->a_elem, s->b_elem); break;
+        }
+    }
+}
+
+static void bench_fixed_mul(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++) {
+        switch (s->bits) {
+            case 512: bignum512_mul(s->r_elem, s->a_elem, s->b_elem); break;
+            case 1024: bignum1024_mul(s->r_elem, s->a_elem, s->b_elem); break;
+            case 2048: bignum2048_mul(s->r_elem, s->a_elem, s->b_elem); break;
+            default: bignum4096_mul(s->r_elem, s->a_elem, s->b_elem); break;
+        }
+    }
+}
+
+static void bench_fixed_sqr(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++) {
+        switch (s->bits) {
+            case 512: bignum512_sqr(s->r_elem, s->a_elem); break;
+            case 1024: bignum1024_sqr(s->r_elem, s->a_elem); break;
+            case 2048: bignum2048_sqr(s->r_elem, s->a_elem); break;
+            default: bignum4096_sqr(s->r_elem, s->a_elem); break;
+        }
+    }
+}
+
+static void bench_divmod_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_divmod_ui(&s->q, &s->a, s->udiv.d);
+}
+
+static void bench_mod_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += bignum_mod_ui(&s->a, s->udiv.d);
+}
+
+static void bench_mod_ui_pre(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += bignum_mod_ui_pre(&s->a, &s->udiv);
+}
+
+static void bench_mod_ui_multi(bench_state_t *s, long iterations) {
+    // The odd moduli 3 to 129, about the work of sieving by 64 primes.
+    bignum_elem_t moduli[64], out[64];
+    for (size_t j=0; j<64; j++)
+        moduli[j] = 2*j + 3;
+    for (long i=0; i<iterations; i++) {
+        bignum_mod_ui_multi(&s->a, moduli, out, 64);
+        sink += out[0];
+    }
+}
+
+static void bench_divmod(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_divmod(&s->q, &s->r, &s->a, &s->d, s->scratch);
+}
+
+static void bench_mod(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mod(&s->r, &s->a, &s->d, s->scratch);
+}
+
+static void bench_lshift(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_lshift(&s->r, &s->a, 13);
+}
+
+static void bench_rshift(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_rshift(&s->r, &s->a, 13);
+}
+
+static void bench_mont_mul(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mont_mul(&s->r, &s->x, &s->y, &s->mont, s->scratch);
+}
+
+static void bench_mont_sqr(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mont_sqr(&s->r, &s->x, &s->mont, s->scratch);
+}
+
+static void bench_powm(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_powm(&s->r, &s->x, &s->e, &s->mont, s->scratch);
+}
+
+static void bench_mod_barrett(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_mod_barrett(&s->r, &s->p, &s->barrett, s->scratch);
+}
+
+static void bench_gcd(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_gcd(&s->r, &s->a, &s->b, s->scratch);
+}
+
+static void bench_gcdext(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_gcdext(&s->r, &s->q, &s->p, &s->a, &s->b, s->scratch);
+}
+
+static void bench_invert(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_invert(&s->r, &s->x, &s->m, s->scratch);
+}
+
+static void bench_miller_rabin(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += bignum_miller_rabin(&s->m, 2, s->scratch);
+}
+
+static void bench_import(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_import(&s->r, s->bytes, s->length * sizeof(bignum_elem_t), 1, 1, 0);
+}
+
+static void bench_export(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        bignum_export(s->bytes, s->length * sizeof(bignum_elem_t), 1, 1, 0, &s->a);
+}
+
+/*
+ * GNU MP reference
+ *
+ * The closest mpn function for every operation. There is no public
+ * Montgomery multiplication or Barrett reduction, mont_mul, mont_sqr
+ * and mod_barrett are compared with a product and mpn_tdiv_qr().
+**/
+#ifdef BENCH_GMP
+#define LIMBS(arr) ((mp_limb_t *) (arr))
+
+static void gmp_cmp(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += mpn_cmp(LIMBS(s->a_elem), LIMBS(s->b_elem), s->length);
+}
+
+static void gmp_set(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_copyi(LIMBS(s->r_elem), LIMBS(s->a_elem), s->length);
+}
+
+static void gmp_add(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_add_n(LIMBS(s->r_elem), LIMBS(s->a_elem), LIMBS(s->b_elem), s->length);
+}
+
+static void gmp_add_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_add_1(LIMBS(s->r_elem), LIMBS(s->a_elem), s->length, 12345);
+}
+
+static void gmp_mul(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_mul_n(LIMBS(s->r_elem), LIMBS(s->a_elem), LIMBS(s->b_elem), s->length);
+}
+
+static void gmp_mul_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_mul_1(LIMBS(s->r_elem), LIMBS(s->a_elem), s->length, 12345);
+}
+
+static void gmp_sqr(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_sqr(LIMBS(s->r_elem), LIMBS(s->a_elem), s->length);
+}
+
+static void gmp_divmod_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_divrem_1(LIMBS(s->q_elem), 0, LIMBS(s->a_elem), s->length, s->udiv.d);
+}
+
+static void gmp_mod_ui(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += mpn_mod_1(LIMBS(s->a_elem), s->length, s->udiv.d);
+}
+
+static void gmp_lshift(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += mpn_lshift(LIMBS(s->r_elem), LIMBS(s->a_elem), s->length, 13);
+}
+
+static void gmp_rshift(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        sink += mpn_rshift(LIMBS(s->r_elem), LIMBS(s->a_elem), s->length, 13);
+}
+
+static void gmp_divmod(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_tdiv_qr(LIMBS(s->q_elem), LIMBS(s->r_elem), 0,
+                    LIMBS(s->a_elem), s->length, LIMBS(s->d_elem), s->d.length);
+}
+
+static void gmp_mulmod(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++) {
+        mpn_mul_n(LIMBS(s->p_elem), LIMBS(s->x_elem), LIMBS(s->y_elem), s->length);
+        mpn_tdiv_qr(LIMBS(s->q_elem), LIMBS(s->r_elem), 0,
+                    LIMBS(s->p_elem), 2*s->length, LIMBS(s->m_elem), s->length);
+    }
+}
+
+static void gmp_sqrmod(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++) {
+        mpn_sqr(LIMBS(s->p_elem), LIMBS(s->x_elem), s->length);
+        mpn_tdiv_qr(LIMBS(s->q_elem), LIMBS(s->r_elem), 0,
+                    LIMBS(s->p_elem), 2*s->length, LIMBS(s->m_elem), s->length);
+    }
+}
+
+static void gmp_powm(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpz_powm(s->gr, s->gx, s->ge, s->gm);
+}
+
+static void gmp_mod_barrett(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpn_tdiv_qr(LIMBS(s->q_elem), LIMBS(s->r_elem), 0,
+                    LIMBS(s->p_elem), 2*s->length, LIMBS(s->m_elem), s->length);
+}
+
+static void gmp_gcd(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpz_gcd(s->gr, s->ga, s->gb);
+}
+
+static void gmp_gcdext(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpz_gcdext(s->gr, s->gs, s->gt, s->ga, s->gb);
+}
+
+static void gmp_invert(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpz_invert(s->gr, s->gx, s->gm);
+}
+
+static void gmp_import(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpz_import(s->gr, s->length * sizeof(bignum_elem_t), 1, 1, 0, 0, s->bytes);
+}
+
+static void gmp_export(bench_state_t *s, long iterations) {
+    for (long i=0; i<iterations; i++)
+        mpz_export(s->bytes, NULL, 1, 1, 0, 0, s->ga);
+}
+
+#define GMP(fn) fn
+#else
+#define GMP(fn) NULL
+#endif
+
+static const bench_case_t bench_cases[] = {
+    {"cmp", bench_cmp, GMP(gmp_cmp)},
+    {"set", bench_set, GMP(gmp_set)},
+    {"add", bench_add, GMP(gmp_add)},
+    {"add_ui", bench_add_ui, GMP(gmp_add_ui)},
+    {"mul", bench_mul, GMP(gmp_mul)},
+    {"mul_ui", bench_mul_ui, GMP(gmp_mul_ui)},
+    {"sqr", bench_sqr, GMP(gmp_sqr)},
+    {"mullo", bench_mullo, NULL},
+    {"mulhi", bench_mulhi, NULL},
+    {"fixed_add", bench_fixed_add, GMP(gmp_add)},
+    {"fixed_mul", bench_fixed_mul, GMP(gmp_mul)},
+    {"fixed_sqr", bench_fixed_sqr, GMP(gmp_sqr)},
+    {"divmod_ui", bench_divmod_ui, GMP(gmp_divmod_ui)},
+    {"mod_ui", bench_mod_ui, GMP(gmp_mod_ui)},
+    {"mod_ui_pre", bench_mod_ui_pre, GMP(gmp_mod_ui)},
+    {"mod_ui_multi", bench_mod_ui_multi, NULL},
+    {"divmod", bench_divmod, GMP(gmp_divmod)},
+    {"mod", bench_mod, GMP(gmp_divmod)},
+    {"lshift", bench_lshift, GMP(gmp_lshift)},
+    {"rshift", bench_rshift, GMP(gmp_rshift)},
+    {"mont_mul", bench_mont_mul, GMP(gmp_mulmod)},
+    {"mont_sqr", bench_mont_sqr, GMP(gmp_sqrmod)},
+    {"powm", bench_powm, GMP(gmp_powm)},
+    {"mod_barrett", bench_mod_barrett, GMP(gmp_mod_barrett)},
+    {"gcd", bench_gcd, GMP(gmp_gcd)},
+    {"gcdext", bench_gcdext, GMP(gmp_gcdext)},
+    {"invert", bench_invert, GMP(gmp_invert)},
+    {"miller_rabin", bench_miller_rabin, NULL},
+    {"import", bench_import, GMP(gmp_import)},
+    {"export", bench_export, GMP(gmp_export)},
+};
+
+static void setup(bench_state_t *s, size_t bits, size_t length) {
+    // Set up all operands of s for numbers of the given size.
+    size_t n = bits / (8 * sizeof(bignum_elem_t));
+
+    s->bits = bits;
+    s->n = n;
+    s->length = length;
+
+    rand_bignum(&s->a, s->a_elem, n, length);
+    rand_bignum(&s->b, s->b_elem, n, length);
+    rand_bignum(&s->d, s->d_elem, n, (length + 1) / 2);
+    rand_bignum(&s->m, s->m_elem, n, length);
+    rand_bignum(&s->e, s->e_elem, n, length);
+    s->m_elem[0] |= 1;
+    s->m_elem[length-1] |= (bignum_elem_t) 1 << (BIGNUM_ELEM_SIZE * 8 - 1);
+
+    bignum_assoc(&s->r, s->r_elem, 2*n);
+    bignum_assoc(&s->q, s->q_elem, 2*n);
+    bignum_assoc(&s->p, s->p_elem, 2*n);
+
+    // x, y < m
+    rand_bignum(&s->x, s->x_elem, n, length);
+    rand_bignum(&s->y, s->y_elem, n, length);
+    bignum_mod(&s->x, &s->x, &s->m, s->scratch);
+    bignum_mod(&s->y, &s->y, &s->m, s->scratch);
+    bignum_write(&s->x);
+    bignum_write(&s->y);
+    bignum_mul(&s->p, &s->x, &s->y);
+    bignum_write(&s->p);
+
+    bignum_udiv_init(&s->udiv, rand_elem() | 1);
+    bignum_mont_init(&s->mont, &s->m, s->r2_elem);
+    bignum_barrett_init(&s->barrett, &s->m, s->mu_elem, s->scratch);
+    bignum_export(s->bytes, length * sizeof(bignum_elem_t), 1, 1, 0, &s->a);
+
+#ifdef BENCH_GMP
+    mpz_import(s->ga, length, -1, sizeof(bignum_elem_t), 0, 0, s->a_elem);
+    mpz_import(s->gb, length, -1, sizeof(bignum_elem_t), 0, 0, s->b_elem);
+    mpz_import(s->gm, length, -1, sizeof(bignum_elem_t), 0, 0, s->m_elem);
+    mpz_import(s->ge, length, -1, sizeof(bignum_elem_t), 0, 0, s->e_elem);
+    mpz_import(s->gx, length, -1, sizeof(bignum_elem_t), 0, 0, s->x_elem);
+#endif
+}
+
+static double measure(bench_fn_t fn, bench_state_t *s, double min_time, long *iterations) {
+    // Return the time of one call in seconds. The number of iterations
+    // is doubled until they take at least min_time seconds.
+    long n = 1;
+    double elapsed;
+
+    fn(s, 1);
+    for (;;) {
+        elapsed = now();
+        fn(s, n);
+        elapsed = now() - elapsed;
+        if (elapsed >= min_time || n >= (1L << 40))
+            break;
+        n *= 2;
+    }
+    *iterations = n;
+    return elapsed / n;
+}
+
+static void report(const char *impl, const char *op, const bench_state_t *s,
+                   long iterations, double t) {
+    printf("%s,%s,%zu,%zu,%ld,%.1f,%.4g\n", impl, op, s->bits, s->length,
+           iterations, t * 1e9, s->length / t);
+}
+
+static int selected(const char *name, int argc, char **argv, int first) {
+    // Return 1, if name is in argv[first..argc) or no names are given.
+    if (first >= argc)
+        return 1;
+    for (int i=first; i<argc; i++)
+        if (strcmp(argv[i], name) == 0)
+            return 1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static bench_state_t s;
+    static const size_t sizes[] = {512, 1024, 2048, 4096};
+    double min_time = 0.02;
+    double t;
+    long iterations;
+    int first = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+        min_time = atof(argv[2]) / 1000;
+        first = 3;
+    }
+
+#ifdef BENCH_GMP
+    if (sizeof(mp_limb_t) != sizeof(bignum_elem_t)) {
+        fprintf(stderr, "bignum_elem_t and mp_limb_t differ in size.\n");
+        return 1;
+    }
+    mpz_inits(s.ga, s.gb, s.gm, s.ge, s.gx, s.gr, s.gs, s.gt, NULL);
+#endif
+
+    fprintf(stderr, "Kernels: %s\n", bignum_kernels());
+    printf("impl,op,bits,length,iterations,ns_per_op,limbs_per_s\n");
+    for (size_t i=0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t n = sizes[i] / (8 * sizeof(bignum_elem_t));
+        size_t lengths[] = {n, n / 2, 1};
+
+        for (size_t j=0; j<3; j++) {
+            setup(&s, sizes[i], lengths[j]);
+            for (size_t k=0; k < sizeof(bench_cases) / sizeof(bench_cases[0]); k++) {
+                const bench_case_t *c = &bench_cases[k];
+                if (!selected(c->name, argc, argv, first))
+                    continue;
+
+                t = measure(c->bignum, &s, min_time, &iterations);
+                report("bignum", c->name, &s, iterations, t);
+                if (c->gmp != NULL) {
+                    t = measure(c->gmp, &s, min_time, &iterations);
+                    report("gmp", c->name, &s, iterations, t);
+                }
+                fflush(stdout);
+            }
+        }
+    }
+
+#ifdef BENCH_GMP
+    mpz_clears(s.ga, s.gb, s.gm, s.ge, s.gx, s.gr, s.gs, s.gt, NULL);
+#endif
+    return 0;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file
+ * @brief Throughput of the batch kernels in bignum_kernels.cl.
+ *
+ * Builds src/bignum_kernels.cl for the first device of the selected
+ * platform and runs every batch kernel over count random numbers with
+ * a single NDRange launch. The times are taken from the profiling
+ * events of the queue and written as CSV to stdout:
+ * @code
+ * kernel,bits,count,build_s,write_s,compute_s,read_s,numbers_per_s,total_numbers_per_s
+ * @endcode
+ * numbers_per_s only counts the kernel itself, total_numbers_per_s
+ * includes the transfers to and from the device.
+ *
+ * Usage: cl_bench.out [-p platform] [-n count] [-b bits] [-l local size]
+ *                     [-c cache directory]
+ *
+ * With -c the program binary is cached (see bignum_cl_build()), so
+ * build_s shows the startup time of later runs.
+ *
+ * The OpenCL compiler is invoked with -I src, so this has to be run
+ * from the directory above (..).
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bignum_cl.h"
+
+/**
+ * @brief A batch kernel and its buffers.
+ *
+ * Every kernel reads one or two batches of numbers. The result is
+ * either a batch of numbers or one value of result_size bytes per
+ * number. Kernels with an overflow flag get an int per number.
+**/
+typedef struct bench_kernel {
+    const char *name;
+    int operands;
+    int result_is_batch;
+    size_t result_size;
+    int has_overflow;
+} bench_kernel_t;
+
+static const bench_kernel_t bench_kernels[] = {
+    {"bignum_batch_add", 2, 1, 0, 1},
+    {"bignum_batch_mul", 2, 1, 0, 1},
+    {"bignum_batch_mod_ui", 1, 0, sizeof(cl_ulong), 0},
+    {"bignum_batch_cmp", 2, 0, sizeof(cl_int), 0},
+};
+
+void exit_with_error(int errorcode, char *msg) {
+    fprintf(stderr, "%s\n", msg);
+    fprintf(stderr, "errorcode: %d\n", errorcode);
+    exit(errorcode);
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static double event_seconds(cl_event event) {
+    // Wait for event and return the time it took on the device.
+    cl_ulong start, end;
+    clWaitForEvents(1, &event);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    clReleaseEvent(event);
+    return (end - start) * 1e-9;
+}
+
+static void fill_random(cl_ulong *arr, size_t n) {
+    // xorshift64, the benchmarks have to be reproducible.
+    static cl_ulong state = 88172645463325252ULL;
+    for (size_t i=0; i<n; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        arr[i] = state;
+    }
+}
+
+static cl_program build(cl_context context, cl_device_id device, size_t elements,
+                        const char *cache_dir, double *seconds) {
+    // Build bignum_kernels.cl with BIGNUM_BATCH_ELEMENTS = elements.
+    cl_int ret;
+    double start = now();
+
+    cl_program program = bignum_cl_build_kernels(context, device, "src", NULL,
+                                                 elements, cache_dir, &ret);
+    if (program == NULL)
+        exit_with_error(ret, "Building the kernels failed.");
+
+    *seconds = now() - start;
+    return program;
+}
+
+static void run(const bench_kernel_t *bk, cl_context context, cl_command_queue queue,
+                cl_program program, size_t elements, cl_ulong count, size_t local_size,
+                double build_seconds) {
+    // Run bk once over count numbers and print the times.
+    size_t batch_size = elements * count * sizeof(cl_ulong);
+    size_t result_size = bk->result_is_batch ? batch_size : bk->result_size * count;
+    double write_seconds = 0, compute_seconds, read_seconds;
+    cl_mem operands[2], result, overflow = NULL;
+    cl_event event;
+    cl_int ret;
+    cl_uint arg = 0;
+
+    cl_ulong *host = malloc(batch_size > result_size ? batch_size : result_size);
+    if (host == NULL)
+        exit_with_error(CL_OUT_OF_HOST_MEMORY, "Couldn't allocate host memory.");
+
+    cl_kernel kernel = clCreateKernel(program, bk->name, &ret);
+    if (ret != CL_SUCCESS)
+        exit_with_error(ret, "clCreateKernel() failed.");
+
+    result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, result_size, NULL, &ret);
+    if (ret != CL_SUCCESS)
+        exit_with_error(ret, "Could not create the result buffer.");
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &result);
+
+    for (int i=0; i<bk->operands; i++) {
+        operands[i] = clCreateBuffer(context, CL_MEM_READ_ONLY, batch_size, NULL, &ret);
+        if (ret != CL_SUCCESS)
+            exit_with_error(ret, "Could not create an operand buffer.");
+
+        fill_random(host, elements * count);
+        ret = clEnqueueWriteBuffer(queue, operands[i], CL_TRUE, 0, batch_size,
+                                   host, 0, NULL, &event);
+        if (ret != CL_SUCCESS)
+            exit_with_error(ret, "Could not write an operand buffer.");
+        write_seconds += event_seconds(event);
+        clSetKernelArg(kernel, arg++, sizeof(cl_mem), &operands[i]);
+    }
+
+    if (bk->has_overflow) {
+        overflow = clCreateBuffer(context, CL_MEM_WRITE_ONLY, count * sizeof(cl_int), NULL, &ret);
+        if (ret != CL_SUCCESS)
+            exit_with_error(ret, "Could not create the overflow buffer.");
+        clSetKernelArg(kernel, arg++, sizeof(cl_mem), &overflow);
+    }
+    else if (!bk->result_is_batch && bk->result_size == sizeof(cl_ulong)) {
+        // bignum_batch_mod_ui() takes the divisor.
+        cl_ulong d = 0xfffffffb;
+        clSetKernelArg(kernel, arg++, sizeof(d), &d);
+    }
+    clSetKernelArg(kernel, arg++, sizeof(count), &count);
+
+    // The kernels ignore work-items beyond count.
+    size_t global_size = count;
+    if (local_size > 0)
+        global_size = (count + local_size - 1) / local_size * local_size;
+
+    ret = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+                                 local_size > 0 ? &local_size : NULL, 0, NULL, &event);
+    if (ret != CL_SUCCESS)
+        exit_with_error(ret, "clEnqueueNDRangeKernel() failed.");
+    compute_seconds = event_seconds(event);
+
+    ret = clEnqueueReadBuffer(queue, result, CL_TRUE, 0, result_size, host, 0, NULL, &event);
+    if (ret != CL_SUCCESS)
+        exit_with_error(ret, "Could not read the result buffer.");
+    read_seconds = event_seconds(event);
+
+    printf("%s,%zu,%lu,%.3f,%.6f,%.6f,%.6f,%.4g,%.4g\n", bk->name,
+           elements * sizeof(cl_ulong) * 8, (unsigned long) count, build_seconds,
+           write_seconds, compute_seconds, read_seconds, count / compute_seconds,
+           count / (write_seconds + compute_seconds + read_seconds));
+    fflush(stdout);
+
+    for (int i=0; i<bk->operands; i++)
+        clReleaseMemObject(operands[i]);
+    if (overflow != NULL)
+        clReleaseMemObject(overflow);
+    clReleaseMemObject(result);
+    clReleaseKernel(kernel);
+    free(host);
+}
+
+int main(int argc, char **argv) {
+    cl_uint platform_index = 0;
+    cl_ulong count = 1 << 20;
+    size_t bits = 2048;
+    size_t local_size = 64;
+    const char *cache_dir = NULL;
+
+    for (int i=1; i+1<argc; i+=2) {
+        if (strcmp(argv[i], "-p") == 0)
+            platform_index = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            count = strtoull(argv[i+1], NULL, 10);
+        else if (strcmp(argv[i], "-b") == 0)
+            bits = strtoul(argv[i+1], NULL, 10);
+        else if (strcmp(argv[i], "-l") == 0)
+            local_size = strtoul(argv[i+1], NULL, 10);
+        else if (strcmp(argv[i], "-c") == 0)
+            cache_dir = argv[i+1];
+        else {
+            fprintf(stderr, "Usage: %s [-p platform] [-n count] [-b bits] "
+                    "[-l local size] [-c cache directory]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (count == 0 || bits < 64 || bits % 64 != 0) {
+        fprintf(stderr, "count has to be positive and bits a multiple of 64.\n");
+        return 1;
+    }
+
+    /*
+     *  Setup OpenCL.
+     */
+    cl_platform_id platforms[16];
+    cl_uint num_platforms;
+    cl_device_id device_id;
+    cl_uint num_devices;
+    char device_name[256];
+
+    cl_int ret = clGetPlatformIDs(16, platforms, &num_platforms);
+    if (ret != CL_SUCCESS || platform_index >= num_platforms)
+        exit_with_error(ret, "clGetPlatformIDs() failed or no such platform.");
+
+    ret = clGetDeviceIDs(platforms[platform_index], CL_DEVICE_TYPE_ALL, 1,
+                         &device_id, &num_devices);
+    if (ret != CL_SUCCESS)
+        exit_with_error(ret, "clGetDeviceIDs() failed.");
+
+    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
+    fprintf(stderr, "Device: %s\n", device_name);
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &ret);
+    if (ret != CL_SUCCESS)
+        exit_with_error(ret, "clCreateContext() failed.");
+
+    cl_command_queue queue = clCreateCommandQueue(context, device_id,
+                                                  CL_QUEUE_PROFILING_ENABLE, &ret);
+    if (ret != CL_SUCCESS)
+        exit_with_error(ret, "clCreateCommandQueue() failed.");
+
+    double build_seconds;
+    size_t elements = bits / (8 * sizeof(cl_ulong));
+    cl_program program = build(context, device_id, elements, cache_dir, &build_seconds);
+
+    printf("kernel,bits,count,build_s,write_s,compute_s,read_s,"
+           "numbers_per_s,total_numbers_per_s\n");
+    for (size_t i=0; i < sizeof(bench_kernels) / sizeof(bench_kernels[0]); i++)
+        run(&bench_kernels[i], context, queue, program, elements, count,
+            local_size, build_seconds);
+
+    clReleaseProgram(program);
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
+    return 0;
+}
@@ -1,22 +1,36 @@
 #include "bignum.h"
 
+#if !defined(__OPENCL_VERSION__) && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#if !defined(__OPENCL_VERSION__) && defined(__x86_64__) && defined(__GNUC__) && \
+    !defined(BIGNUM_NO_DISPATCH)
+// Select the array kernels at load time, see select_kernels().
+#define BIGNUM_DISPATCH
+#include <stdlib.h>
+#include <string.h>
+#endif
+
 /*
  * Memory association and handling:
- *  - bignum_assoc()
+ *  - bignum_assoc(), bignum_assoc_len()
+ *  - bignum_load_interleaved(), bignum_store_interleaved()
  *  - bignum_sync() -> TODO: Rename to bignum_read
+ *  - bignum_write()
  *  - bignum_zero()
- *  TODO: Add bignum_write
 **/
 void bignum_sync(bignum_t *num) {
     // Synchronize bignum metadata with the underlying memory.
-    num->length = 0;
-    for (int i=0; i < num->max_length; i++)
-        if (num->v[i] != 0)
-            num->length = i+1;
+    // Scan from the top, so a number using all elements is found at once.
+    size_t length = num->max_length;
+    while (length > 0 && num->v[length-1] == 0)
+        length--;
+    num->length = length;
 }
 
 void bignum_write(bignum_t *num) {
-    for (int i=num->length; i < num->max_length; i++)
+    for (size_t i=num->length; i < num->max_length; i++)
         num->v[i] = 0;
 }
 
@@ -34,10 +48,48 @@ void bignum_assoc_at(bignum_t *num, bignum_elem_t *arr, const size_t num_element
     bignum_sync(num);
 }
 
+void bignum_assoc_len(bignum_t *num, bignum_elem_t *arr, const size_t num_elements,
+                      const size_t length) {
+    // Associate num_elements in arr with num, which has length elements.
+    num->max_length = num_elements;
+    num->v = arr;
+    num->length = length < num_elements ? length : num_elements;
+}
+
+void bignum_assoc_at_len(bignum_t *num, bignum_elem_t *arr, const size_t num_elements,
+                         const size_t index, const size_t length) {
+    // Associate num_elements in arr with num, which has length elements.
+    bignum_assoc_len(num, &arr[num_elements*index], num_elements, length);
+}
+
+void bignum_load_interleaved(bignum_t *num, bignum_elem_t *arr, const bignum_elem_t *batch,
+                             const size_t num_elements, const size_t count, const size_t index) {
+    // Copy number index of an interleaved batch to arr and associate
+    // num_elements in arr with num. The length is found while copying.
+    size_t length = 0;
+    for (size_t i=0; i < num_elements; i++) {
+        arr[i] = batch[i*count + index];
+        if (arr[i] != 0)
+            length = i + 1;
+    }
+    bignum_assoc_len(num, arr, num_elements, length);
+}
+
+void bignum_store_interleaved(bignum_elem_t *batch, bignum_t *num,
+                              const size_t count, const size_t index) {
+    // Copy num to number index of an interleaved batch. The elements
+    // above num->length are zero in the batch, num->v is not changed.
+    for (size_t i=0; i < num->max_length; i++)
+        batch[i*count + index] = i < num->length ? num->v[i] : 0;
+}
+
 void bignum_zero(bignum_t *num) {
     // Zero out all memory associated with num.
-    for (int i=0; i < num->max_length; i++)
+    // With BIGNUM_LAZY_ZERO only the length is set.
+#ifndef BIGNUM_LAZY_ZERO
+    for (size_t i=0; i < num->max_length; i++)
         num->v[i] = 0;
+#endif
     num->length = 0;
 }
 
@@ -124,325 +176,3167 @@ int bignum_cmp_ui(const bignum_t *op1, const bignum_elem_t op2) {
         return 0;
 }
 
+static inline bignum_elem_t lo(bignum_elem_t elem) {
+    // Return the value of the lower bits of elem.
+    return elem & BIGNUM_ELEM_LO;
+}
+
+static inline bignum_elem_t hi(bignum_elem_t elem) {
+    // Return the value of the higher bits of elem.
+    return (elem & BIGNUM_ELEM_HI) >> BIGNUM_ELEM_SIZE * 4;
+}
+
 /*
- *  Calculating big numbers
+ * Operations on raw element arrays:
+ *  - mul_elem(), add_elem(), sub_elem()
+ *  - add_n(), add_1(), sub_n(), sub_1()
+ *  - mul_1(), addmul_1(), submul_1()
+ *  - mul_basecase_lo(), sqr_basecase(), mul_karatsuba(), mul_full()
+ *  - cmp_n(), count_leading_zeros(), count_trailing_zeros()
+ *  - popcount_elem(), bit_length()
+ *  - lshift_n(), rshift_n(), div_elem()
+ *  - reciprocal(), div_elem_preinv()
+ *
+ * These work on plain arrays of n elements, ignore any bignum_t metadata
+ * and are used to implement the bignum_t functions.
 **/
-int bignum_add(bignum_t *rop, const bignum_t *op1, const bignum_t *op2) {
-    // rop = op1 + op2
-    // Return 1, if the operation caused an overflow and 0 otherwise.
-    int carry = 0;
-    bignum_elem_t result;
-    const bignum_t *shorter, *longer;
-    size_t length = 0;
+static inline size_t normalized_length(const bignum_elem_t *v, size_t n) {
+    // Return the number of elements of v without leading zeros.
+    while (n > 0 && v[n-1] == 0)
+        n--;
+    return n;
+}
 
-    // Find longer operand.
-    if (op1->length > op2->length) {
-        shorter = op2;
-        longer = op1;
-    }
-    else {
-        shorter = op1;
-        longer = op2;
+static int cmp_n(const bignum_elem_t *ap, const bignum_elem_t *bp, size_t n) {
+    // Returns -1 if ap < bp, 1 if ap > bp and 0 if both are equal.
+    for (size_t i=n; i>0; i--) {
+        if (ap[i-1] != bp[i-1])
+            return ap[i-1] < bp[i-1] ? -1 : 1;
     }
+    return 0;
+}
 
-    // Calculate the maximum length.
-    size_t max_length;
-    if (longer->length + 1 > rop->max_length)
-        max_length = rop->max_length;
-    else
-        max_length = longer->length + 1;
+static inline int count_leading_zeros(bignum_elem_t x) {
+    // Return the number of leading zero bits of x (x > 0).
+#ifdef __OPENCL_VERSION__
+    return clz(x);
+#else
+    return __builtin_clzll((unsigned long long) x) -
+           (int) (sizeof(unsigned long long) - BIGNUM_ELEM_SIZE) * 8;
+#endif
+}
 
-    // Add all numbers from the shorter and longer operand
-    int i;
-    for (i=0; i < shorter->length && i<max_length; i++) {
-        result = carry + shorter->v[i] + longer->v[i];
-        if (result < shorter->v[i]) {
-            if (result > 0)
-                length = i + 1;
-            carry = 1;
-        }
-        else {
-            length = i + 1;
-            carry = 0;
-        }
-        rop->v[i] = result;
-    }
+static inline int count_trailing_zeros(bignum_elem_t x) {
+    // Return the number of trailing zero bits of x (x > 0).
+#ifdef __OPENCL_VERSION__
+    // ctz() needs OpenCL C 2.0, x & -x is the lowest set bit.
+    return BIGNUM_ELEM_SIZE * 8 - 1 - clz((bignum_elem_t) (x & (0 - x)));
+#else
+    return __builtin_ctzll((unsigned long long) x);
+#endif
+}
 
-    // Add all numbers from the longer operand.
-    for (i=shorter->length; i < longer->length && i<max_length; i++) {
-        result = carry + longer->v[i];
-        if (result < longer->v[i]) {
-            if (result > 0)
-                length = i + 1;
-            carry = 1;
-        }
-        else {
-            length = i + 1;
-            carry = 0;
-        }
-        rop->v[i] = result;
+static inline int popcount_elem(bignum_elem_t x) {
+    // Return the number of set bits of x.
+#ifdef __OPENCL_VERSION__
+    return popcount(x);
+#else
+    return __builtin_popcountll((unsigned long long) x);
+#endif
+}
+
+static inline size_t bit_length(const bignum_elem_t *ap, size_t n) {
+    // The number of bits of ap > 0 without leading zeros.
+    return n * BIGNUM_ELEM_SIZE * 8 - count_leading_zeros(ap[n-1]);
+}
+
+static inline bignum_elem_t mul_elem(bignum_elem_t a, bignum_elem_t b, bignum_elem_t *high) {
+    // Return the lower element of a * b and store the higher one in high.
+#if defined(__OPENCL_VERSION__)
+    *high = mul_hi(a, b);
+    return a * b;
+#elif defined(BIGNUM_DELEM_TYPE)
+    BIGNUM_DELEM_TYPE product = (BIGNUM_DELEM_TYPE) a * b;
+    *high = (bignum_elem_t) (product >> BIGNUM_ELEM_SIZE * 8);
+    return (bignum_elem_t) product;
+#else
+    // No wider type available: Multiply the half sized values.
+    bignum_elem_t lo1 = lo(a), hi1 = hi(a);
+    bignum_elem_t lo2 = lo(b), hi2 = hi(b);
+
+    bignum_elem_t ll = lo1 * lo2;
+    bignum_elem_t lh = lo1 * hi2;
+    bignum_elem_t hl = hi1 * lo2;
+
+    // Three half sized values always fit into an element.
+    bignum_elem_t mid = hi(ll) + lo(lh) + lo(hl);
+
+    *high = hi1 * hi2 + hi(lh) + hi(hl) + hi(mid);
+    return (mid << BIGNUM_ELEM_SIZE * 4) | lo(ll);
+#endif
+}
+
+static inline bignum_elem_t add_elem(bignum_elem_t a, bignum_elem_t b,
+                                     bignum_elem_t carry, bignum_elem_t *carry_out) {
+    // Return a + b + carry (carry is 0 or 1) and store the new carry
+    // in carry_out.
+    //
+    // The intrinsics let the compiler chain the carry flag (adc)
+    // instead of comparing. Their type is fixed, so they're only used,
+    // if it matches BIGNUM_ELEM_SIZE; the condition is constant.
+#if !defined(__OPENCL_VERSION__) && defined(__has_builtin)
+#if __has_builtin(__builtin_addcll)
+    if (BIGNUM_ELEM_SIZE == sizeof(unsigned long long)) {
+        unsigned long long c;
+        bignum_elem_t s = __builtin_addcll(a, b, carry, &c);
+        *carry_out = c;
+        return s;
+    }
+#endif
+#endif
+#if !defined(__OPENCL_VERSION__) && defined(__x86_64__)
+    if (BIGNUM_ELEM_SIZE == sizeof(unsigned long long)) {
+        unsigned long long s;
+        *carry_out = _addcarry_u64((unsigned char) carry, a, b, &s);
+        return s;
     }
+#endif
+    bignum_elem_t s = a + b;
+    bignum_elem_t c = s < a;
+    s += carry;
+    *carry_out = c | (s < carry);
+    return s;
+}
 
-    if (carry != 0 && max_length > longer->length) {
-        rop->v[longer->length] = carry;
-        length = longer->length + 1;
-        carry = 0;
+static inline bignum_elem_t sub_elem(bignum_elem_t a, bignum_elem_t b,
+                                     bignum_elem_t borrow, bignum_elem_t *borrow_out) {
+    // Return a - b - borrow (borrow is 0 or 1) and store the new borrow
+    // in borrow_out.
+#if !defined(__OPENCL_VERSION__) && defined(__has_builtin)
+#if __has_builtin(__builtin_subcll)
+    if (BIGNUM_ELEM_SIZE == sizeof(unsigned long long)) {
+        unsigned long long c;
+        bignum_elem_t s = __builtin_subcll(a, b, borrow, &c);
+        *borrow_out = c;
+        return s;
     }
+#endif
+#endif
+#if !defined(__OPENCL_VERSION__) && defined(__x86_64__)
+    if (BIGNUM_ELEM_SIZE == sizeof(unsigned long long)) {
+        unsigned long long s;
+        *borrow_out = _subborrow_u64((unsigned char) borrow, a, b, &s);
+        return s;
+    }
+#endif
+    bignum_elem_t s = a - b;
+    bignum_elem_t c = a < b;
+    *borrow_out = c | (s < borrow);
+    return s - borrow;
+}
 
-    rop->length = length;
+static bignum_elem_t add_n_generic(bignum_elem_t *rp, const bignum_elem_t *ap,
+                                   const bignum_elem_t *bp, size_t n) {
+    // rp = ap + bp, returns carry.
+    bignum_elem_t carry = 0;
+    for (size_t i=0; i<n; i++)
+        rp[i] = add_elem(ap[i], bp[i], carry, &carry);
     return carry;
 }
 
-int bignum_add_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2) {
-    int carry = 0;
-    bignum_elem_t result;
+static bignum_elem_t add_1(bignum_elem_t *rp, const bignum_elem_t *ap,
+                           size_t n, bignum_elem_t b) {
+    // rp = ap + b, returns carry (or b, if n is 0).
+    for (size_t i=0; i<n; i++)
+        rp[i] = add_elem(ap[i], b, 0, &b);
+    return b;
+}
 
-    // Calculate the maximum length.
-    size_t max_length;
-    if (op1->length + 1 > rop->max_length)
-        max_length = rop->max_length;
-    else
-        max_length = op1->length + 1;
+static bignum_elem_t sub_n(bignum_elem_t *rp, const bignum_elem_t *ap,
+                           const bignum_elem_t *bp, size_t n) {
+    // rp = ap - bp, returns borrow.
+    bignum_elem_t borrow = 0;
+    for (size_t i=0; i<n; i++)
+        rp[i] = sub_elem(ap[i], bp[i], borrow, &borrow);
+    return borrow;
+}
 
-    size_t length = 0;
-    if (rop->max_length > 0) {
-        result = op1->v[0] + op2;
-        if (result < op2) {
-            if (result > 0)
-                length = 1;
-            carry = 1;
-        }
-        else {
-            length = 1;
-            carry = 0;
-        }
-    }
-    else if (op2 > 0)
-        carry = 1;
+static bignum_elem_t sub_1(bignum_elem_t *rp, const bignum_elem_t *ap,
+                           size_t n, bignum_elem_t b) {
+    // rp = ap - b, returns borrow.
+    for (size_t i=0; i<n; i++)
+        rp[i] = sub_elem(ap[i], b, 0, &b);
+    return b;
+}
 
-    // Add all numbers from op1 + carry.
-    int i;
-    for (i=1; i<max_length; i++) {
-        result = carry + op1->v[i];
-        if (result < op1->v[i]) {
-            if (result > 0)
-                length = i + 1;
-            carry = 1;
-        }
-        else {
-            length = i + 1;
-            carry = 0;
-        }
-        rop->v[i] = result;
+static bignum_elem_t mul_1_generic(bignum_elem_t *rp, const bignum_elem_t *ap,
+                                   size_t n, bignum_elem_t b) {
+    // rp = ap * b, returns the carry element.
+    bignum_elem_t carry = 0;
+    bignum_elem_t high, low;
+
+    for (size_t i=0; i<n; i++) {
+        low = mul_elem(ap[i], b, &high);
+        low += carry;
+        carry = high + (low < carry);
+        rp[i] = low;
     }
+    return carry;
+}
 
-    if (carry != 0 && max_length > op1->length) {
-        rop->v[op1->length] = carry;
-        length = op1->length + 1;
-        carry = 0;
+static bignum_elem_t addmul_1_generic(bignum_elem_t *rp, const bignum_elem_t *ap,
+                                      size_t n, bignum_elem_t b) {
+    // rp += ap * b, returns the carry element.
+    bignum_elem_t carry = 0;
+    bignum_elem_t high, low, r;
+
+    for (size_t i=0; i<n; i++) {
+        low = mul_elem(ap[i], b, &high);
+        low += carry;
+        high += low < carry;
+        r = rp[i];
+        low += r;
+        carry = high + (low < r);
+        rp[i] = low;
     }
+    return carry;
+}
+
+#ifdef BIGNUM_DISPATCH
+/*
+ * Kernel dispatch on x86-64 hosts:
+ *  - add_n_adx(), mul_1_adx(), addmul_1_adx()
+ *  - select_kernels()
+ *
+ * The ADX variants are only selected with 64 bit elements, but they
+ * use 64 bit registers regardless to assemble with any element type.
+ * They keep the carries in the flags for the whole loop:
+ * mulx, lea and jrcxz don't change any flags, adcx only the carry and
+ * adox only the overflow flag. So addmul_1_adx() runs two independent
+ * carry chains, one for the high elements of the products and one for
+ * the elements of rp.
+ *
+ * select_kernels() runs when the program or library is loaded and
+ * picks them on CPUs with BMI2 and ADX. Setting the environment
+ * variable BIGNUM_KERNELS=generic keeps the portable C versions.
+**/
+static bignum_elem_t add_n_adx(bignum_elem_t *rp, const bignum_elem_t *ap,
+                               const bignum_elem_t *bp, size_t n) {
+    unsigned long long t;
+    if (n == 0)
+        return 0;
+
+    __asm__ volatile(
+        "xor %k[t], %k[t]\n\t"
+        "1:\n\t"
+        "mov (%[ap]), %[t]\n\t"
+        "adcx (%[bp]), %[t]\n\t"
+        "mov %[t], (%[rp])\n\t"
+        "lea 8(%[ap]), %[ap]\n\t"
+        "lea 8(%[bp]), %[bp]\n\t"
+        "lea 8(%[rp]), %[rp]\n\t"
+        "lea -1(%[n]), %[n]\n\t"
+        "jrcxz 2f\n\t"
+        "jmp 1b\n"
+        "2:\n\t"
+        "mov $0, %k[t]\n\t"
+        "adcx %[t], %[t]"
+        : [t] "=&r" (t), [rp] "+r" (rp), [ap] "+r" (ap), [bp] "+r" (bp), [n] "+c" (n)
+        :
+        : "cc", "memory");
+    return t;
+}
+
+static bignum_elem_t mul_1_adx(bignum_elem_t *rp, const bignum_elem_t *ap,
+                               size_t n, bignum_elem_t b) {
+    unsigned long long carry, low, high;
+    if (n == 0)
+        return 0;
 
-    rop->length = length;
+    __asm__ volatile(
+        "xor %k[carry], %k[carry]\n\t"
+        "1:\n\t"
+        "mulx (%[ap]), %[low], %[high]\n\t"
+        "adcx %[carry], %[low]\n\t"
+        "mov %[low], (%[rp])\n\t"
+        "mov %[high], %[carry]\n\t"
+        "lea 8(%[ap]), %[ap]\n\t"
+        "lea 8(%[rp]), %[rp]\n\t"
+        "lea -1(%[n]), %[n]\n\t"
+        "jrcxz 2f\n\t"
+        "jmp 1b\n"
+        "2:\n\t"
+        "mov $0, %k[low]\n\t"
+        "adcx %[low], %[carry]"
+        : [carry] "=&r" (carry), [low] "=&r" (low), [high] "=&r" (high),
+          [rp] "+r" (rp), [ap] "+r" (ap), [n] "+c" (n)
+        : "d" ((unsigned long long) b)
+        : "cc", "memory");
     return carry;
 }
 
-static inline bignum_elem_t lo(bignum_elem_t elem) {
-    // Return the value of the lower bits of elem.
-    return elem & BIGNUM_ELEM_LO;
+static bignum_elem_t addmul_1_adx(bignum_elem_t *rp, const bignum_elem_t *ap,
+                                  size_t n, bignum_elem_t b) {
+    unsigned long long carry, low, high;
+    if (n == 0)
+        return 0;
+
+    // carry is the high element of the previous product. The sum
+    // rp + ap * b fits into n + 1 elements, so the final carry doesn't
+    // overflow.
+    __asm__ volatile(
+        "xor %k[carry], %k[carry]\n\t"
+        "1:\n\t"
+        "mulx (%[ap]), %[low], %[high]\n\t"
+        "adox %[carry], %[low]\n\t"
+        "adcx (%[rp]), %[low]\n\t"
+        "mov %[low], (%[rp])\n\t"
+        "mov %[high], %[carry]\n\t"
+        "lea 8(%[ap]), %[ap]\n\t"
+        "lea 8(%[rp]), %[rp]\n\t"
+        "lea -1(%[n]), %[n]\n\t"
+        "jrcxz 2f\n\t"
+        "jmp 1b\n"
+        "2:\n\t"
+        "mov $0, %k[low]\n\t"
+        "adox %[low], %[carry]\n\t"
+        "adcx %[low], %[carry]"
+        : [carry] "=&r" (carry), [low] "=&r" (low), [high] "=&r" (high),
+          [rp] "+r" (rp), [ap] "+r" (ap), [n] "+c" (n)
+        : "d" ((unsigned long long) b)
+        : "cc", "memory");
+    return carry;
 }
 
-static inline bignum_elem_t hi(bignum_elem_t elem) {
-    // Return the value of the higher bits of elem.
-    return (elem & BIGNUM_ELEM_HI) >> BIGNUM_ELEM_SIZE * 4;
+static struct {
+    bignum_elem_t (*add_n)(bignum_elem_t *, const bignum_elem_t *,
+                           const bignum_elem_t *, size_t);
+    bignum_elem_t (*mul_1)(bignum_elem_t *, const bignum_elem_t *,
+                           size_t, bignum_elem_t);
+    bignum_elem_t (*addmul_1)(bignum_elem_t *, const bignum_elem_t *,
+                              size_t, bignum_elem_t);
+    const char *name;
+} kernels = {add_n_generic, mul_1_generic, addmul_1_generic, "generic"};
+
+__attribute__((constructor))
+static void select_kernels(void) {
+    const char *env = getenv("BIGNUM_KERNELS");
+
+    __builtin_cpu_init();
+    if (BIGNUM_ELEM_SIZE == 8 && __builtin_cpu_supports("bmi2") &&
+        __builtin_cpu_supports("adx") && (env == NULL || strcmp(env, "generic") != 0)) {
+        kernels.add_n = add_n_adx;
+        kernels.mul_1 = mul_1_adx;
+        kernels.addmul_1 = addmul_1_adx;
+        kernels.name = "adx";
+    }
 }
 
-int bignum_mul(bignum_t *rop, bignum_t *op1, bignum_t *op2) {
-    // rop = op1 * op2
-    bignum_elem_t result;
-    bignum_elem_t lo1, hi1, lo2, hi2;
-    bignum_elem_t carry = 0;
-    bignum_elem_t elem1, elem2;
+const char *bignum_kernels(void) {
+    return kernels.name;
+}
+#elif !defined(__OPENCL_VERSION__)
+const char *bignum_kernels(void) {
+    return "generic";
+}
+#endif
+
+static inline bignum_elem_t add_n(bignum_elem_t *rp, const bignum_elem_t *ap,
+                                  const bignum_elem_t *bp, size_t n) {
+    // rp = ap + bp, returns carry.
+#ifdef BIGNUM_DISPATCH
+    return kernels.add_n(rp, ap, bp, n);
+#else
+    return add_n_generic(rp, ap, bp, n);
+#endif
+}
 
-    size_t length = 0;
-    int overflow = 0;
-    int i, j;
+static inline bignum_elem_t mul_1(bignum_elem_t *rp, const bignum_elem_t *ap,
+                                  size_t n, bignum_elem_t b) {
+    // rp = ap * b, returns the carry element.
+#ifdef BIGNUM_DISPATCH
+    return kernels.mul_1(rp, ap, n, b);
+#else
+    return mul_1_generic(rp, ap, n, b);
+#endif
+}
 
-    size_t max_length = op1->length + op2->length;
-    if (max_length > rop->max_length)
-        max_length = rop->max_length;
+static inline bignum_elem_t addmul_1(bignum_elem_t *rp, const bignum_elem_t *ap,
+                                     size_t n, bignum_elem_t b) {
+    // rp += ap * b, returns the carry element.
+#ifdef BIGNUM_DISPATCH
+    return kernels.addmul_1(rp, ap, n, b);
+#else
+    return addmul_1_generic(rp, ap, n, b);
+#endif
+}
 
-    // Calculation starts here.
-    for (int pos=0; pos<max_length; pos++) {
-        result = carry;
-        carry = 0;
+static bignum_elem_t submul_1(bignum_elem_t *rp, const bignum_elem_t *ap,
+                              size_t n, bignum_elem_t b) {
+    // rp -= ap * b, returns the borrow element.
+    bignum_elem_t carry = 0;
+    bignum_elem_t high, low, r;
+
+    for (size_t i=0; i<n; i++) {
+        low = mul_elem(ap[i], b, &high);
+        low += carry;
+        high += low < carry;
+        r = rp[i];
+        carry = high + (r < low);
+        rp[i] = r - low;
+    }
+    return carry;
+}
 
-        for (i=0; i<op1->length; i++) {
-            j = pos - i;
-            if (j >= op2->length)
-                continue;
-            else if (j < 0)
-                break;
+static bignum_elem_t lshift_n(bignum_elem_t *rp, const bignum_elem_t *ap,
+                              size_t n, int shift) {
+    // rp = ap << shift with 0 <= shift < bits per element.
+    // Returns the bits shifted out of the highest element.
+    bignum_elem_t out = 0, a;
+    if (shift == 0) {
+        for (size_t i=0; i<n; i++)
+            rp[i] = ap[i];
+        return 0;
+    }
 
-            elem1 = op1->v[i];
-            elem2 = op2->v[j];
-            lo1 = lo(elem1);
-            lo2 = lo(elem2);
-            hi1 = hi(elem1);
-            hi2 = hi(elem2);
+    for (size_t i=0; i<n; i++) {
+        a = ap[i];
+        rp[i] = (a << shift) | out;
+        out = a >> (BIGNUM_ELEM_SIZE * 8 - shift);
+    }
+    return out;
+}
 
-            result += lo1 * lo2;
-            result += (hi1 * lo2) << BIGNUM_ELEM_SIZE * 4;
-            result += (lo1 * hi2) << BIGNUM_ELEM_SIZE * 4;
+static void rshift_n(bignum_elem_t *rp, const bignum_elem_t *ap,
+                     size_t n, int shift) {
+    // rp = ap >> shift with 0 <= shift < bits per element.
+    if (n == 0)
+        return;
+    if (shift == 0) {
+        for (size_t i=0; i<n; i++)
+            rp[i] = ap[i];
+        return;
+    }
 
-            carry += hi1 * hi2;
-            carry += hi(hi1 * lo2);
-            carry += hi(lo1 * hi2);
-        }
+    for (size_t i=0; i+1<n; i++)
+        rp[i] = (ap[i] >> shift) | (ap[i+1] << (BIGNUM_ELEM_SIZE * 8 - shift));
+    rp[n-1] = ap[n-1] >> shift;
+}
 
-        if (result != 0)
-            length = pos+1;
+static bignum_elem_t div_elem(bignum_elem_t u1, bignum_elem_t u0,
+                              bignum_elem_t d, bignum_elem_t *r) {
+    // Return (u1 * base + u0) / d and store the remainder in r (u1 < d).
+#ifdef BIGNUM_DELEM_TYPE
+    BIGNUM_DELEM_TYPE u = ((BIGNUM_DELEM_TYPE) u1 << BIGNUM_ELEM_SIZE * 8) | u0;
+    *r = (bignum_elem_t) (u % d);
+    return (bignum_elem_t) (u / d);
+#else
+    // Long division by half elements (see Hacker's Delight, divlu).
+    const bignum_elem_t b = (bignum_elem_t) 1 << BIGNUM_ELEM_SIZE * 4;
+    bignum_elem_t un1, un0, un32, un21, q1, q0, rhat;
+    int s = count_leading_zeros(d);
+
+    d <<= s;
+    if (s == 0)
+        un32 = u1;
+    else
+        un32 = (u1 << s) | (u0 >> (BIGNUM_ELEM_SIZE * 8 - s));
+    u0 <<= s;
+    un1 = hi(u0);
+    un0 = lo(u0);
+
+    q1 = un32 / hi(d);
+    rhat = un32 - q1 * hi(d);
+    while (q1 >= b || q1 * lo(d) > b * rhat + un1) {
+        q1--;
+        rhat += hi(d);
+        if (rhat >= b)
+            break;
+    }
 
-        rop->v[pos] = result;
+    un21 = un32 * b + un1 - q1 * d;
+    q0 = un21 / hi(d);
+    rhat = un21 - q0 * hi(d);
+    while (q0 >= b || q0 * lo(d) > b * rhat + un0) {
+        q0--;
+        rhat += hi(d);
+        if (rhat >= b)
+            break;
     }
 
-    if (carry != 0 || length < op1->length || length < op2->length)
-        overflow = 1;
+    *r = (un21 * b + un0 - q0 * d) >> s;
+    return q1 * b + q0;
+#endif
+}
 
-    rop->length = length;
-    return overflow;
+static inline bignum_elem_t reciprocal(bignum_elem_t d) {
+    // Return floor((base^2 - 1) / d) - base for a normalized d
+    // (highest bit set).
+    bignum_elem_t r;
+    return div_elem(~d, BIGNUM_ELEM_MAX, d, &r);
 }
 
+static inline bignum_elem_t div_elem_preinv(bignum_elem_t u1, bignum_elem_t u0,
+                                            bignum_elem_t d, bignum_elem_t v,
+                                            bignum_elem_t *r) {
+    // Return (u1 * base + u0) / d and store the remainder in r, where
+    // d is normalized, v = reciprocal(d) and u1 < d.
+    //
+    // This is algorithm 4 from Moeller and Granlund, "Improved division
+    // by invariant integers", which replaces the division by two
+    // multiplications.
+    bignum_elem_t q1, q0, rem, mask;
+
+    q0 = mul_elem(v, u1, &q1);
+    q0 += u0;
+    q1 += u1 + (q0 < u0) + 1;
+
+    // The first correction is taken about half of the time, so it is
+    // done with a mask instead of an unpredictable branch.
+    rem = u0 - q1 * d;
+    mask = 0 - (bignum_elem_t) (rem > q0);
+    q1 += mask;
+    rem += mask & d;
+    if (rem >= d) {
+        q1++;
+        rem -= d;
+    }
 
-int bignum_mul_ui(bignum_t *rop, bignum_t *op1, bignum_elem_t op2) {
-    // rop = op1 * op2
-    bignum_elem_t result;
-    bignum_elem_t lo1, hi1, lo2, hi2;
-    bignum_elem_t carry = 0;
-    bignum_elem_t elem1, elem2;
+    *r = rem;
+    return q1;
+}
 
-    size_t length = 0;
+static int mul_basecase_lo(bignum_elem_t *rp, size_t rn,
+                           const bignum_elem_t *ap, size_t an,
+                           const bignum_elem_t *bp, size_t bn) {
+    // rp = ap * bp mod base^rn with rn <= an + bn, an > 0 and bn > 0.
+    // Returns 1, if the product didn't fit into rn elements.
+    // ap and bp have to be normalized (no leading zeros), if the
+    // overflow flag is used.
     int overflow = 0;
+    size_t len;
+    bignum_elem_t carry;
 
-    size_t max_length;
-    if (op1->length > rop->max_length)
-        max_length = rop->max_length;
-    else
-        max_length = op1->length;
+    for (size_t j=0; j<bn; j++) {
+        if (j >= rn) {
+            overflow = 1;
+            break;
+        }
 
-    // Calculation starts here.
-    for (int pos=0; pos<max_length; pos++) {
-        result = carry;
-        carry = 0;
+        len = an;
+        if (len > rn - j) {
+            len = rn - j;
+            if (bp[j] != 0)
+                overflow = 1;
+        }
 
-        elem1 = op1->v[pos];
-        elem2 = op2;
-        lo1 = lo(elem1);
-        lo2 = lo(elem2);
-        hi1 = hi(elem1);
-        hi2 = hi(elem2);
+        // Every row starts one element further, so rp[j+len] was
+        // never written before.
+        if (j == 0)
+            carry = mul_1(rp, ap, len, bp[0]);
+        else
+            carry = addmul_1(&rp[j], ap, len, bp[j]);
 
-        result += lo1 * lo2;
-        result += (hi1 * lo2) << BIGNUM_ELEM_SIZE * 4;
-        result += (lo1 * hi2) << BIGNUM_ELEM_SIZE * 4;
+        if (j + len < rn)
+            rp[j+len] = carry;
+        else if (carry != 0)
+            overflow = 1;
+    }
+    return overflow;
+}
 
-        carry += hi1 * hi2;
-        carry += hi(hi1 * lo2);
-        carry += hi(lo1 * hi2);
+static void sqr_basecase(bignum_elem_t *rp, const bignum_elem_t *ap, size_t n) {
+    // rp[0..2n) = ap[0..n)^2 with n > 0.
+    //
+    // Every product ap[i] * ap[j] with i < j is calculated once,
+    // the sum of those is doubled and the squares ap[i]^2 are added.
+    bignum_elem_t high, low, s, c1, c2, carry;
+
+    rp[0] = 0;
+    rp[n] = mul_1(&rp[1], &ap[1], n - 1, ap[0]);
+    for (size_t i=1; i+1<n; i++)
+        rp[n+i] = addmul_1(&rp[2*i+1], &ap[i+1], n - i - 1, ap[i]);
+
+    rp[2*n-1] = lshift_n(&rp[1], &rp[1], 2*n - 2, 1);
+
+    carry = 0;
+    for (size_t i=0; i<n; i++) {
+        low = mul_elem(ap[i], ap[i], &high);
+
+        s = rp[2*i] + low;
+        c1 = s < low;
+        s += carry;
+        c1 += s < carry;
+        rp[2*i] = s;
+
+        s = rp[2*i+1] + high;
+        c2 = s < high;
+        s += c1;
+        c2 += s < c1;
+        rp[2*i+1] = s;
+        carry = c2;
+    }
+}
 
-        if (result != 0)
-            length = pos+1;
+static int abs_diff(bignum_elem_t *rp, const bignum_elem_t *ap, size_t an,
+                    const bignum_elem_t *bp, size_t bn) {
+    // rp = |ap - bp| with an >= bn (an elements are written).
+    // Returns 1 if ap >= bp and 0 otherwise.
+    int ge = 1;
+    size_t i;
+
+    for (i=an; i>bn; i--)
+        if (ap[i-1] != 0)
+            break;
+
+    if (i == bn) {
+        for (; i>0; i--) {
+            if (ap[i-1] != bp[i-1]) {
+                ge = ap[i-1] > bp[i-1];
+                break;
+            }
+        }
+    }
 
-        rop->v[pos] = result;
+    if (ge) {
+        bignum_elem_t borrow = sub_n(rp, ap, bp, bn);
+        sub_1(&rp[bn], &ap[bn], an - bn, borrow);
+    }
+    else {
+        // ap < bp, so the upper elements of ap are all zero.
+        sub_n(rp, bp, ap, bn);
+        for (i=bn; i<an; i++)
+            rp[i] = 0;
     }
+    return ge;
+}
 
-    if (carry != 0 || length < op1->length || length < 1)
-        overflow = 1;
+/*
+ * OpenCL C doesn't support recursion, so mul_karatsuba() keeps its own
+ * stack of subproducts. Subproducts nested deeper than
+ * BIGNUM_KARATSUBA_DEPTH are computed by mul_basecase_lo().
+**/
+#define BIGNUM_KARATSUBA_DEPTH 16
 
-    rop->length = length;
-    return overflow;
+static void mul_karatsuba(bignum_elem_t *rp, const bignum_elem_t *ap,
+                          const bignum_elem_t *bp, size_t n,
+                          bignum_elem_t *scratch) {
+    // rp[0..2n) = ap[0..n) * bp[0..n)
+    // If ap == bp, the subproducts are squares as well.
+    //
+    // With a = a1 * base^l + a0 and b = b1 * base^l + b0:
+    // a * b = z2 * base^2l + (z0 + z2 - zm) * base^l + z0
+    // where z0 = a0 * b0, z2 = a1 * b1, zm = (a1 - a0) * (b1 - b0).
+    //
+    // The scratch area of a frame with h = n - n/2 is used as
+    // |a1 - a0| (h), |b1 - b0| (h), zm (2h), scratch of the subproducts.
+    struct {
+        bignum_elem_t *rp;
+        const bignum_elem_t *ap, *bp;
+        bignum_elem_t *tp;
+        size_t n;
+        int stage, sign;
+    } stack[BIGNUM_KARATSUBA_DEPTH];
+    int top = 0;
+    size_t l, h;
+    bignum_elem_t *tp, *zm;
+    bignum_elem_t carry;
+
+    stack[0].rp = rp; stack[0].ap = ap; stack[0].bp = bp;
+    stack[0].tp = scratch; stack[0].n = n; stack[0].stage = 0;
+    top = 1;
+
+    while (top > 0) {
+        int f = top - 1;
+        n = stack[f].n;
+        rp = stack[f].rp;
+        ap = stack[f].ap;
+        bp = stack[f].bp;
+        tp = stack[f].tp;
+
+        if (n < (ap == bp ? BIGNUM_KARATSUBA_SQR_THRESHOLD : BIGNUM_KARATSUBA_THRESHOLD) ||
+            n < 2 || f == BIGNUM_KARATSUBA_DEPTH - 1) {
+            if (ap == bp)
+                sqr_basecase(rp, ap, n);
+            else
+                mul_basecase_lo(rp, 2*n, ap, n, bp, n);
+            top--;
+            continue;
+        }
+
+        l = n / 2;
+        h = n - l;
+        zm = &tp[2*h];
+
+        switch (stack[f].stage++) {
+            case 0: // z0 -> rp[0..2l)
+                stack[top].rp = rp;
+                stack[top].ap = ap;
+                stack[top].bp = bp;
+                stack[top].tp = tp;
+                stack[top].n = l;
+                break;
+            case 1: // z2 -> rp[2l..2n)
+                stack[top].rp = &rp[2*l];
+                stack[top].ap = &ap[l];
+                stack[top].bp = &bp[l];
+                stack[top].tp = tp;
+                stack[top].n = h;
+                break;
+            case 2: // zm -> zm[0..2h)
+                if (ap == bp) {
+                    // zm = (a1 - a0)^2 is never negative.
+                    abs_diff(tp, &ap[l], h, ap, l);
+                    stack[f].sign = 1;
+                    stack[top].bp = tp;
+                }
+                else {
+                    stack[f].sign = abs_diff(tp, &ap[l], h, ap, l) ==
+                                    abs_diff(&tp[h], &bp[l], h, bp, l);
+                    stack[top].bp = &tp[h];
+                }
+                stack[top].rp = zm;
+                stack[top].ap = tp;
+                stack[top].tp = &tp[4*h];
+                stack[top].n = h;
+                break;
+            default:
+                // zm = z0 + z2 -/+ zm, carry holds the element above zm.
+                if (stack[f].sign)
+                    carry = -sub_n(zm, &rp[2*l], zm, 2*h);
+                else
+                    carry = add_n(zm, &rp[2*l], zm, 2*h);
+                carry += add_1(&zm[2*l], &zm[2*l], 2*h - 2*l,
+                               add_n(zm, zm, rp, 2*l));
+
+                carry += add_n(&rp[l], &rp[l], zm, 2*h);
+                add_1(&rp[l+2*h], &rp[l+2*h], l, carry);
+                top--;
+                continue;
+        }
+        stack[top].stage = 0;
+        top++;
+    }
 }
 
-bignum_elem_t bignum_divmod_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2) {
-    // rop = op1 / op2
-    // Returns remainder.
+static void mul_full(bignum_elem_t *rp, const bignum_elem_t *ap, size_t an,
+                     const bignum_elem_t *bp, size_t bn, bignum_elem_t *scratch) {
+    // rp[0..an+bn) = ap * bp with an >= bn > 0.
+    // scratch holds 6 * bn + 64 elements, or is NULL for schoolbook
+    // multiplication.
+    bignum_elem_t *chunk;
+    size_t pos;
+
+    if (scratch == NULL || bn < BIGNUM_KARATSUBA_THRESHOLD) {
+        mul_basecase_lo(rp, an + bn, ap, an, bp, bn);
+        return;
+    }
+    chunk = scratch;
+    scratch = &scratch[2*bn];
 
-    // Calculate quotient and remainder of base / op2.
-    // This is used for later calculating the remainder
-    bignum_elem_t base_q;
-    bignum_elem_t base_r;
-
-    // base_r == elem_max + 1 (mod op2)
-    base_r = (BIGNUM_ELEM_MAX % op2 + 1) % op2;
-
-    // For this, consider base = 16, elem_max = 15 and op2 = 8:
-    // 16 = 2 * 8 + 0
-    // 15 = 1 * 8 + 7
-    //      q  op2  r
-    // So we have to add 1 exactly if base_r is 0.
-    if (base_r == 0)
-        base_q = BIGNUM_ELEM_MAX / op2 + 1;
-    else
-        base_q = BIGNUM_ELEM_MAX / op2;
+    // Multiply bp with ap in chunks of bn elements.
+    mul_karatsuba(rp, ap, bp, bn, scratch);
+    for (pos=2*bn; pos<an+bn; pos++)
+        rp[pos] = 0;
 
-    bignum_elem_t last_r;
-    bignum_elem_t remainder = 0;
-    bignum_elem_t result;
+    for (pos=bn; pos+bn <= an; pos+=bn) {
+        mul_karatsuba(chunk, &ap[pos], bp, bn, scratch);
+        add_n(&rp[pos], &rp[pos], chunk, 2*bn);
+    }
 
-    // result = v[i] / op2 + remainder * base_q
+    if (pos < an) {
+        mul_basecase_lo(chunk, an - pos + bn, bp, bn, &ap[pos], an - pos);
+        add_n(&rp[pos], &rp[pos], chunk, an - pos + bn);
+    }
+}
 
-    int i;
-    size_t length = 0;
+/*
+ *  Calculating big numbers
+**/
+int bignum_add(bignum_t *rop, const bignum_t *op1, const bignum_t *op2) {
+    // rop = op1 + op2
+    // Return 1, if the operation caused an overflow and 0 otherwise.
+    bignum_elem_t carry;
+    const bignum_t *shorter, *longer;
+    size_t short_length, long_length;
+    int overflow = 0;
 
-    size_t max_length;
-    if (op1->length > rop->max_length)
-        max_length = rop->max_length;
-    else
-        max_length = op1->length;
+    // Find longer operand.
+    if (op1->length > op2->length) {
+        shorter = op2;
+        longer = op1;
+    }
+    else {
+        shorter = op1;
+        longer = op2;
+    }
 
-    // "Skip" too large indicies, but calculate the remainder.
-    for (i=op1->length-1; i>=max_length; i--) {
-        last_r = remainder;
-        result = op1->v[i] / op2;
-        result += last_r * base_q;
-        remainder = op1->v[i] % op2;
-        remainder += last_r * base_r;
+    // Elements of the operands which don't fit into rop are an overflow.
+    short_length = shorter->length;
+    long_length = longer->length;
+    if (long_length > rop->max_length) {
+        long_length = rop->max_length;
+        overflow = 1;
+        if (short_length > long_length)
+            short_length = long_length;
     }
 
-    for (i=max_length-1; i>=0; i--) {
-        last_r = remainder;
-        result = op1->v[i] / op2;
-        result += last_r * base_q;
-        remainder = op1->v[i] % op2;
-        remainder += last_r * base_r;
+    carry = add_n(rop->v, longer->v, shorter->v, short_length);
+    carry = add_1(&rop->v[short_length], &longer->v[short_length],
+                  long_length - short_length, carry);
 
-        rop->v[i] = result;
-        if (length == 0 && result != 0)
-            length = i+1;
+    if (carry != 0) {
+        if (long_length < rop->max_length)
+            rop->v[long_length++] = carry;
+        else
+            overflow = 1;
     }
 
-    rop->length = length;
-    return remainder;
+    rop->length = normalized_length(rop->v, long_length);
+    return overflow;
 }
 
-bignum_elem_t bignum_mod_ui(const bignum_t *op1, const bignum_elem_t op2) {
-    // rop = op1 / op2
-    // Returns remainder.
+int bignum_add_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2) {
+    // rop = op1 + op2
+    // Return 1, if the operation caused an overflow and 0 otherwise.
+    bignum_elem_t carry;
+    size_t length = op1->length;
+    int overflow = 0;
+
+    if (length > rop->max_length) {
+        length = rop->max_length;
+        overflow = 1;
+    }
+
+    // With length == 0 the carry is op2 itself.
+    carry = add_1(rop->v, op1->v, length, op2);
+
+    if (carry != 0) {
+        if (length < rop->max_length)
+            rop->v[length++] = carry;
+        else
+            overflow = 1;
+    }
+
+    rop->length = normalized_length(rop->v, length);
+    return overflow;
+}
+
+int bignum_mul(bignum_t *rop, bignum_t *op1, bignum_t *op2) {
+    // rop = op1 * op2
+#ifndef __OPENCL_VERSION__
+    // On the host there's enough stack for the scratch area.
+    if (op1->length <= BIGNUM_4096 && op2->length <= BIGNUM_4096) {
+        bignum_elem_t scratch[BIGNUM_MUL_SCRATCH(BIGNUM_4096)];
+        return bignum_mul_scratch(rop, op1, op2, scratch);
+    }
+#endif
+    return bignum_mul_scratch(rop, op1, op2, NULL);
+}
+
+int bignum_mul_scratch(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                       bignum_elem_t *scratch) {
+    // rop = op1 * op2
+    const bignum_t *tmp;
+    bignum_elem_t *prod;
+    size_t an, bn, rn, pos;
+    int overflow = 0;
 
-    // Calculate quotient and remainder of base / op2.
-    // This is used for later calculating the remainder
-    bignum_elem_t base_r;
+    // Let op1 be the longer operand.
+    if (op1->length < op2->length) {
+        tmp = op1;
+        op1 = op2;
+        op2 = tmp;
+    }
+    an = op1->length;
+    bn = op2->length;
+
+    if (bn == 0) {
+        rop->length = 0;
+        return 0;
+    }
 
-    // base_r == elem_max + 1 (mod op2)
-    base_r = (BIGNUM_ELEM_MAX % op2 + 1) % op2;
+    rn = an + bn;
+    if (rn > rop->max_length)
+        rn = rop->max_length;
 
-    bignum_elem_t last_r;
-    bignum_elem_t remainder = 0;
+    if (scratch == NULL || bn < BIGNUM_KARATSUBA_THRESHOLD) {
+        overflow = mul_basecase_lo(rop->v, rn, op1->v, an, op2->v, bn);
+        rop->length = normalized_length(rop->v, rn);
+        return overflow;
+    }
 
-    for (int i=op1->length-1; i>=0; i--) {
-        last_r = remainder;
-        remainder = op1->v[i] % op2;
-        remainder += last_r * base_r;
+    // Write the full product to rop, if it fits and to scratch otherwise.
+    if (rn == an + bn)
+        prod = rop->v;
+    else {
+        prod = scratch;
+        scratch = &scratch[an + bn];
+    }
+    mul_full(prod, op1->v, an, op2->v, bn, scratch);
+
+    if (prod != rop->v) {
+        for (pos=0; pos<rn; pos++)
+            rop->v[pos] = prod[pos];
+        for (; pos<an+bn; pos++)
+            if (prod[pos] != 0)
+                overflow = 1;
     }
 
-    return remainder;
+    rop->length = normalized_length(rop->v, rn);
+    return overflow;
+}
+
+
+int bignum_mul_ui(bignum_t *rop, bignum_t *op1, bignum_elem_t op2) {
+    // rop = op1 * op2
+    bignum_elem_t carry;
+    int overflow = 0;
+
+    if (op1->length == 0 || op2 == 0) {
+        rop->length = 0;
+        return 0;
+    }
+
+    size_t max_length;
+    if (op1->length > rop->max_length) {
+        max_length = rop->max_length;
+        overflow = 1;
+    }
+    else
+        max_length = op1->length;
+
+    carry = mul_1(rop->v, op1->v, max_length, op2);
+
+    if (carry != 0) {
+        if (max_length < rop->max_length)
+            rop->v[max_length++] = carry;
+        else
+            overflow = 1;
+    }
+
+    rop->length = normalized_length(rop->v, max_length);
+    return overflow;
+}
+
+bignum_elem_t bignum_addmul_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2) {
+    // rop += op1 * op2
+    // Returns the carry element, which didn't fit into rop.
+    size_t an = op1->length;
+    size_t rn = rop->length;
+    bignum_elem_t carry;
+
+    if (an > rop->max_length)
+        an = rop->max_length;
+
+    // The elements of rop above its length may be anything.
+    for (; rn < an; rn++)
+        rop->v[rn] = 0;
+
+    carry = addmul_1(rop->v, op1->v, an, op2);
+    carry = add_1(&rop->v[an], &rop->v[an], rn - an, carry);
+
+    if (carry != 0 && rn < rop->max_length) {
+        rop->v[rn++] = carry;
+        carry = 0;
+    }
+
+    rop->length = normalized_length(rop->v, rn);
+    return carry;
+}
+
+bignum_elem_t bignum_submul_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2) {
+    // rop -= op1 * op2
+    // Returns the borrow element, rop wraps around if it isn't zero.
+    size_t an = op1->length;
+    size_t rn = rop->length;
+    bignum_elem_t borrow;
+
+    if (an > rop->max_length)
+        an = rop->max_length;
+
+    for (; rn < an; rn++)
+        rop->v[rn] = 0;
+
+    borrow = submul_1(rop->v, op1->v, an, op2);
+    borrow = sub_1(&rop->v[an], &rop->v[an], rn - an, borrow);
+
+    rop->length = normalized_length(rop->v, rn);
+    return borrow;
+}
+
+int bignum_sqr(bignum_t *rop, const bignum_t *op) {
+    // rop = op^2
+#ifndef __OPENCL_VERSION__
+    // On the host there's enough stack for the scratch area.
+    if (op->length <= BIGNUM_4096) {
+        bignum_elem_t scratch[BIGNUM_MUL_SCRATCH(BIGNUM_4096)];
+        return bignum_sqr_scratch(rop, op, scratch);
+    }
+#endif
+    return bignum_sqr_scratch(rop, op, NULL);
+}
+
+int bignum_sqr_scratch(bignum_t *rop, const bignum_t *op, bignum_elem_t *scratch) {
+    // rop = op^2
+    size_t n = op->length;
+    size_t rn, pos;
+    bignum_elem_t *prod;
+    int overflow = 0;
+
+    if (n == 0) {
+        rop->length = 0;
+        return 0;
+    }
+
+    rn = 2*n;
+    if (rn > rop->max_length)
+        rn = rop->max_length;
+
+    // Write the full square to rop, if it fits and to scratch otherwise.
+    if (rn == 2*n)
+        prod = rop->v;
+    else if (scratch != NULL) {
+        prod = scratch;
+        scratch = &scratch[2*n];
+    }
+    else {
+        overflow = mul_basecase_lo(rop->v, rn, op->v, n, op->v, n);
+        rop->length = normalized_length(rop->v, rn);
+        return overflow;
+    }
+
+    if (scratch == NULL || n < BIGNUM_KARATSUBA_SQR_THRESHOLD)
+        sqr_basecase(prod, op->v, n);
+    else
+        mul_karatsuba(prod, op->v, op->v, n, scratch);
+
+    if (prod != rop->v) {
+        for (pos=0; pos<rn; pos++)
+            rop->v[pos] = prod[pos];
+        for (; pos<2*n; pos++)
+            if (prod[pos] != 0)
+                overflow = 1;
+    }
+
+    rop->length = normalized_length(rop->v, rn);
+    return overflow;
+}
+
+/*
+ * Fixed-size arithmetic:
+ *  - bignum512_add(), bignum512_mul(), bignum512_sqr()
+ *  - ... up to bignum4096_*()
+ *
+ * BIGNUM_FIXED_DEFINE() generates these for one size. Every loop has a
+ * constant trip count. OpenCL C unrolls them completely, so all indices
+ * are constant and the elements stay in registers instead of being
+ * spilled to private memory. On the host the unrolled code is not faster
+ * than the loops and takes very long to compile, so the compiler decides
+ * there.
+**/
+#ifndef BIGNUM_UNROLL
+#ifdef __OPENCL_VERSION__
+#define BIGNUM_UNROLL _Pragma("unroll")
+#else
+#define BIGNUM_UNROLL
+#endif
+#endif
+
+#define BIGNUM_FIXED_DEFINE(bits) \
+int bignum##bits##_add(bignum_elem_t *rop, const bignum_elem_t *op1, \
+                       const bignum_elem_t *op2) { \
+    /* rop = op1 + op2, the carry is the overflow. */ \
+    bignum_elem_t carry = 0; \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i<BIGNUM_##bits; i++) \
+        rop[i] = add_elem(op1[i], op2[i], carry, &carry); \
+    return carry != 0; \
+} \
+\
+int bignum##bits##_mul(bignum_elem_t *rop, const bignum_elem_t *op1, \
+                       const bignum_elem_t *op2) { \
+    /* rop = op1 * op2 mod base^n by rows of op1[i] * op2. */ \
+    /* The product overflows if a row carries out of the top element */ \
+    /* or if op1[i] and any op2[j] with i + j >= n are nonzero. */ \
+    bignum_elem_t t[BIGNUM_##bits]; \
+    bignum_elem_t low, high, carry; \
+    bignum_elem_t upper = 0, overflow = 0; \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i<BIGNUM_##bits; i++) \
+        t[i] = 0; \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i<BIGNUM_##bits; i++) { \
+        carry = 0; \
+        BIGNUM_UNROLL \
+        for (size_t j=0; j<BIGNUM_##bits-i; j++) { \
+            low = mul_elem(op1[i], op2[j], &high) + carry; \
+            high += low < carry; \
+            t[i+j] += low; \
+            carry = high + (t[i+j] < low); \
+        } \
+        if (i > 0) \
+            upper |= op2[BIGNUM_##bits-i]; \
+        overflow |= carry | (op1[i] != 0 && upper != 0); \
+    } \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i<BIGNUM_##bits; i++) \
+        rop[i] = t[i]; \
+    return overflow != 0; \
+} \
+\
+int bignum##bits##_sqr(bignum_elem_t *rop, const bignum_elem_t *op) { \
+    /* rop = op^2 mod base^n like sqr_basecase() with the full */ \
+    /* product in t, the overflow are the upper n elements. */ \
+    bignum_elem_t t[2*BIGNUM_##bits]; \
+    bignum_elem_t low, high, carry; \
+    bignum_elem_t overflow = 0; \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i<2*BIGNUM_##bits; i++) \
+        t[i] = 0; \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i+1<BIGNUM_##bits; i++) { \
+        carry = 0; \
+        BIGNUM_UNROLL \
+        for (size_t j=i+1; j<BIGNUM_##bits; j++) { \
+            low = mul_elem(op[i], op[j], &high) + carry; \
+            high += low < carry; \
+            t[i+j] += low; \
+            carry = high + (t[i+j] < low); \
+        } \
+        t[i+BIGNUM_##bits] = carry; \
+    } \
+    /* Double the cross products, the sum of them is < base^2n / 2. */ \
+    BIGNUM_UNROLL \
+    for (size_t i=2*BIGNUM_##bits-1; i>0; i--) \
+        t[i] = (t[i] << 1) | (t[i-1] >> (BIGNUM_ELEM_SIZE*8 - 1)); \
+    carry = 0; \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i<BIGNUM_##bits; i++) { \
+        low = mul_elem(op[i], op[i], &high); \
+        t[2*i] = add_elem(t[2*i], low, carry, &carry); \
+        t[2*i+1] = add_elem(t[2*i+1], high, carry, &carry); \
+    } \
+    BIGNUM_UNROLL \
+    for (size_t i=0; i<BIGNUM_##bits; i++) { \
+        rop[i] = t[i]; \
+        overflow |= t[i+BIGNUM_##bits]; \
+    } \
+    return overflow != 0; \
+}
+
+BIGNUM_FIXED_DEFINE(512)
+BIGNUM_FIXED_DEFINE(1024)
+BIGNUM_FIXED_DEFINE(2048)
+BIGNUM_FIXED_DEFINE(4096)
+
+int bignum_mullo(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                 size_t n) {
+    // rop = op1 * op2 mod base^n
+    size_t rn = op1->length + op2->length;
+    if (rn > n)
+        rn = n;
+    if (rop->max_length < rn)
+        return -1;
+
+    if (op1->length == 0 || op2->length == 0) {
+        rop->length = 0;
+        return 0;
+    }
+
+    mul_basecase_lo(rop->v, rn, op1->v, op1->length, op2->v, op2->length);
+    rop->length = normalized_length(rop->v, rn);
+    return 0;
+}
+
+int bignum_mulhi(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                 size_t n, bignum_elem_t *scratch) {
+    // rop = op1 * op2 / base^n, possibly one too small.
+    //
+    // Only the partial products of the columns n-2 and above are
+    // calculated. The neglected ones sum up to less than
+    // (n-2) * base^(n-1), which is less than base^n.
+    size_t an = op1->length;
+    size_t bn = op2->length;
+    size_t start = n > 2 ? n - 2 : 0;
+    size_t tn, i;
+    bignum_elem_t *t = scratch;
+
+    if (an + bn <= n || an == 0 || bn == 0) {
+        rop->length = 0;
+        return 0;
+    }
+    if (rop->max_length < an + bn - n)
+        return -1;
+
+    // t[k] is column start + k of the product.
+    tn = an + bn - start;
+    for (i=0; i<tn; i++)
+        t[i] = 0;
+
+    for (size_t j=0; j<bn; j++) {
+        i = start > j ? start - j : 0;
+        if (i >= an)
+            continue;
+        t[an+j-start] = addmul_1(&t[i+j-start], &op1->v[i], an - i, op2->v[j]);
+    }
+
+    for (i=0; i < an + bn - n; i++)
+        rop->v[i] = t[i + n - start];
+    rop->length = normalized_length(rop->v, an + bn - n);
+    return 0;
+}
+
+bignum_elem_t bignum_divmod_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2) {
+    // rop = op1 / op2
+    // Returns remainder.
+    bignum_udiv_ctx_t ctx;
+    bignum_udiv_init(&ctx, op2);
+    return bignum_divmod_ui_pre(rop, op1, &ctx);
+}
+
+bignum_elem_t bignum_mod_ui(const bignum_t *op1, const bignum_elem_t op2) {
+    // Returns op1 % op2.
+    bignum_udiv_ctx_t ctx;
+    bignum_udiv_init(&ctx, op2);
+    return bignum_mod_ui_pre(op1, &ctx);
+}
+
+/*
+ * Division by invariant single elements:
+ *  - bignum_udiv_init()
+ *  - bignum_divmod_ui_pre()
+ *  - bignum_mod_ui_pre()
+ *  - bignum_mod_ui_multi()
+**/
+int bignum_udiv_init(bignum_udiv_ctx_t *ctx, const bignum_elem_t d) {
+    // Set up ctx for divisions by d.
+    // Returns 0 on success and -1 if d is zero.
+    if (d == 0)
+        return -1;
+
+    ctx->d = d;
+    ctx->shift = count_leading_zeros(d);
+    ctx->dnorm = d << ctx->shift;
+    ctx->inv = reciprocal(ctx->dnorm);
+    return 0;
+}
+
+static inline bignum_elem_t shifted_elem(const bignum_t *op, size_t i, int shift) {
+    // Return element i of op << shift, where 0 <= shift < bits per element.
+    bignum_elem_t elem = op->v[i] << shift;
+    if (i > 0)
+        elem |= (op->v[i-1] >> 1) >> (BIGNUM_ELEM_SIZE * 8 - 1 - shift);
+    return elem;
+}
+
+bignum_elem_t bignum_divmod_ui_pre(bignum_t *rop, const bignum_t *op1,
+                                   const bignum_udiv_ctx_t *ctx) {
+    // rop = op1 / d
+    // Returns remainder.
+    //
+    // Divides op1 << shift by the normalized divisor, which yields the
+    // same quotient and the remainder shifted by shift bits.
+    bignum_elem_t q, r = 0;
+    size_t n = op1->length;
+
+    if (n == 0) {
+        rop->length = 0;
+        return 0;
+    }
+
+    // Quotient elements beyond rop->max_length are skipped, but
+    // still needed for the remainder.
+    size_t max_length;
+    if (n > rop->max_length)
+        max_length = rop->max_length;
+    else
+        max_length = n;
+
+    // The bits shifted out of the highest element are less than dnorm.
+    r = (op1->v[n-1] >> 1) >> (BIGNUM_ELEM_SIZE * 8 - 1 - ctx->shift);
+
+    for (size_t i=n; i>0; i--) {
+        q = div_elem_preinv(r, shifted_elem(op1, i-1, ctx->shift),
+                            ctx->dnorm, ctx->inv, &r);
+        if (i <= max_length)
+            rop->v[i-1] = q;
+    }
+
+    rop->length = normalized_length(rop->v, max_length);
+    return r >> ctx->shift;
+}
+
+bignum_elem_t bignum_mod_ui_pre(const bignum_t *op1, const bignum_udiv_ctx_t *ctx) {
+    // Returns op1 % d.
+    bignum_elem_t r = 0;
+    size_t n = op1->length;
+
+    if (n == 0)
+        return 0;
+
+    r = (op1->v[n-1] >> 1) >> (BIGNUM_ELEM_SIZE * 8 - 1 - ctx->shift);
+    for (size_t i=n; i>0; i--)
+        div_elem_preinv(r, shifted_elem(op1, i-1, ctx->shift),
+                        ctx->dnorm, ctx->inv, &r);
+
+    return r >> ctx->shift;
+}
+
+int bignum_mod_ui_multi(const bignum_t *op, const bignum_elem_t *moduli,
+                        bignum_elem_t *out, size_t count) {
+    // out[i] = op % moduli[i]
+    // Returns 0 on success and -1 if a modulus is zero.
+    //
+    // The moduli are multiplied into products which fit into an element.
+    // One pass over op reduces it modulo up to BIGNUM_MOD_MULTI_GROUPS of
+    // these products, whose remainders are then split by single element
+    // divisions.
+    bignum_udiv_ctx_t ctx[BIGNUM_MOD_MULTI_GROUPS];
+    bignum_elem_t rem[BIGNUM_MOD_MULTI_GROUPS];
+    size_t end[BIGNUM_MOD_MULTI_GROUPS];
+    bignum_elem_t product, next, high, r;
+    size_t n = op->length, i = 0, j = 0, groups;
+
+    for (size_t k=0; k<count; k++) {
+        if (moduli[k] == 0)
+            return -1;
+    }
+
+    while (i < count) {
+        for (groups=0; groups < BIGNUM_MOD_MULTI_GROUPS && i < count; groups++) {
+            product = moduli[i++];
+            while (i < count) {
+                next = mul_elem(product, moduli[i], &high);
+                if (high != 0)
+                    break;
+                product = next;
+                i++;
+            }
+            end[groups] = i;
+            bignum_udiv_init(&ctx[groups], product);
+            rem[groups] = n == 0 ? 0 :
+                (op->v[n-1] >> 1) >> (BIGNUM_ELEM_SIZE * 8 - 1 - ctx[groups].shift);
+        }
+
+        for (size_t k=n; k>0; k--) {
+            for (size_t g=0; g<groups; g++)
+                div_elem_preinv(rem[g], shifted_elem(op, k-1, ctx[g].shift),
+                                ctx[g].dnorm, ctx[g].inv, &rem[g]);
+        }
+
+        for (size_t g=0; g<groups; g++) {
+            r = rem[g] >> ctx[g].shift;
+            for (; j < end[g]; j++)
+                out[j] = r % moduli[j];
+        }
+    }
+    return 0;
+}
+
+int bignum_divmod(bignum_t *q, bignum_t *r, const bignum_t *n, const bignum_t *d,
+                  bignum_elem_t *scratch) {
+    // q = n / d, r = n % d
+    // q may be NULL. Returns 0 on success and -1 otherwise.
+    //
+    // This is algorithm D from Knuth, TAOCP Vol. 2, 4.3.1.
+    size_t nn = n->length;
+    size_t dn = d->length;
+    size_t qn;
+    bignum_elem_t *un, *vn;
+    bignum_elem_t qhat, rhat, high, low, borrow, top, inv;
+    int s;
+
+    if (dn == 0)
+        return -1;
+
+    if (nn < dn) {
+        if (r->max_length < nn)
+            return -1;
+        // q may share memory with n, so it is cleared after the copy.
+        bignum_set(r, n);
+        if (q != NULL)
+            q->length = 0;
+        return 0;
+    }
+
+    // The quotient has nn - dn + 1 elements, if the highest dn elements
+    // of n are not less than d and one element less otherwise.
+    qn = nn - dn;
+    if (cmp_n(&n->v[qn], d->v, dn) >= 0)
+        qn++;
+    if ((q != NULL && q->max_length < qn) || r->max_length < dn)
+        return -1;
+
+    if (dn == 1) {
+        if (q != NULL)
+            bignum_set_ui(r, bignum_divmod_ui(q, n, d->v[0]));
+        else
+            bignum_set_ui(r, bignum_mod_ui(n, d->v[0]));
+        return 0;
+    }
+
+    // Normalize, so the highest bit of the divisor is set.
+    s = count_leading_zeros(d->v[dn-1]);
+    vn = scratch;
+    un = &scratch[dn];
+    lshift_n(vn, d->v, dn, s);
+    un[nn] = lshift_n(un, n->v, nn, s);
+    inv = reciprocal(vn[dn-1]);
+
+    for (size_t j=nn-dn+1; j>0; j--) {
+        bignum_elem_t *u = &un[j-1];
+
+        // Estimate qhat from the three highest elements, it is
+        // at most one too large afterwards.
+        if (u[dn] >= vn[dn-1]) {
+            qhat = BIGNUM_ELEM_MAX;
+            rhat = u[dn-1] + vn[dn-1];
+            top = rhat < vn[dn-1];
+        }
+        else {
+            qhat = div_elem_preinv(u[dn], u[dn-1], vn[dn-1], inv, &rhat);
+            top = 0;
+        }
+
+        while (!top) {
+            low = mul_elem(qhat, vn[dn-2], &high);
+            if (high < rhat || (high == rhat && low <= u[dn-2]))
+                break;
+            qhat--;
+            rhat += vn[dn-1];
+            top = rhat < vn[dn-1];
+        }
+
+        // u -= qhat * vn, add vn back if that was one too much.
+        borrow = submul_1(u, vn, dn, qhat);
+        top = u[dn];
+        u[dn] = top - borrow;
+        if (top < borrow) {
+            qhat--;
+            u[dn] += add_n(u, u, vn, dn);
+        }
+
+        if (q != NULL && j <= qn)
+            q->v[j-1] = qhat;
+    }
+
+    if (q != NULL)
+        q->length = qn;
+
+    rshift_n(r->v, un, dn, s);
+    r->length = normalized_length(r->v, dn);
+    return 0;
+}
+
+int bignum_mod(bignum_t *r, const bignum_t *n, const bignum_t *d,
+               bignum_elem_t *scratch) {
+    // r = n % d
+    return bignum_divmod(NULL, r, n, d, scratch);
+}
+
+/*
+ * Bit operations:
+ *  - bignum_lshift(), bignum_rshift(), bignum_tdiv_q_2exp()
+ *  - bignum_mod_2exp()
+ *  - bignum_bit_length(), bignum_ctz(), bignum_popcount()
+ *  - bignum_tstbit(), bignum_setbit()
+ *
+ * A shift by bits moves the elements by bits / w and shifts them by the
+ * remaining bits % w, where w is the number of bits per element. Only
+ * the elements of the operand below its length are read, so all of
+ * these take time linear in the length, not in max_length.
+**/
+int bignum_lshift(bignum_t *rop, const bignum_t *op, size_t bits) {
+    // rop = op << bits, rop may be op.
+    // Returns 1 if bits were shifted out of rop and 0 otherwise.
+    //
+    // The elements are written from the top down, so every element of
+    // op is read before it is overwritten.
+    size_t w = bits / (BIGNUM_ELEM_SIZE * 8), n = op->length, m, rn;
+    int shift = bits % (BIGNUM_ELEM_SIZE * 8), overflow;
+    bignum_elem_t high;
+
+    if (n == 0) {
+        rop->length = 0;
+        return 0;
+    }
+    if (w >= rop->max_length) {
+        rop->length = 0;
+        return 1;
+    }
+
+    // Only the lowest m elements of op end up in rop.
+    m = n < rop->max_length - w ? n : rop->max_length - w;
+    overflow = m < n;
+    rn = m + w;
+
+    high = (op->v[m-1] >> 1) >> (BIGNUM_ELEM_SIZE * 8 - 1 - shift);
+    if (high != 0) {
+        if (rn < rop->max_length)
+            rop->v[rn++] = high;
+        else
+            overflow = 1;
+    }
+    for (size_t i=m-1; i>0; i--)
+        rop->v[i+w] = (op->v[i] << shift) |
+                      ((op->v[i-1] >> 1) >> (BIGNUM_ELEM_SIZE * 8 - 1 - shift));
+    rop->v[w] = op->v[0] << shift;
+    for (size_t i=0; i<w; i++)
+        rop->v[i] = 0;
+
+    rop->length = overflow ? normalized_length(rop->v, rn) : rn;
+    return overflow;
+}
+
+int bignum_rshift(bignum_t *rop, const bignum_t *op, size_t bits) {
+    // rop = op >> bits, rop may be op.
+    // Returns 1 if the result doesn't fit into rop and 0 otherwise.
+    size_t w = bits / (BIGNUM_ELEM_SIZE * 8), n = op->length, rn;
+    int shift = bits % (BIGNUM_ELEM_SIZE * 8), overflow = 0;
+
+    if (w >= n) {
+        rop->length = 0;
+        return 0;
+    }
+
+    rn = n - w;
+    if (rn > rop->max_length) {
+        // The highest element of the result may be zero.
+        overflow = rn - 1 > rop->max_length || (op->v[n-1] >> shift) != 0;
+        rn = rop->max_length;
+    }
+
+    // The elements are written from the bottom up, every one of them
+    // only reads elements of op at the same index or above. Elements
+    // narrower than int are promoted to signed int, so the result of the
+    // first shift is truncated before the second one.
+    for (size_t i=0; i+w+1<n && i<rn; i++)
+        rop->v[i] = (op->v[i+w] >> shift) |
+                    (bignum_elem_t) ((bignum_elem_t) (op->v[i+w+1] << 1)
+                                     << (BIGNUM_ELEM_SIZE * 8 - 1 - shift));
+    if (rn == n - w)
+        rop->v[rn-1] = op->v[n-1] >> shift;
+
+    rop->length = normalized_length(rop->v, rn);
+    return overflow;
+}
+
+int bignum_tdiv_q_2exp(bignum_t *rop, const bignum_t *op, size_t bits) {
+    // rop = op / 2^bits, the numbers are unsigned, so this is a shift.
+    return bignum_rshift(rop, op, bits);
+}
+
+int bignum_mod_2exp(bignum_t *rop, const bignum_t *op, size_t bits) {
+    // rop = op mod 2^bits, rop may be op.
+    // Returns 1 if the result doesn't fit into rop and 0 otherwise.
+    size_t w = bits / (BIGNUM_ELEM_SIZE * 8), rn = op->length;
+    int shift = bits % (BIGNUM_ELEM_SIZE * 8), overflow = 0;
+    bignum_elem_t mask = ((bignum_elem_t) 1 << shift) - 1;
+
+    if (w < rn)
+        rn = shift == 0 ? w : w + 1;
+
+    // Elements beyond rop->max_length are truncated.
+    for (size_t i=rop->max_length; i<rn; i++) {
+        if ((i == w ? op->v[i] & mask : op->v[i]) != 0)
+            overflow = 1;
+    }
+    if (rn > rop->max_length)
+        rn = rop->max_length;
+
+    if (rop != op) {
+        for (size_t i=0; i<rn; i++)
+            rop->v[i] = op->v[i];
+    }
+    if (w < rn)
+        rop->v[w] &= mask;
+
+    rop->length = normalized_length(rop->v, rn);
+    return overflow;
+}
+
+size_t bignum_bit_length(const bignum_t *op) {
+    // Returns the number of bits of op without leading zeros.
+    if (op->length == 0)
+        return 0;
+    return bit_length(op->v, op->length);
+}
+
+size_t bignum_ctz(const bignum_t *op) {
+    // Returns the number of trailing zero bits of op or 0 if op is zero.
+    size_t i = 0;
+    if (op->length == 0)
+        return 0;
+
+    while (op->v[i] == 0)
+        i++;
+    return i * BIGNUM_ELEM_SIZE * 8 + count_trailing_zeros(op->v[i]);
+}
+
+size_t bignum_popcount(const bignum_t *op) {
+    // Returns the number of set bits of op.
+    size_t count = 0;
+    for (size_t i=0; i<op->length; i++)
+        count += popcount_elem(op->v[i]);
+    return count;
+}
+
+int bignum_tstbit(const bignum_t *op, size_t bit) {
+    // Returns bit number bit of op.
+    size_t w = bit / (BIGNUM_ELEM_SIZE * 8);
+    if (w >= op->length)
+        return 0;
+    return (op->v[w] >> (bit % (BIGNUM_ELEM_SIZE * 8))) & 1;
+}
+
+int bignum_setbit(bignum_t *rop, size_t bit) {
+    // Set bit number bit of rop.
+    // Returns 0 on success and -1 if the bit is beyond rop->max_length.
+    size_t w = bit / (BIGNUM_ELEM_SIZE * 8);
+    if (w >= rop->max_length)
+        return -1;
+
+    // The elements above the length may hold garbage.
+    for (size_t i=rop->length; i<=w; i++)
+        rop->v[i] = 0;
+    if (w >= rop->length)
+        rop->length = w + 1;
+
+    rop->v[w] |= (bignum_elem_t) 1 << (bit % (BIGNUM_ELEM_SIZE * 8));
+    return 0;
+}
+
+/*
+ * Montgomery arithmetic:
+ *  - bignum_mont_assoc(), bignum_mont_init(), bignum_mont_init_scratch()
+ *  - bignum_mont_to(), bignum_mont_from()
+ *  - bignum_mont_mul(), bignum_mont_sqr()
+ *  - powm_mont(), bignum_powm()
+**/
+int bignum_mont_assoc(bignum_mont_ctx_t *ctx, const bignum_t *m, bignum_elem_t *arr) {
+    // Set up ctx for the odd modulus m with R^2 mod m already in arr.
+    // Returns 0 on success and -1 otherwise.
+    size_t n = m->length;
+    bignum_elem_t inv;
+
+    if (n == 0 || (m->v[0] & 1) == 0)
+        return -1;
+
+    ctx->m = *m;
+
+    // Newton iteration: Every step doubles the number of correct bits
+    // and m * m == 1 mod 8 for odd m, so we start with 3 correct bits.
+    inv = m->v[0];
+    // Elements narrower than int are promoted to signed int, which may
+    // overflow, so the products are taken as unsigned int at least.
+    for (int bits=3; bits < BIGNUM_ELEM_SIZE * 8; bits*=2)
+        inv = (bignum_elem_t) (1u * inv * (bignum_elem_t) (2 - 1u * m->v[0] * inv));
+    ctx->minv = 0 - inv;
+
+    bignum_assoc_len(&ctx->r2, arr, n, normalized_length(arr, n));
+    return 0;
+}
+
+int bignum_mont_init(bignum_mont_ctx_t *ctx, const bignum_t *m, bignum_elem_t *arr) {
+    // Set up ctx for the odd modulus m and store R^2 mod m in arr.
+#ifndef __OPENCL_VERSION__
+    // On the host there's enough stack for the scratch area.
+    if (m->length <= BIGNUM_4096) {
+        bignum_elem_t scratch[BIGNUM_MONT_INIT_SCRATCH(BIGNUM_4096)];
+        return bignum_mont_init_scratch(ctx, m, arr, scratch);
+    }
+#endif
+    return bignum_mont_init_scratch(ctx, m, arr, NULL);
+}
+
+int bignum_mont_init_scratch(bignum_mont_ctx_t *ctx, const bignum_t *m,
+                             bignum_elem_t *arr, bignum_elem_t *scratch) {
+    // Set up ctx for the odd modulus m and store R^2 mod m in arr.
+    // Returns 0 on success and -1 otherwise.
+    size_t n = m->length;
+    bignum_elem_t carry;
+    bignum_t r2, e;
+
+    if (n == 0 || (m->v[0] & 1) == 0)
+        return -1;
+
+    for (size_t i=0; i<n; i++)
+        arr[i] = 0;
+
+    // R^2 mod m as the remainder of base^(2n) divided by m.
+    if (scratch != NULL) {
+        for (size_t i=0; i < 2*n; i++)
+            scratch[i] = 0;
+        scratch[2*n] = 1;
+        bignum_assoc_len(&e, scratch, 2*n + 1, 2*n + 1);
+        bignum_assoc_len(&r2, arr, n, 0);
+        bignum_mod(&r2, &e, m, &scratch[2*n + 1]);
+        return bignum_mont_assoc(ctx, m, arr);
+    }
+
+    // Without scratch area by doubling 1 (mod m) 2 * log2(R) times.
+    if (n > 1 || m->v[0] != 1)
+        arr[0] = 1;
+
+    for (size_t i=0; i < 2 * n * BIGNUM_ELEM_SIZE * 8; i++) {
+        carry = add_n(arr, arr, arr, n);
+        if (carry != 0 || cmp_n(arr, m->v, n) >= 0)
+            sub_n(arr, arr, m->v, n);
+    }
+
+    return bignum_mont_assoc(ctx, m, arr);
+}
+
+static void mont_mul(bignum_elem_t *rp, const bignum_elem_t *ap, size_t an,
+                     const bignum_elem_t *bp, size_t bn,
+                     const bignum_mont_ctx_t *ctx, bignum_elem_t *tp) {
+    // rp = ap * bp / R mod m (n elements) with ap, bp < R and ap * bp < R * m.
+    //
+    // This is the CIOS method, but instead of shifting the intermediate
+    // result by one element in each step, it moves through the
+    // 2n + 2 elements of the scratch area tp.
+    size_t n = ctx->m.length;
+    const bignum_elem_t *mp = ctx->m.v;
+    bignum_elem_t *t, carry, q;
+
+    for (size_t i=0; i < 2*n + 2; i++)
+        tp[i] = 0;
+
+    for (size_t i=0; i<n; i++) {
+        t = &tp[i];
+
+        // t += a * b[i]
+        if (i < bn) {
+            carry = addmul_1(t, ap, an, bp[i]);
+            carry = add_1(&t[an], &t[an], n + 1 - an, carry);
+            t[n+1] += carry;
+        }
+
+        // t += q * m, which makes t[0] zero.
+        q = (bignum_elem_t) (1u * t[0] * ctx->minv);
+        carry = addmul_1(t, mp, n, q);
+        add_1(&t[n], &t[n], 2, carry);
+    }
+
+    // The result is less than 2m.
+    t = &tp[n];
+    if (t[n] != 0 || cmp_n(t, mp, n) >= 0)
+        sub_n(rp, t, mp, n);
+    else {
+        for (size_t i=0; i<n; i++)
+            rp[i] = t[i];
+    }
+}
+
+static void mont_redc(bignum_elem_t *rp, bignum_elem_t *tp,
+                      const bignum_mont_ctx_t *ctx) {
+    // rp = tp / R mod m (n elements) with tp[0..2n) < R * m.
+    //
+    // The carry of each step belongs to element i + n, but is stored
+    // in tp[i] (which has just become zero) and added at the end.
+    size_t n = ctx->m.length;
+    const bignum_elem_t *mp = ctx->m.v;
+
+    for (size_t i=0; i<n; i++)
+        tp[i] = addmul_1(&tp[i], mp, n, (bignum_elem_t) (1u * tp[i] * ctx->minv));
+
+    if (add_n(rp, &tp[n], tp, n) != 0 || cmp_n(rp, mp, n) >= 0)
+        sub_n(rp, rp, mp, n);
+}
+
+static void mont_sqr(bignum_elem_t *rp, const bignum_elem_t *ap, size_t an,
+                     const bignum_mont_ctx_t *ctx, bignum_elem_t *tp) {
+    // rp = ap^2 / R mod m (n elements) with ap < m.
+    size_t n = ctx->m.length;
+
+    if (an == 0) {
+        for (size_t i=0; i<n; i++)
+            rp[i] = 0;
+        return;
+    }
+
+    sqr_basecase(tp, ap, an);
+    for (size_t i=2*an; i<2*n; i++)
+        tp[i] = 0;
+    mont_redc(rp, tp, ctx);
+}
+
+int bignum_mont_to(bignum_t *rop, const bignum_t *op,
+                   const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch) {
+    // rop = op * R mod m
+    size_t n = ctx->m.length;
+    if (rop->max_length < n || op->length > n)
+        return -1;
+
+    mont_mul(rop->v, op->v, op->length, ctx->r2.v, ctx->r2.length, ctx, scratch);
+    rop->length = normalized_length(rop->v, n);
+    return 0;
+}
+
+int bignum_mont_from(bignum_t *rop, const bignum_t *op,
+                     const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch) {
+    // rop = op / R mod m
+    const bignum_elem_t one = 1;
+    size_t n = ctx->m.length;
+    if (rop->max_length < n || op->length > n)
+        return -1;
+
+    mont_mul(rop->v, op->v, op->length, &one, 1, ctx, scratch);
+    rop->length = normalized_length(rop->v, n);
+    return 0;
+}
+
+int bignum_mont_mul(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                    const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch) {
+    // rop = op1 * op2 / R mod m
+    size_t n = ctx->m.length;
+    if (rop->max_length < n || op1->length > n || op2->length > n)
+        return -1;
+
+    mont_mul(rop->v, op1->v, op1->length, op2->v, op2->length, ctx, scratch);
+    rop->length = normalized_length(rop->v, n);
+    return 0;
+}
+
+int bignum_mont_sqr(bignum_t *rop, const bignum_t *op,
+                    const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch) {
+    // rop = op^2 / R mod m
+    size_t n = ctx->m.length;
+    if (rop->max_length < n || op->length > n)
+        return -1;
+
+    mont_sqr(rop->v, op->v, op->length, ctx, scratch);
+    rop->length = normalized_length(rop->v, n);
+    return 0;
+}
+
+static inline int get_bit(const bignum_t *op, size_t bit) {
+    // Return bit number bit of op.
+    size_t bits = BIGNUM_ELEM_SIZE * 8;
+    return (op->v[bit / bits] >> (bit % bits)) & 1;
+}
+
+static void powm_mont(bignum_elem_t *rp, const bignum_t *base, const bignum_t *exp,
+                      const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch) {
+    // rp = base^exp * R mod m (in Montgomery form) for exp > 0.
+    //
+    // Left-to-right sliding window exponentiation. The scratch area
+    // holds the odd powers base^1, base^3, ... in Montgomery form,
+    // base^2 and the scratch area of mont_mul().
+    size_t n = ctx->m.length;
+    bignum_elem_t *table, *base2, *tp;
+    size_t bits, i, j;
+    int window, first = 1;
+    bignum_elem_t value;
+
+    table = scratch;
+    base2 = &table[(1 << (BIGNUM_POWM_WINDOW - 1)) * n];
+    tp = &base2[n];
+
+    bits = exp->length * BIGNUM_ELEM_SIZE * 8 -
+           count_leading_zeros(exp->v[exp->length-1]);
+
+    if (bits <= 7)
+        window = 1;
+    else if (bits <= 36)
+        window = 2;
+    else if (bits <= 140)
+        window = 3;
+    else if (bits <= 450)
+        window = 4;
+    else
+        window = 5;
+    if (window > BIGNUM_POWM_WINDOW)
+        window = BIGNUM_POWM_WINDOW;
+
+    // table[k] = base^(2k+1) in Montgomery form
+    mont_mul(table, base->v, base->length, ctx->r2.v, ctx->r2.length, ctx, tp);
+    mont_sqr(base2, table, n, ctx, tp);
+    for (int k=1; k < (1 << (window - 1)); k++)
+        mont_mul(&table[k*n], &table[(k-1)*n], n, base2, n, ctx, tp);
+
+    i = bits;
+    while (i > 0) {
+        if (!get_bit(exp, i-1)) {
+            mont_sqr(rp, rp, n, ctx, tp);
+            i--;
+            continue;
+        }
+
+        // Find the longest window exp[i-1..j] ending with a set bit.
+        j = i > (size_t) window ? i - window : 0;
+        while (!get_bit(exp, j))
+            j++;
+
+        value = 0;
+        for (size_t k=i; k>j; k--)
+            value = (value << 1) | get_bit(exp, k-1);
+
+        if (first) {
+            for (size_t k=0; k<n; k++)
+                rp[k] = table[(value / 2) * n + k];
+            first = 0;
+        }
+        else {
+            for (size_t k=j; k<i; k++)
+                mont_sqr(rp, rp, n, ctx, tp);
+            mont_mul(rp, rp, n, &table[(value / 2) * n], n, ctx, tp);
+        }
+        i = j;
+    }
+}
+
+int bignum_powm(bignum_t *rop, const bignum_t *base, const bignum_t *exp,
+                const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch) {
+    // rop = base^exp mod m
+    //
+    // The accumulator of powm_mont() comes first in the scratch area.
+    size_t n = ctx->m.length;
+    const bignum_elem_t one = 1;
+    bignum_elem_t *acc = scratch;
+
+    if (rop->max_length < n || base->length > n)
+        return -1;
+
+    if (exp->length == 0) {
+        // base^0 = 1 (mod m)
+        bignum_set_ui(rop, bignum_cmp_ui(&ctx->m, 1) == 0 ? 0 : 1);
+        return 0;
+    }
+
+    powm_mont(acc, base, exp, ctx, &scratch[n]);
+    mont_mul(rop->v, acc, n, &one, 1, ctx, &scratch[n]);
+    rop->length = normalized_length(rop->v, n);
+    return 0;
+}
+
+/*
+ * Barrett reduction:
+ *  - recip_newton()
+ *  - bignum_barrett_init()
+ *  - bignum_mod_barrett()
+ *
+ * Moduli of at least BIGNUM_BARRETT_THRESHOLD elements use Karatsuba
+ * products: mu is found by Newton's iteration, which doubles the
+ * precision with every step, and the quotient estimate of the reduction
+ * is calculated from full products instead of bignum_mulhi() and
+ * bignum_mullo(). Both cost a few multiplications instead of a
+ * quadratic division.
+**/
+static void recip_newton(bignum_elem_t *xp, bignum_elem_t *rp, const bignum_elem_t *mp,
+                         size_t k, bignum_elem_t *scratch) {
+    // xp[0..k+1) = base^2k / m and rp[0..k) = base^2k % m for the
+    // normalized m = mp[0..k) (highest bit set) with k >= 2.
+    //
+    // Let m_p be the highest p elements of m and x_p = base^2p / m_p.
+    // From x_p the next precision q = p + s with s <= p is reached by
+    // y = x_p * base^s + x_p * e / base^2p, e = base^(p+q) - x_p * m_q.
+    // y is at most a few units off from x_q, which is fixed by adjusting
+    // the remainder base^2q - y * m_q until it is less than m_q.
+    //
+    // scratch holds 10 * k + 84 elements.
+    size_t prec[sizeof(size_t) * 8];
+    int levels = 0;
+    size_t p = k, q, s, en, cn, yn;
+    bignum_elem_t *yp = scratch;
+    bignum_elem_t *ep = &scratch[k + 2];
+    bignum_elem_t *tp = &scratch[2*k + 4];
+    bignum_elem_t *sp = &scratch[4*k + 8];
+    const bignum_elem_t *mq;
+    bignum_t num, d, x, r;
+    int neg;
+
+    while (p > 2 && p > BIGNUM_KARATSUBA_THRESHOLD) {
+        prec[levels++] = p;
+        p = (p + 1) / 2;
+    }
+
+    // x_p and its remainder by schoolbook division.
+    bignum_assoc_len(&num, tp, 2*p + 1, 2*p + 1);
+    for (size_t i=0; i<2*p; i++)
+        tp[i] = 0;
+    tp[2*p] = 1;
+    d.v = (bignum_elem_t *) &mp[k-p];
+    d.length = p;
+    d.max_length = p;
+    bignum_assoc_len(&x, xp, p + 2, 0);
+    bignum_assoc_len(&r, rp, k + 2, 0);
+    bignum_divmod(&x, &r, &num, &d, sp);
+    for (size_t i=r.length; i<k+2; i++)
+        rp[i] = 0;
+
+    while (levels > 0) {
+        q = prec[--levels];
+        s = q - p;
+        mq = &mp[k-q];
+
+        // e = base^(p+q) - x_p * m_q with |e| < 5 * base^q
+        mul_full(tp, mq, q, xp, p + 1, sp);
+        neg = tp[p+q] != 0;
+        for (size_t i=0; i<q+1; i++)
+            ep[i] = neg ? tp[i] : ~tp[i];
+        if (!neg)
+            add_1(ep, ep, q + 1, 1);
+        en = normalized_length(ep, q + 1);
+
+        // y = x_p * base^s +/- x_p * |e| / base^2p
+        for (size_t i=0; i<s; i++)
+            yp[i] = 0;
+        for (size_t i=0; i<p+1; i++)
+            yp[s+i] = xp[i];
+        yp[q+1] = 0;
+
+        cn = 0;
+        if (en > 0) {
+            if (en > p + 1)
+                mul_full(tp, ep, en, xp, p + 1, sp);
+            else
+                mul_full(tp, xp, p + 1, ep, en, sp);
+            cn = p + 1 + en > 2*p ? p + 1 + en - 2*p : 0;
+        }
+        if (neg)
+            sub_1(&yp[cn], &yp[cn], q + 2 - cn, sub_n(yp, yp, &tp[2*p], cn));
+        else
+            add_1(&yp[cn], &yp[cn], q + 2 - cn, add_n(yp, yp, &tp[2*p], cn));
+
+        // r = base^2q - y * m_q in q + 2 elements with sign, as
+        // base^2q vanishes modulo base^(q+2).
+        yn = normalized_length(yp, q + 2);
+        mul_full(tp, yp, yn, mq, q, sp);
+        for (size_t i=0; i<q+2; i++)
+            rp[i] = ~tp[i];
+        add_1(rp, rp, q + 2, 1);
+
+        while (rp[q+1] >> (BIGNUM_ELEM_SIZE * 8 - 1)) {
+            add_1(&rp[q], &rp[q], 2, add_n(rp, rp, mq, q));
+            sub_1(yp, yp, q + 2, 1);
+        }
+        while (rp[q] != 0 || rp[q+1] != 0 || cmp_n(rp, mq, q) >= 0) {
+            sub_1(&rp[q], &rp[q], 2, sub_n(rp, rp, mq, q));
+            add_1(yp, yp, q + 2, 1);
+        }
+
+        for (size_t i=0; i<q+1; i++)
+            xp[i] = yp[i];
+        p = q;
+    }
+}
+
+int bignum_barrett_init(bignum_barrett_ctx_t *ctx, const bignum_t *m,
+                        bignum_elem_t *arr, bignum_elem_t *scratch) {
+    // Set up ctx for the modulus m and store mu = base^2k / m in arr.
+    // Returns 0 on success and -1 otherwise.
+    size_t k = m->length;
+    bignum_t num, rem, mu, d, qt;
+    bignum_elem_t *mn, *xp, *rp, *tp, qv[2];
+    int c;
+
+    if (k == 0)
+        return -1;
+
+    bignum_assoc_len(&mu, arr, k + 2, 0);
+    if (k >= BIGNUM_BARRETT_THRESHOLD && k > 2) {
+        // With the normalized m' = m * 2^c and x = base^2k / m':
+        // mu = x * 2^c + ((base^2k % m') * 2^c) / m', where the last
+        // quotient is less than 2^c.
+        mn = scratch;
+        xp = &scratch[k];
+        rp = &scratch[2*k + 2];
+        tp = &scratch[3*k + 4];
+        c = count_leading_zeros(m->v[k-1]);
+        lshift_n(mn, m->v, k, c);
+        recip_newton(xp, rp, mn, k, tp);
+
+        tp[k] = lshift_n(tp, rp, k, c);
+        bignum_assoc_len(&num, tp, k + 1, normalized_length(tp, k + 1));
+        bignum_assoc_len(&d, mn, k, k);
+        bignum_assoc_len(&rem, &tp[k + 1], k, 0);
+        bignum_assoc_len(&qt, qv, 2, 0);
+        bignum_divmod(&qt, &rem, &num, &d, &tp[2*k + 1]);
+
+        arr[k+1] = lshift_n(arr, xp, k + 1, c);
+        add_1(arr, arr, k + 2, qt.length > 0 ? qv[0] : 0);
+        mu.length = normalized_length(arr, k + 2);
+    }
+    else {
+        // num = base^2k
+        bignum_assoc_len(&num, scratch, 2*k + 1, 2*k + 1);
+        for (size_t i=0; i<2*k; i++)
+            scratch[i] = 0;
+        scratch[2*k] = 1;
+
+        bignum_assoc_len(&rem, &scratch[2*k + 1], k, 0);
+        if (bignum_divmod(&mu, &rem, &num, m, &scratch[3*k + 1]) != 0)
+            return -1;
+    }
+
+    ctx->m = *m;
+    ctx->mu = mu;
+    return 0;
+}
+
+int bignum_mod_barrett(bignum_t *rop, const bignum_t *op,
+                       const bignum_barrett_ctx_t *ctx, bignum_elem_t *scratch) {
+    // rop = op mod m with op < base^2k
+    //
+    // This is algorithm 14.42 from the Handbook of Applied Cryptography:
+    // q = ((op / base^(k-1)) * mu) / base^(k+1) is at most two too small
+    // (three with the truncated bignum_mulhi()), so
+    // r = op - q * m (mod base^(k+1)) needs at most three subtractions.
+    size_t k = ctx->m.length;
+    bignum_t q1, q3, r2;
+    bignum_elem_t *r, *q2, *r2p;
+    size_t n, q3n, r2n;
+
+    if (op->length > 2*k || rop->max_length < k)
+        return -1;
+
+    if (bignum_cmp(op, &ctx->m) < 0)
+        return bignum_set(rop, op);
+
+    q1.v = &op->v[k-1];
+    q1.length = op->length - (k-1);
+    q1.max_length = q1.length;
+    r = &scratch[2*k + 3];
+
+    if (k < BIGNUM_BARRETT_THRESHOLD) {
+        bignum_assoc_len(&q3, scratch, k + 2, 0);
+        bignum_assoc_len(&r2, &scratch[k + 2], k + 1, 0);
+
+        bignum_mulhi(&q3, &q1, &ctx->mu, k + 1, &scratch[3*k + 4]);
+        bignum_mullo(&r2, &q3, &ctx->m, k + 1);
+        r2p = r2.v;
+        r2n = r2.length;
+    }
+    else {
+        // q2 = q1 * mu and r2 = q3 * m in full, mu has at least
+        // k + 1 elements.
+        q2 = &scratch[3*k + 4];
+        r2p = &scratch[5*k + 7];
+        mul_full(q2, ctx->mu.v, ctx->mu.length, q1.v, q1.length, &scratch[7*k + 9]);
+        q3n = normalized_length(&q2[k + 1], ctx->mu.length + q1.length - (k + 1));
+
+        r2n = 0;
+        if (q3n > 0) {
+            if (q3n >= k)
+                mul_full(r2p, &q2[k + 1], q3n, ctx->m.v, k, &scratch[7*k + 9]);
+            else
+                mul_full(r2p, ctx->m.v, k, &q2[k + 1], q3n, &scratch[7*k + 9]);
+            r2n = normalized_length(r2p, q3n + k < k + 1 ? q3n + k : k + 1);
+        }
+    }
+
+    // r = op mod base^(k+1) - r2 mod base^(k+1)
+    n = op->length < k + 1 ? op->length : k + 1;
+    for (size_t i=0; i<k+1; i++)
+        r[i] = i < n ? op->v[i] : 0;
+    sub_1(&r[r2n], &r[r2n], k + 1 - r2n, sub_n(r, r, r2p, r2n));
+
+    while (r[k] != 0 || cmp_n(r, ctx->m.v, k) >= 0)
+        r[k] -= sub_n(r, r, ctx->m.v, k);
+
+    for (size_t i=0; i<k; i++)
+        rop->v[i] = r[i];
+    rop->length = normalized_length(rop->v, k);
+    return 0;
+}
+
+/*
+ * String conversion:
+ *  - digit_value(), chunk_base(), put_chunks()
+ *  - bignum_get_str()
+ *  - bignum_set_str()
+ *
+ * Decimal digits are converted in chunks of as many digits as fit into
+ * an element (19 with 64 bit elements). Numbers longer than
+ * BIGNUM_GET_STR_THRESHOLD elements are first split by powers of ten
+ * P_k = B^(2^k), B being the chunk base: A number below P_K occupies a
+ * slot of 2^K elements, which bignum_divmod() splits in place into the
+ * remainder and quotient by P_(K-1) in its lower and upper half. This
+ * is repeated level by level down to slots of the threshold size, whose
+ * chunks are then divided out one by one. The powers are computed once
+ * per call and shared by all slots of a level.
+**/
+static int digit_value(char c, int base) {
+    // Return the value of the digit c or -1, if it's no digit of base.
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (base == 16 && c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (base == 16 && c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bignum_elem_t chunk_base(int *digits) {
+    // Return the largest power of ten that fits into an element and set
+    // digits to its exponent.
+    const bignum_elem_t max = BIGNUM_ELEM_MAX;
+    bignum_elem_t b = 10;
+    *digits = 1;
+    while (b <= max / 10) {
+        b *= 10;
+        (*digits)++;
+    }
+    return b;
+}
+
+static void put_chunks(char *str, size_t bound, size_t p, bignum_t *seg, size_t chunks,
+                       const bignum_udiv_ctx_t *ctx, int digits) {
+    // Write chunks * digits decimal digits of seg, starting with digit p
+    // counted from the least significant one, which is str[bound-1].
+    // Digits from bound on are known to be zero and skipped. seg is
+    // destroyed.
+    for (size_t c=0; c<chunks && p<bound; c++) {
+        bignum_elem_t rem = bignum_divmod_ui_pre(seg, seg, ctx);
+        for (int i=0; i<digits && p<bound; i++, p++) {
+            str[bound - 1 - p] = '0' + (char) (rem % 10);
+            rem /= 10;
+        }
+    }
+}
+
+int bignum_get_str(char *str, size_t size, const bignum_t *op, int base,
+                   bignum_elem_t *scratch) {
+    size_t n = op->length;
+    size_t bits, bound, zeros;
+    bignum_udiv_ctx_t ctx;
+    bignum_t seg;
+    int digits;
+
+    if (base != 10 && base != 16)
+        return -1;
+
+    if (n == 0) {
+        if (size < 2)
+            return -1;
+        str[0] = '0';
+        str[1] = '\0';
+        return 1;
+    }
+
+    bits = n * BIGNUM_ELEM_SIZE * 8 - count_leading_zeros(op->v[n-1]);
+
+    if (base == 16) {
+        const size_t per_elem = BIGNUM_ELEM_SIZE * 2;
+        bound = (bits + 3) / 4;
+        if (size <= bound)
+            return -1;
+
+        for (size_t p=0; p<bound; p++) {
+            int nibble = (op->v[p / per_elem] >> (p % per_elem * 4)) & 15;
+            str[bound - 1 - p] = (char) (nibble < 10 ? '0' + nibble : 'a' + nibble - 10);
+        }
+        str[bound] = '\0';
+        return (int) bound;
+    }
+
+    // An upper bound of the number of digits, log10(2) < 0.30103.
+    bound = bits * 30103 / 100000 + 1;
+    if (size <= bound)
+        return -1;
+
+    bignum_udiv_init(&ctx, chunk_base(&digits));
+
+    if (n <= BIGNUM_GET_STR_THRESHOLD) {
+        bignum_assoc_len(&seg, scratch, n, 0);
+        bignum_set(&seg, op);
+        put_chunks(str, bound, 0, &seg, (bound + digits - 1) / digits, &ctx, digits);
+    }
+    else {
+        // 2^K < 2.5 * n for the smallest K with P_K > op, so the powers
+        // fit into 6n elements, the slots into 3n.
+        const size_t pmax = 3 * n;
+        bignum_elem_t *pw = scratch;
+        bignum_elem_t *buf = &scratch[2 * pmax];
+        bignum_elem_t *work = &scratch[3 * pmax];
+        bignum_t p, next, q, r;
+        size_t top = 1, slot;
+
+        // P_k is stored at pw[2^k - 1] with room for 2^k elements.
+        pw[0] = ctx.d;
+        bignum_assoc_len(&p, pw, 1, 1);
+        while (bignum_cmp(&p, op) <= 0) {
+            bignum_assoc_len(&next, &pw[2*top - 1], 2*top, 0);
+            bignum_sqr_scratch(&next, &p, work);
+            for (size_t i=next.length; i<2*top; i++)
+                next.v[i] = 0;
+            p = next;
+            top *= 2;
+        }
+
+        for (size_t i=0; i<top; i++)
+            buf[i] = i < n ? op->v[i] : 0;
+
+        for (slot=top; slot > BIGNUM_GET_STR_THRESHOLD; slot /= 2) {
+            size_t half = slot / 2;
+            bignum_assoc_len(&p, &pw[half - 1], half, normalized_length(&pw[half - 1], half));
+
+            for (size_t s=0; s < top / slot; s++) {
+                bignum_elem_t *v = &buf[s * slot];
+                bignum_assoc_len(&seg, v, slot, normalized_length(v, slot));
+                bignum_assoc_len(&r, v, half, 0);
+                bignum_assoc_len(&q, &v[half], half, 0);
+                bignum_divmod(&q, &r, &seg, &p, work);
+
+                for (size_t i=r.length; i<half; i++)
+                    v[i] = 0;
+                for (size_t i=q.length; i<half; i++)
+                    v[half + i] = 0;
+            }
+        }
+
+        // Every slot now holds exactly slot chunks. These may be fewer
+        // digits than the estimate, whose leading ones are zero then.
+        for (size_t i=0; i + top * digits < bound; i++)
+            str[i] = '0';
+        for (size_t s=0; s < top / slot; s++) {
+            bignum_elem_t *v = &buf[s * slot];
+            bignum_assoc_len(&seg, v, slot, normalized_length(v, slot));
+            put_chunks(str, bound, s * slot * digits, &seg, slot, &ctx, digits);
+        }
+    }
+
+    // Move the digits over the leading zeros.
+    for (zeros=0; zeros < bound - 1 && str[zeros] == '0'; zeros++)
+        ;
+    for (size_t i=zeros; i<bound; i++)
+        str[i - zeros] = str[i];
+    str[bound - zeros] = '\0';
+    return (int) (bound - zeros);
+}
+
+int bignum_set_str(bignum_t *rop, const char *str, int base) {
+    size_t len = 0;
+    size_t n = 0;
+    int overflow = 0;
+    int digits;
+
+    if (base != 10 && base != 16)
+        return -1;
+    while (str[len] != '\0') {
+        if (digit_value(str[len], base) < 0)
+            return -1;
+        len++;
+    }
+    if (len == 0)
+        return -1;
+
+    if (base == 16) {
+        const size_t per_elem = BIGNUM_ELEM_SIZE * 2;
+        for (size_t p=0; p<len; p++) {
+            bignum_elem_t nibble = digit_value(str[len - 1 - p], base);
+            size_t i = p / per_elem;
+            if (i >= rop->max_length) {
+                overflow |= nibble != 0;
+                continue;
+            }
+            if (p % per_elem == 0) {
+                rop->v[i] = 0;
+                n++;
+            }
+            rop->v[i] |= nibble << (p % per_elem * 4);
+        }
+        rop->length = normalized_length(rop->v, n);
+        return overflow;
+    }
+
+    // rop = rop * 10^k + chunk for chunks of k digits, only the first
+    // one may be shorter than a full chunk.
+    chunk_base(&digits);
+    for (size_t p=0, k = (len - 1) % digits + 1; p<len; p+=k, k=digits) {
+        bignum_elem_t chunk = 0, scale = 1, carry;
+        for (size_t i=p; i<p+k; i++) {
+            chunk = chunk * 10 + digit_value(str[i], base);
+            scale *= 10;
+        }
+
+        carry = mul_1(rop->v, rop->v, n, scale);
+        carry += add_1(rop->v, rop->v, n, chunk);
+        if (carry != 0) {
+            if (n < rop->max_length)
+                rop->v[n++] = carry;
+            else
+                overflow = 1;
+        }
+    }
+    rop->length = normalized_length(rop->v, n);
+    return overflow;
+}
+
+/*
+ * Import and export:
+ *  - host_endian(), bswap_elem(), load_elem(), store_elem(), word_offset()
+ *  - bignum_import(), bignum_export()
+ *  - bignum_assoc_bytes()
+ *
+ * If the bytes of an element are contiguous in the data, i.e. for plain
+ * byte strings (order == endian) and words of one element, every element
+ * is read at once, byte swapped if needed. Otherwise and for the bytes of
+ * a partial top element, the bytes are moved one by one.
+**/
+static inline int host_endian(void) {
+    // 1 on big-endian and -1 on little-endian machines.
+    const unsigned int one = 1;
+    return *(const unsigned char *) &one == 1 ? -1 : 1;
+}
+
+static inline bignum_elem_t bswap_elem(bignum_elem_t x) {
+#if !defined(__OPENCL_VERSION__) && defined(__GNUC__)
+    if (BIGNUM_ELEM_SIZE == 8)
+        return (bignum_elem_t) __builtin_bswap64(x);
+    if (BIGNUM_ELEM_SIZE == 4)
+        return (bignum_elem_t) __builtin_bswap32(x);
+    if (BIGNUM_ELEM_SIZE == 2)
+        return (bignum_elem_t) __builtin_bswap16(x);
+    return x;
+#else
+    bignum_elem_t r = 0;
+    for (size_t i=0; i<BIGNUM_ELEM_SIZE; i++) {
+        r = (bignum_elem_t) (r << 8) | (x & 0xff);
+        x >>= 8;
+    }
+    return r;
+#endif
+}
+
+static inline bignum_elem_t load_elem(const unsigned char *p, int endian) {
+    // Read an element from BIGNUM_ELEM_SIZE bytes at p in the given byte
+    // order. p doesn't have to be aligned.
+#if !defined(__OPENCL_VERSION__) && defined(__GNUC__)
+    bignum_elem_t e;
+    __builtin_memcpy(&e, p, BIGNUM_ELEM_SIZE);
+    return endian == host_endian() ? e : bswap_elem(e);
+#else
+    bignum_elem_t e = 0;
+    for (size_t i=0; i<BIGNUM_ELEM_SIZE; i++)
+        e |= (bignum_elem_t) p[endian == 1 ? BIGNUM_ELEM_SIZE-1-i : i] << (8 * i);
+    return e;
+#endif
+}
+
+static inline void store_elem(unsigned char *p, bignum_elem_t e, int endian) {
+    // Write e to BIGNUM_ELEM_SIZE bytes at p in the given byte order.
+#if !defined(__OPENCL_VERSION__) && defined(__GNUC__)
+    if (endian != host_endian())
+        e = bswap_elem(e);
+    __builtin_memcpy(p, &e, BIGNUM_ELEM_SIZE);
+#else
+    for (size_t i=0; i<BIGNUM_ELEM_SIZE; i++)
+        p[endian == 1 ? BIGNUM_ELEM_SIZE-1-i : i] = (unsigned char) (e >> (8 * i));
+#endif
+}
+
+static inline size_t word_offset(size_t k, size_t count, int order, size_t size, int endian) {
+    // The offset of the k-th least significant byte in count words of
+    // size bytes.
+    size_t w = k / size, b = k % size;
+    return (order == 1 ? count - 1 - w : w) * size + (endian == 1 ? size - 1 - b : b);
+}
+
+int bignum_import(bignum_t *rop, const void *data, size_t count, int order, size_t size,
+                  int endian) {
+    const unsigned char *p = (const unsigned char *) data;
+    const size_t total = count * size;
+    size_t n, i, k;
+    int overflow = 0;
+
+    if ((order != 1 && order != -1) || size == 0 || endian < -1 || endian > 1)
+        return -1;
+    if (endian == 0)
+        endian = host_endian();
+    // A byte array is a byte string in word order.
+    if (size == 1)
+        endian = order;
+
+    // Whole elements with contiguous bytes, element i is at the end of
+    // the data for order == 1.
+    n = order == endian || size == BIGNUM_ELEM_SIZE ? total / BIGNUM_ELEM_SIZE : 0;
+    if (n > rop->max_length)
+        n = rop->max_length;
+    for (i=0; i<n; i++)
+        rop->v[i] = load_elem(order == 1 ? &p[total - (i+1) * BIGNUM_ELEM_SIZE]
+                                         : &p[i * BIGNUM_ELEM_SIZE], endian);
+
+    // The remaining bytes one by one.
+    for (k = n * BIGNUM_ELEM_SIZE; k < total; k++) {
+        const unsigned char byte = p[word_offset(k, count, order, size, endian)];
+        i = k / BIGNUM_ELEM_SIZE;
+        if (i >= rop->max_length) {
+            overflow |= byte != 0;
+            continue;
+        }
+        if (k % BIGNUM_ELEM_SIZE == 0) {
+            rop->v[i] = 0;
+            n++;
+        }
+        rop->v[i] |= (bignum_elem_t) byte << (8 * (k % BIGNUM_ELEM_SIZE));
+    }
+    rop->length = normalized_length(rop->v, n);
+    return overflow;
+}
+
+int bignum_export(void *data, size_t count, int order, size_t size, int endian,
+                  const bignum_t *op) {
+    unsigned char *p = (unsigned char *) data;
+    const size_t total = count * size;
+    size_t needed = 0, n, i, k;
+
+    if ((order != 1 && order != -1) || size == 0 || endian < -1 || endian > 1)
+        return -1;
+    if (endian == 0)
+        endian = host_endian();
+    if (size == 1)
+        endian = order;
+
+    // The number of significant bytes of op.
+    if (op->length > 0) {
+        needed = (op->length - 1) * BIGNUM_ELEM_SIZE;
+        for (bignum_elem_t top = op->v[op->length-1]; top != 0; top >>= 8)
+            needed++;
+    }
+    if (needed > total)
+        return -1;
+
+    n = order == endian || size == BIGNUM_ELEM_SIZE ? total / BIGNUM_ELEM_SIZE : 0;
+    for (i=0; i<n; i++)
+        store_elem(order == 1 ? &p[total - (i+1) * BIGNUM_ELEM_SIZE] : &p[i * BIGNUM_ELEM_SIZE],
+                   i < op->length ? op->v[i] : 0, endian);
+
+    for (k = n * BIGNUM_ELEM_SIZE; k < total; k++) {
+        i = k / BIGNUM_ELEM_SIZE;
+        p[word_offset(k, count, order, size, endian)] =
+            i < op->length ? (unsigned char) (op->v[i] >> (8 * (k % BIGNUM_ELEM_SIZE))) : 0;
+    }
+    return 0;
+}
+
+int bignum_assoc_bytes(bignum_t *num, void *data, const size_t size, int endian) {
+    bignum_elem_t *arr = (bignum_elem_t *) data;
+    const size_t n = size / BIGNUM_ELEM_SIZE;
+
+    if (endian < -1 || endian > 1 || size % BIGNUM_ELEM_SIZE != 0 ||
+        (size_t) data % BIGNUM_ELEM_SIZE != 0)
+        return -1;
+    if (endian == 0)
+        endian = host_endian();
+
+    // Big-endian data has the most significant element first, swap the
+    // elements from both ends. Elements of the other byte order than the
+    // host's are byte swapped.
+    if (endian == 1) {
+        for (size_t i=0; i < n/2; i++) {
+            bignum_elem_t tmp = arr[i];
+            arr[i] = arr[n-1-i];
+            arr[n-1-i] = tmp;
+        }
+    }
+    if (endian != host_endian()) {
+        for (size_t i=0; i<n; i++)
+            arr[i] = bswap_elem(arr[i]);
+    }
+    bignum_assoc(num, arr, n);
+    return 0;
+}
+
+/*
+ * Greatest common divisor:
+ *  - gcd_1(), strip_zeros(), top_bits(), lehmer_step()
+ *  - mul_sub(), mul_add()
+ *  - bignum_gcd()
+ *  - bignum_gcdext(), bignum_invert()
+ *
+ * bignum_gcd() removes the common factors of two first. Numbers up to
+ * BIGNUM_GCD_THRESHOLD elements are then reduced by the binary
+ * algorithm: The larger one is replaced by the difference, which is
+ * even, and the trailing zero bits are shifted out.
+ *
+ * Longer numbers are reduced by Lehmer's algorithm: lehmer_step() runs
+ * Euclid's algorithm on the leading bits of both numbers (two elements
+ * with BIGNUM_DELEM_TYPE, so every step removes about one element) as
+ * long as the quotients are certainly the ones of the full numbers, and
+ * collects them in a matrix of single element cofactors. Applying the
+ * matrix to the numbers then takes the place of all those steps. If
+ * not even one quotient is certain, e.g. because the numbers differ a
+ * lot in size, a full division step is done instead.
+ *
+ * bignum_gcdext() applies the same steps to the cofactors of both
+ * numbers. Their signs alternate, so only the magnitudes are stored
+ * and the sign is tracked by the parity of the number of steps.
+**/
+#ifdef BIGNUM_DELEM_TYPE
+typedef BIGNUM_DELEM_TYPE gcd_digit_t;
+#else
+typedef bignum_elem_t gcd_digit_t;
+#endif
+#define GCD_DIGIT_BITS (sizeof(gcd_digit_t) * 8)
+#define GCD_DIGIT_ELEMS (sizeof(gcd_digit_t) / BIGNUM_ELEM_SIZE)
+
+static bignum_elem_t gcd_1(bignum_elem_t u, bignum_elem_t v) {
+    // Binary GCD of u > 0 and v > 0.
+    int k = count_trailing_zeros(u | v);
+    bignum_elem_t tmp;
+
+    u >>= count_trailing_zeros(u);
+    do {
+        v >>= count_trailing_zeros(v);
+        if (u > v) {
+            tmp = u;
+            u = v;
+            v = tmp;
+        }
+        v -= u;
+    } while (v != 0);
+    return u << k;
+}
+
+static size_t strip_zeros(bignum_elem_t *rp, const bignum_elem_t *ap, size_t n,
+                          size_t *zeros) {
+    // rp = ap >> zeros for ap > 0, zeros being the number of trailing
+    // zero bits of ap. rp may be ap. Returns the length of rp.
+    size_t i = 0;
+    int s;
+
+    while (ap[i] == 0)
+        i++;
+    s = count_trailing_zeros(ap[i]);
+    rshift_n(rp, &ap[i], n - i, s);
+    *zeros = i * BIGNUM_ELEM_SIZE * 8 + s;
+    return normalized_length(rp, n - i);
+}
+
+static gcd_digit_t top_bits(const bignum_elem_t *ap, size_t n, size_t h) {
+    // Return ap >> h for ap < 2^(h + GCD_DIGIT_BITS). The elements from
+    // n upwards are zero.
+    size_t i = h / (BIGNUM_ELEM_SIZE * 8);
+    int s = h % (BIGNUM_ELEM_SIZE * 8);
+    gcd_digit_t x = 0;
+
+    for (size_t j=GCD_DIGIT_ELEMS; j>0; j--)
+        x = ((x << (BIGNUM_ELEM_SIZE * 8 - 1)) << 1) | (i + j - 1 < n ? ap[i + j - 1] : 0);
+    x >>= s;
+    if (s > 0 && i + GCD_DIGIT_ELEMS < n)
+        x |= (gcd_digit_t) ap[i + GCD_DIGIT_ELEMS] << (GCD_DIGIT_BITS - s);
+    return x;
+}
+
+static int lehmer_step(gcd_digit_t x, gcd_digit_t y, bignum_elem_t *m) {
+    // Run Euclid's algorithm on x >= y, the leading bits of u >= v, as
+    // long as the quotients are the ones of u and v. Returns the number
+    // of steps k and the magnitudes m = {A, B, C, D} of the cofactors:
+    // u' = A*u - B*v, v' = D*v - C*u for even k and
+    // u' = B*v - A*u, v' = C*u - D*v for odd k.
+    //
+    // x and y are u and v divided by the same power of two and
+    // truncated, so after k steps the remainders of u and v divided by
+    // that power lie between x - B and x + A and between y - C and
+    // y + D for even k (x - A, x + B, y - D and y + C for odd k). The
+    // quotient q = x / y with remainder r is the one of u and v, if it
+    // is the quotient of the bounds as well (Knuth, TAOCP Vol. 2, 4.5.2,
+    // Algorithm L). With the next cofactors C' = A + q*C, D' = B + q*D
+    // this comes down to D' <= r and C' + C < y - r for even k (and
+    // C' <= r and D' + D < y - r for odd k), which needs no division.
+    const bignum_elem_t max = BIGNUM_ELEM_MAX;
+    gcd_digit_t a = 1, b = 0, c = 0, d = 1, q, r, nc, nd;
+    int k = 0;
+
+    while (y > 0) {
+        // Most quotients are small.
+        q = 1;
+        r = x - y;
+        if ((x >> 2) < y) {
+            while (r >= y) {
+                r -= y;
+                q++;
+            }
+        }
+        else {
+            // A division of elements is cheaper, if x fits into one.
+            q = x <= max ? (bignum_elem_t) x / (bignum_elem_t) y : x / y;
+            r = x - q * y;
+        }
+
+        // The cofactors of the exact steps on x and y never exceed x,
+        // but they have to fit into an element.
+        nc = a + q * c;
+        nd = b + q * d;
+        if (nc > max || nd > max)
+            break;
+        if ((k & 1) == 0) {
+            if (nd > r || c >= y - r || nc >= y - r - c)
+                break;
+        }
+        else {
+            if (nc > r || d >= y - r || nd >= y - r - d)
+                break;
+        }
+
+        a = c;
+        b = d;
+        c = nc;
+        d = nd;
+        x = y;
+        y = r;
+        k++;
+    }
+
+    m[0] = (bignum_elem_t) a;
+    m[1] = (bignum_elem_t) b;
+    m[2] = (bignum_elem_t) c;
+    m[3] = (bignum_elem_t) d;
+    return k;
+}
+
+static size_t mul_sub(bignum_elem_t *rp, const bignum_elem_t *ap, size_t an, bignum_elem_t x,
+                      const bignum_elem_t *bp, size_t bn, bignum_elem_t y, size_t n) {
+    // rp[0..n) = ap * x - bp * y with an <= n, 0 < bn <= n, if the result
+    // is less than base^n and not negative. Returns the length of rp.
+    bignum_elem_t c = mul_1(rp, ap, an, x);
+    for (size_t i=an; i<n; i++) {
+        rp[i] = c;
+        c = 0;
+    }
+    c = submul_1(rp, bp, bn, y);
+    sub_1(&rp[bn], &rp[bn], n - bn, c);
+    return normalized_length(rp, n);
+}
+
+static size_t mul_add(bignum_elem_t *rp, const bignum_elem_t *ap, size_t an, bignum_elem_t x,
+                      const bignum_elem_t *bp, size_t bn, bignum_elem_t y) {
+    // rp = ap * x + bp * y, rp must hold max(an, bn) + 2 elements.
+    // Returns the length of rp.
+    const bignum_elem_t *tp;
+    bignum_elem_t c;
+    size_t tn;
+
+    if (an < bn) {
+        tp = ap; ap = bp; bp = tp;
+        tn = an; an = bn; bn = tn;
+        c = x; x = y; y = c;
+    }
+    if (an == 0)
+        return 0;
+
+    rp[an] = mul_1(rp, ap, an, x);
+    c = addmul_1(rp, bp, bn, y);
+    c = add_1(&rp[bn], &rp[bn], an + 1 - bn, c);
+    rp[an+1] = c;
+    return normalized_length(rp, an + 2);
+}
+
+int bignum_gcd(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+               bignum_elem_t *scratch) {
+    // rop = gcd(op1, op2)
+    // Returns 0 on success and -1 if rop is too small.
+    size_t n = op1->length > op2->length ? op1->length : op2->length;
+    bignum_elem_t *u = scratch;
+    bignum_elem_t *v = &scratch[n+1];
+    bignum_elem_t *t1 = &scratch[2*(n+1)];
+    bignum_elem_t *t2 = &scratch[3*(n+1)];
+    bignum_elem_t *tmp, m[4], hi;
+    size_t un, vn, tn, zeros, k, h;
+    bignum_t a, b;
+    int steps;
+
+    if (op1->length == 0 || op2->length == 0)
+        return bignum_set(rop, op1->length == 0 ? op2 : op1);
+
+    // gcd(op1, op2) = 2^k * gcd(u, v) with odd u and v.
+    un = strip_zeros(u, op1->v, op1->length, &k);
+    vn = strip_zeros(v, op2->v, op2->length, &zeros);
+    if (zeros < k)
+        k = zeros;
+
+    for (;;) {
+        if (un < vn || (un == vn && cmp_n(u, v, un) < 0)) {
+            tmp = u; u = v; v = tmp;
+            tn = un; un = vn; vn = tn;
+        }
+        if (vn == 0 || un <= 1 || un <= BIGNUM_GCD_THRESHOLD)
+            break;
+
+        h = bit_length(u, un);
+        h = h >= GCD_DIGIT_BITS ? h - (GCD_DIGIT_BITS - 1) : 0;
+        steps = lehmer_step(top_bits(u, un, h), top_bits(v, vn, h), m);
+        if (steps == 0) {
+            // u = u % v, the order is fixed above.
+            bignum_assoc_len(&a, u, n + 1, un);
+            bignum_assoc_len(&b, v, n + 1, vn);
+            bignum_mod(&a, &a, &b, &scratch[4*(n+1)]);
+            un = a.length;
+            continue;
+        }
+
+        if (steps & 1) {
+            tn = mul_sub(t1, v, vn, m[1], u, un, m[0], un);
+            vn = mul_sub(t2, u, un, m[2], v, vn, m[3], un);
+        }
+        else {
+            tn = mul_sub(t1, u, un, m[0], v, vn, m[1], un);
+            vn = mul_sub(t2, v, vn, m[3], u, un, m[2], un);
+        }
+        tmp = u; u = t1; t1 = tmp;
+        tmp = v; v = t2; t2 = tmp;
+        un = tn;
+    }
+
+    // Binary algorithm, u and v don't have common factors of two.
+    if (vn > 0) {
+        un = strip_zeros(u, u, un, &zeros);
+        vn = strip_zeros(v, v, vn, &zeros);
+    }
+    while (vn > 0) {
+        if (un < vn || (un == vn && cmp_n(u, v, un) < 0)) {
+            tmp = u; u = v; v = tmp;
+            tn = un; un = vn; vn = tn;
+        }
+        if (un == 1) {
+            u[0] = gcd_1(u[0], v[0]);
+            break;
+        }
+        sub_1(&u[vn], &u[vn], un - vn, sub_n(u, u, v, vn));
+        un = normalized_length(u, un);
+        if (un == 0)
+            break;
+        un = strip_zeros(u, u, un, &zeros);
+    }
+    if (un == 0) {
+        u = v;
+        un = vn;
+    }
+
+    // rop = u << k
+    h = k / (BIGNUM_ELEM_SIZE * 8);
+    k %= BIGNUM_ELEM_SIZE * 8;
+    hi = k > 0 ? (u[un-1] >> 1) >> (BIGNUM_ELEM_SIZE * 8 - 1 - k) : 0;
+    tn = un + h + (hi != 0);
+    if (rop->max_length < tn)
+        return -1;
+    for (size_t i=0; i<h; i++)
+        rop->v[i] = 0;
+    lshift_n(&rop->v[h], u, un, k);
+    if (hi != 0)
+        rop->v[tn-1] = hi;
+    rop->length = tn;
+    return 0;
+}
+
+static size_t mul_add_q(bignum_elem_t *rp, const bignum_elem_t *ap, size_t an,
+                        const bignum_elem_t *qp, size_t qn, const bignum_elem_t *bp, size_t bn) {
+    // rp = ap + qp * bp, rp must hold max(an, qn + bn) + 2 elements.
+    // Returns the length of rp.
+    size_t l = qn + bn;
+
+    if (qn <= 1 || bn == 0)
+        return mul_add(rp, ap, an, 1, bp, bn, qn == 0 ? 0 : qp[0]);
+
+    mul_basecase_lo(rp, l, qp, qn, bp, bn);
+    for (; l < an; l++)
+        rp[l] = 0;
+    rp[l] = add_1(&rp[an], &rp[an], l - an, add_n(rp, rp, ap, an));
+    return normalized_length(rp, l + 1);
+}
+
+static int set_cofactor(bignum_t *rop, bignum_elem_t *up, size_t un,
+                        const bignum_elem_t *vp, size_t vn, int odd) {
+    // rop = u for an even and v - u for an odd number of steps, up is
+    // changed. Returns 0 on success and -1 if rop is too small.
+    if (odd) {
+        for (size_t i=un; i<vn; i++)
+            up[i] = 0;
+        sub_n(up, vp, up, vn);
+        un = normalized_length(up, vn);
+    }
+    if (rop->max_length < un)
+        return -1;
+    for (size_t i=0; i<un; i++)
+        rop->v[i] = up[i];
+    rop->length = un;
+    return 0;
+}
+
+int bignum_gcdext(bignum_t *g, bignum_t *s, bignum_t *t, const bignum_t *op1,
+                  const bignum_t *op2, bignum_elem_t *scratch) {
+    // g = gcd(op1, op2) = op1 * s - op2 * t
+    // Returns 0 on success and -1 otherwise.
+    //
+    // Every remainder u is op1 * su - op2 * tu for an even number of
+    // steps and op2 * tu - op1 * su for an odd one, v the other way
+    // round. At the end sv = op2 / g and tv = op1 / g.
+    size_t n = op1->length > op2->length ? op1->length : op2->length;
+    bignum_elem_t *u = scratch;
+    bignum_elem_t *v = &scratch[n+1];
+    bignum_elem_t *w1 = &scratch[2*(n+1)];
+    bignum_elem_t *w2 = &scratch[3*(n+1)];
+    bignum_elem_t *q = &scratch[4*(n+1)];
+    bignum_elem_t *su = &scratch[5*(n+1)];
+    bignum_elem_t *sv = &su[n+2];
+    bignum_elem_t *s1 = &su[2*(n+2)];
+    bignum_elem_t *s2 = &su[3*(n+2)];
+    bignum_elem_t *tu = &su[4*(n+2)];
+    bignum_elem_t *tv = &su[5*(n+2)];
+    bignum_elem_t *t1 = &su[6*(n+2)];
+    bignum_elem_t *t2 = &su[7*(n+2)];
+    bignum_elem_t *tmp, m[4];
+    size_t un, vn, qn, sun = 1, svn = 0, tun = 0, tvn = 1, h;
+    int steps, odd = 0;
+    bignum_t a, b, qt;
+
+    if (op1->length == 0) {
+        if (op2->length != 0)
+            return -1;
+        g->length = 0;
+        if (s != NULL)
+            s->length = 0;
+        if (t != NULL)
+            t->length = 0;
+        return 0;
+    }
+
+    un = op1->length;
+    vn = op2->length;
+    for (size_t i=0; i<un; i++)
+        u[i] = op1->v[i];
+    for (size_t i=0; i<vn; i++)
+        v[i] = op2->v[i];
+    su[0] = 1;
+    tv[0] = 1;
+
+    while (vn > 0) {
+        steps = 0;
+        if (un > vn || (un == vn && cmp_n(u, v, un) >= 0)) {
+            h = bit_length(u, un);
+            h = h >= GCD_DIGIT_BITS ? h - (GCD_DIGIT_BITS - 1) : 0;
+            steps = lehmer_step(top_bits(u, un, h), top_bits(v, vn, h), m);
+        }
+
+        if (steps > 0) {
+            if (steps & 1) {
+                h = mul_sub(w1, v, vn, m[1], u, un, m[0], un);
+                vn = mul_sub(w2, u, un, m[2], v, vn, m[3], un);
+            }
+            else {
+                h = mul_sub(w1, u, un, m[0], v, vn, m[1], un);
+                vn = mul_sub(w2, v, vn, m[3], u, un, m[2], un);
+            }
+            un = h;
+            tmp = u; u = w1; w1 = tmp;
+            tmp = v; v = w2; w2 = tmp;
+
+            // The products of the cofactors have the same sign.
+            if (s != NULL) {
+                h = mul_add(s1, su, sun, m[0], sv, svn, m[1]);
+                svn = mul_add(s2, su, sun, m[2], sv, svn, m[3]);
+                sun = h;
+                tmp = su; su = s1; s1 = tmp;
+                tmp = sv; sv = s2; s2 = tmp;
+            }
+            if (t != NULL) {
+                h = mul_add(t1, tu, tun, m[0], tv, tvn, m[1]);
+                tvn = mul_add(t2, tu, tun, m[2], tv, tvn, m[3]);
+                tun = h;
+                tmp = tu; tu = t1; t1 = tmp;
+                tmp = tv; tv = t2; t2 = tmp;
+            }
+            odd ^= steps & 1;
+            continue;
+        }
+
+        // Division step: (u, v) = (v, u % v) with quotient q.
+        if (un == 1 && vn == 1) {
+            q[0] = u[0] / v[0];
+            u[0] -= q[0] * v[0];
+            qn = q[0] != 0;
+            un = u[0] != 0;
+        }
+        else {
+            bignum_assoc_len(&qt, q, n + 1, 0);
+            bignum_assoc_len(&a, u, n + 1, un);
+            bignum_assoc_len(&b, v, n + 1, vn);
+            bignum_divmod(&qt, &a, &a, &b, &scratch[5*(n+1) + 8*(n+2)]);
+            qn = qt.length;
+            un = a.length;
+        }
+        tmp = u; u = v; v = tmp;
+        h = un; un = vn; vn = h;
+
+        // The new cofactors of v are the ones of u plus q times the ones
+        // of v, the ones of u are the old ones of v.
+        if (s != NULL) {
+            h = mul_add_q(s1, su, sun, q, qn, sv, svn);
+            tmp = su; su = sv; sv = s1; s1 = tmp;
+            sun = svn;
+            svn = h;
+        }
+        if (t != NULL) {
+            h = mul_add_q(t1, tu, tun, q, qn, tv, tvn);
+            tmp = tu; tu = tv; tv = t1; t1 = tmp;
+            tun = tvn;
+            tvn = h;
+        }
+        odd ^= 1;
+    }
+
+    if (g->max_length < un)
+        return -1;
+    for (size_t i=0; i<un; i++)
+        g->v[i] = u[i];
+    g->length = un;
+
+    if (s != NULL && set_cofactor(s, su, sun, sv, svn, odd) < 0)
+        return -1;
+    if (t != NULL && set_cofactor(t, tu, tun, tv, tvn, odd) < 0)
+        return -1;
+    return 0;
+}
+
+int bignum_invert(bignum_t *rop, const bignum_t *op, const bignum_t *m,
+                  bignum_elem_t *scratch) {
+    // rop = op^-1 mod m
+    // Returns 0 on success, 1 if op is not invertible and -1 otherwise.
+    size_t n = m->length;
+    bignum_t a, g;
+
+    if (n == 0 || op->length > n)
+        return -1;
+    if (n == 1 && m->v[0] == 1) {
+        rop->length = 0;
+        return 0;
+    }
+
+    // op * s - m * t = gcd(op, m) = 1
+    bignum_assoc_len(&a, scratch, n, 0);
+    bignum_assoc_len(&g, &scratch[n], n, 0);
+    bignum_mod(&a, op, m, &scratch[2*n]);
+    if (a.length == 0)
+        return 1;
+    if (bignum_gcdext(&g, rop, NULL, &a, m, &scratch[2*n]) < 0)
+        return -1;
+    return g.length == 1 && g.v[0] == 1 ? 0 : 1;
+}
+
+/*
+ * Primality tests:
+ *  - bignum_trial_division()
+ *  - bignum_miller_rabin_mont(), bignum_miller_rabin()
+ *  - bignum_is_probab_prime()
+ *
+ * Trial division by the primes below 256 (which fit into every element
+ * type) decides all numbers below 2^16 and removes most composites.
+ * The Miller-Rabin rounds work in Montgomery form: With n - 1 = d * 2^s
+ * and x = base^d, n passes if x is 1 or x^(2^i) is n - 1 for some i < s,
+ * which are compared with R mod n and n - (R mod n).
+**/
+#ifdef __OPENCL_VERSION__
+static constant unsigned char small_primes[BIGNUM_SMALL_PRIMES] = {
+#else
+static const unsigned char small_primes[BIGNUM_SMALL_PRIMES] = {
+#endif
+      2,   3,   5,   7,  11,  13,  17,  19,  23,  29,  31,  37,  41,  43,
+     47,  53,  59,  61,  67,  71,  73,  79,  83,  89,  97, 101, 103, 107,
+    109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181,
+    191, 193, 197, 199, 211, 223, 227, 229, 233, 239, 241, 251
+};
+
+int bignum_trial_division(const bignum_t *n) {
+    // Returns 2 if n is a prime, 0 if it is composite (or less than 2)
+    // and 1 if it has no factor below 256.
+    bignum_elem_t primes[BIGNUM_SMALL_PRIMES], rem[BIGNUM_SMALL_PRIMES];
+
+    if (n->length == 0 || (n->length == 1 && n->v[0] < 2))
+        return 0;
+
+    // All remainders in one pass over n.
+    for (size_t i=0; i<BIGNUM_SMALL_PRIMES; i++)
+        primes[i] = small_primes[i];
+    bignum_mod_ui_multi(n, primes, rem, BIGNUM_SMALL_PRIMES);
+
+    for (size_t i=0; i<BIGNUM_SMALL_PRIMES; i++) {
+        if (rem[i] == 0)
+            return bignum_cmp_ui(n, small_primes[i]) == 0 ? 2 : 0;
+    }
+
+    // Composites below 256^2 have a factor below 256.
+    return bit_length(n->v, n->length) <= 16 ? 2 : 1;
+}
+
+int bignum_miller_rabin_mont(const bignum_mont_ctx_t *ctx, bignum_elem_t base,
+                             bignum_elem_t *scratch) {
+    // Returns 1 if n = ctx->m passes the round with base, 0 if n is
+    // composite and -1 if n is less than 3.
+    //
+    // x stays in Montgomery form from the exponentiation on.
+    const bignum_elem_t one_elem = 1;
+    const bignum_t *n = &ctx->m;
+    size_t k = n->length, s, dn;
+    bignum_elem_t *one = scratch, *minus_one = &scratch[k];
+    bignum_elem_t *dp = &scratch[2*k], *xp = &scratch[3*k], *tp = &scratch[4*k];
+    bignum_t a, d;
+
+    if (k == 1 && n->v[0] < 3)
+        return -1;
+
+    // The bases 0, 1 and n - 1 (mod n) pass for every n.
+    if (k == 1)
+        base %= n->v[0];
+    if (base <= 1 || (k == 1 && base == n->v[0] - 1))
+        return 1;
+
+    mont_mul(one, &one_elem, 1, ctx->r2.v, ctx->r2.length, ctx, tp);
+    sub_n(minus_one, n->v, one, k);
+
+    // n - 1 = d * 2^s with odd d
+    sub_1(dp, n->v, k, 1);
+    dn = strip_zeros(dp, dp, k, &s);
+
+    bignum_assoc_len(&a, &base, 1, 1);
+    bignum_assoc_len(&d, dp, k, dn);
+    powm_mont(xp, &a, &d, ctx, tp);
+
+    if (cmp_n(xp, one, k) == 0 || cmp_n(xp, minus_one, k) == 0)
+        return 1;
+    for (size_t i=1; i<s; i++) {
+        mont_sqr(xp, xp, k, ctx, tp);
+        if (cmp_n(xp, minus_one, k) == 0)
+            return 1;
+        // 1 without -1 before it: x has a nontrivial square root of 1.
+        if (cmp_n(xp, one, k) == 0)
+            return 0;
+    }
+    return 0;
+}
+
+int bignum_miller_rabin(const bignum_t *n, bignum_elem_t base, bignum_elem_t *scratch) {
+    // Returns 1 if n passes the round with base, 0 if n is composite
+    // and -1 if n is even or less than 3.
+    bignum_mont_ctx_t ctx;
+
+    if (bignum_mont_init_scratch(&ctx, n, scratch, &scratch[n->length]) != 0)
+        return -1;
+    return bignum_miller_rabin_mont(&ctx, base, &scratch[n->length]);
+}
+
+int bignum_is_probab_prime(const bignum_t *n, const bignum_elem_t *bases, size_t rounds,
+                           bignum_elem_t *scratch) {
+    // Returns 2 if n is a prime, 1 if it is probably a prime, 0 if it
+    // is composite and -1 if bases is NULL and there are too many rounds.
+    //
+    // The Montgomery context is set up once for all rounds.
+    bignum_mont_ctx_t ctx;
+    int ret;
+
+    if (bases == NULL && rounds > BIGNUM_SMALL_PRIMES)
+        return -1;
+
+    ret = bignum_trial_division(n);
+    if (ret != 1 || rounds == 0)
+        return ret;
+
+    // n passed trial division, so it is odd and larger than 2^16.
+    bignum_mont_init_scratch(&ctx, n, scratch, &scratch[n->length]);
+    for (size_t i=0; i<rounds && ret == 1; i++)
+        ret = bignum_miller_rabin_mont(&ctx, bases != NULL ? bases[i] : small_primes[i],
+                                       &scratch[n->length]);
+    return ret;
 }
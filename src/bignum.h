@@ -51,6 +51,17 @@
 #define BIGNUM_ELEM_SIZE sizeof(BIGNUM_ELEM_TYPE)
 #define BIGNUM_ELEM_MAX ((BIGNUM_ELEM_TYPE) 0 - 1)
 
+#if !defined(BIGNUM_DELEM_TYPE) && !defined(__OPENCL_VERSION__) && defined(__SIZEOF_INT128__)
+/**
+ * @brief An unsigned type at least twice as wide as BIGNUM_ELEM_TYPE.
+ *
+ * It is used to multiply two elements at once. If the compiler doesn't
+ * provide such a type, the elements are multiplied by their halves.
+ * OpenCL C always uses the mul_hi() builtin instead.
+ */
+#define BIGNUM_DELEM_TYPE unsigned __int128
+#endif
+
 /** @brief The type of the elements of a big number. */
 typedef BIGNUM_ELEM_TYPE bignum_elem_t;
 
@@ -113,8 +124,77 @@ void bignum_assoc(bignum_t *num, bignum_elem_t *arr, const size_t num_elements);
 
 void bignum_assoc_at(bignum_t *num, bignum_elem_t *arr, const size_t num_elements, const size_t index);
 
+/**
+ * @brief Associate num_elements in arr with num, which has a known length.
+ *
+ * bignum_assoc() scans the elements for the length of the number. If the
+ * caller knows it, e.g. because it was stored next to the array or the
+ * array holds garbage which is about to be overwritten, this skips the
+ * scan. Only the elements arr[0] to arr[length-1] are used, the ones
+ * above don't have to be zero.
+ *
+ * @param num: The number with which the elements in arr will be associated
+ *             with.
+ * @param arr: The array holding the actual elements.
+ * @param num_elements: Number of elements from arr to associate with num.
+ * @param length: The number of elements the number uses. Values larger
+ *                than num_elements are clamped.
+ */
+void bignum_assoc_len(bignum_t *num, bignum_elem_t *arr, const size_t num_elements,
+                      const size_t length);
+
+/**
+ * @brief bignum_assoc_at() with a known length like bignum_assoc_len().
+ */
+void bignum_assoc_at_len(bignum_t *num, bignum_elem_t *arr, const size_t num_elements,
+                         const size_t index, const size_t length);
+
+/**
+ * @brief Copy a number from an interleaved batch to arr and associate
+ *        it with num.
+ *
+ * bignum_assoc_at() expects a batch of numbers one after another, so
+ * element i of number j is arr[j*num_elements + i]. An interleaved batch
+ * of count numbers stores the elements limb-major instead: Element i of
+ * number j is batch[i*count + j].
+ *
+ * If every OpenCL work-item handles one number, neighbouring work-items
+ * then access neighbouring addresses, which lets the device coalesce the
+ * memory accesses. The number is copied into arr (usually private memory),
+ * because the arithmetic functions expect contiguous elements.
+ *
+ * @code{.c}
+ * bignum_t x;
+ * bignum_elem_t x_elements[BIGNUM_2048];
+ * bignum_load_interleaved(&x, x_elements, batch, BIGNUM_2048, count, index);
+ * // ... calculate with x ...
+ * bignum_store_interleaved(batch, &x, count, index);
+ * @endcode
+ *
+ * @param num: The number with which the elements in arr will be associated
+ *             with.
+ * @param arr: The array the number is copied to.
+ * @param batch: The interleaved batch.
+ * @param num_elements: Number of elements of every number in the batch.
+ * @param count: Number of numbers in the batch.
+ * @param index: The index of the number to load.
+ */
+void bignum_load_interleaved(bignum_t *num, bignum_elem_t *arr, const bignum_elem_t *batch,
+                             const size_t num_elements, const size_t count, const size_t index);
+
+/**
+ * @brief Copy num to number index of an interleaved batch of count numbers.
+ *
+ * All num->max_length elements are written, the ones above num->length
+ * are set to zero (see bignum_write()).
+ */
+void bignum_store_interleaved(bignum_elem_t *batch, bignum_t *num,
+                              const size_t count, const size_t index);
+
 /**
  * @brief Synchronize bignum metadata with the underlying memory.
+ *
+ * The elements are scanned from the top down to the highest nonzero one.
 **/
 void bignum_sync(bignum_t *num);
 
@@ -132,6 +212,11 @@ void bignum_write(bignum_t *num);
 
 /**
  * @brief Zero out all memory associated with num.
+ *
+ * No function except bignum_sync() and bignum_assoc() reads the
+ * elements above num->length, so if the memory isn't shared, setting
+ * the length is enough. With BIGNUM_LAZY_ZERO defined, bignum_zero()
+ * only does that and the memory is zeroed by bignum_write().
 **/
 void bignum_zero(bignum_t *num);
 
@@ -170,6 +255,10 @@ int bignum_cmp_ui(const bignum_t *op1, const bignum_elem_t op2);
 /**
  * @brief Set rop = op1 + op2.
  *
+ * rop may be op1 or op2 (or both), every element is read before the
+ * element of rop with the same index is written. On overflow rop holds
+ * the sum modulo base^rop->max_length.
+ *
  * @Returns 1, if an overflow occured and 0 otherwise.
 **/
 int bignum_add(bignum_t *rop, const bignum_t *op1, const bignum_t *op2);
@@ -177,20 +266,128 @@ int bignum_add(bignum_t *rop, const bignum_t *op1, const bignum_t *op2);
 /**
  * @brief Set rop = op1 + op2.
  *
+ * rop may be op1.
+ *
  * @Returns 1, if an overflow occured and 0 otherwise.
 **/
 int bignum_add_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2);
 
 
+#ifndef BIGNUM_KARATSUBA_THRESHOLD
+/**
+ * @brief Minimum number of elements for Karatsuba multiplication.
+ *
+ * bignum_mul_scratch() uses schoolbook multiplication, if the shorter
+ * operand has less elements than this and Karatsuba multiplication
+ * otherwise. The default is tuned so that products of BIGNUM_2048 and
+ * BIGNUM_4096 numbers use one and two Karatsuba levels respectively.
+ * You can change it by defining BIGNUM_KARATSUBA_THRESHOLD yourself.
+ */
+#define BIGNUM_KARATSUBA_THRESHOLD (BIGNUM_512 * 3)
+#endif
+
+#ifndef BIGNUM_KARATSUBA_SQR_THRESHOLD
+/**
+ * @brief Minimum number of elements for Karatsuba squaring.
+ *
+ * Schoolbook squaring does half the work of schoolbook multiplication,
+ * so Karatsuba pays off later: With the default BIGNUM_2048 numbers are
+ * squared by schoolbook and BIGNUM_4096 numbers with one Karatsuba level.
+ */
+#define BIGNUM_KARATSUBA_SQR_THRESHOLD (BIGNUM_512 * 5)
+#endif
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_mul_scratch(), if no operand is longer than n elements.
+ */
+#define BIGNUM_MUL_SCRATCH(n) (8 * (n) + 64)
+
 /**
  * @brief Set rop = op1 * op2.
  *
+ * On the host this uses a scratch area on the stack for operands up to
+ * BIGNUM_4096 elements, which enables Karatsuba multiplication. OpenCL C
+ * code should use bignum_mul_scratch() for large numbers.
+ *
+ * @warning rop must not share memory with op1 or op2.
+ *
  * @Returns 1, if an overflow occured and 0 otherwise.
 **/
 int bignum_mul(bignum_t *rop, bignum_t *op1, bignum_t *op2);
 
+/**
+ * @brief Set rop = op1 * op2 using the given scratch area.
+ *
+ * scratch must hold at least BIGNUM_MUL_SCRATCH(n) elements, where n
+ * is the length of the longer operand. If scratch is NULL, schoolbook
+ * multiplication is used regardless of the operand sizes.
+ *
+ * @warning rop must not share memory with op1 or op2.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+int bignum_mul_scratch(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                       bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = op^2.
+ *
+ * This calculates every cross product op[i] * op[j] only once, which
+ * is faster than bignum_mul(rop, op, op). Like bignum_mul() it uses a
+ * scratch area on the stack on the host.
+ *
+ * @warning rop must not share memory with op.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+int bignum_sqr(bignum_t *rop, const bignum_t *op);
+
+/**
+ * @brief Set rop = op^2 using the given scratch area.
+ *
+ * scratch must hold at least BIGNUM_MUL_SCRATCH(op->length) elements
+ * or be NULL.
+ *
+ * @warning rop must not share memory with op.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+int bignum_sqr_scratch(bignum_t *rop, const bignum_t *op, bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = op1 * op2.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
 int bignum_mul_ui(bignum_t *rop, bignum_t *op1, bignum_elem_t op2);
 
+/**
+ * @brief Set rop = rop + op1 * op2.
+ *
+ * This is the multiply-accumulate step of schoolbook multiplication,
+ * without a temporary for the product. rop may be op1.
+ *
+ * Only the lower rop->max_length elements of op1 are used. A carry out
+ * of the highest element of rop is returned instead of stored.
+ *
+ * @Returns The carry element, which didn't fit into rop, or 0.
+**/
+bignum_elem_t bignum_addmul_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2);
+
+/**
+ * @brief Set rop = rop - op1 * op2.
+ *
+ * rop may be op1. Only the lower rop->max_length elements of op1 are used.
+ * If op1 * op2 is larger than rop, the result wraps around: With k the
+ * larger length of rop and op1, rop is set to
+ * (rop - op1 * op2) mod base^k and the borrow b with
+ * rop - op1 * op2 = result - b * base^k is returned.
+ *
+ * @Returns The borrow element or 0, if the result isn't negative.
+**/
+bignum_elem_t bignum_submul_ui(bignum_t *rop, const bignum_t *op1, const bignum_elem_t op2);
+
 /**
  * @brief Sets rop = op1 / op2.
  *
@@ -203,4 +400,717 @@ bignum_elem_t bignum_divmod_ui(bignum_t *rop, const bignum_t *op1, const bignum_
 **/
 bignum_elem_t bignum_mod_ui(const bignum_t *op1, const bignum_elem_t op2);
 
+/**
+ * @brief Declares arithmetic on numbers of a fixed size.
+ *
+ * For bits = 512, 1024, 2048 and 4096 there are the functions
+ * bignum<bits>_add(), bignum<bits>_mul() and bignum<bits>_sqr(),
+ * e.g. bignum2048_mul(). Their operands are plain arrays of exactly
+ * BIGNUM_<bits> elements, so every loop has a constant trip count and
+ * is unrolled by the compiler. They compute the same results as
+ * bignum_add(), bignum_mul() and bignum_sqr() with all operands
+ * associated to BIGNUM_<bits> elements, but don't need a bignum_t.
+ *
+ * rop may share memory with the operands.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+#define BIGNUM_FIXED_DECLARE(bits) \
+    int bignum##bits##_add(bignum_elem_t *rop, const bignum_elem_t *op1, \
+                           const bignum_elem_t *op2); \
+    int bignum##bits##_mul(bignum_elem_t *rop, const bignum_elem_t *op1, \
+                           const bignum_elem_t *op2); \
+    int bignum##bits##_sqr(bignum_elem_t *rop, const bignum_elem_t *op);
+
+BIGNUM_FIXED_DECLARE(512)
+BIGNUM_FIXED_DECLARE(1024)
+BIGNUM_FIXED_DECLARE(2048)
+BIGNUM_FIXED_DECLARE(4096)
+
+/**
+ * @brief Set rop = op1 * op2 mod base^n.
+ *
+ * Only the lower n elements of the product are calculated, where base
+ * is BIGNUM_ELEM_MAX + 1.
+ *
+ * @Returns 0 on success and -1 if rop is too small.
+**/
+int bignum_mullo(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                 size_t n);
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_mulhi(), if no operand is longer than n elements.
+ */
+#define BIGNUM_MULHI_SCRATCH(n) (2 * (n))
+
+/**
+ * @brief Set rop = op1 * op2 / base^n, possibly one too small.
+ *
+ * Only the elements of the product from n-2 on are calculated, so the
+ * result is either exact or one less than the exact quotient.
+ *
+ * @Returns 0 on success and -1 if rop is too small.
+**/
+int bignum_mulhi(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                 size_t n, bignum_elem_t *scratch);
+
+/**
+ * @brief Precomputed values for repeated divisions by the same element.
+ *
+ * Set up with bignum_udiv_init(), this replaces the hardware division
+ * per element of bignum_divmod_ui() and bignum_mod_ui() by
+ * multiplications (Moeller and Granlund, "Improved division by
+ * invariant integers").
+ */
+typedef struct bignum_udiv_ctx {
+    /** The divisor. */
+    bignum_elem_t d;
+    /** The divisor shifted left until its highest bit is set. */
+    bignum_elem_t dnorm;
+    /** floor((base^2 - 1) / dnorm) - base */
+    bignum_elem_t inv;
+    /** The number of bits dnorm is shifted by. */
+    int shift;
+} bignum_udiv_ctx_t;
+
+/**
+ * @brief Set up ctx for divisions by d.
+ *
+ * @Returns 0 on success and -1 if d is zero.
+**/
+int bignum_udiv_init(bignum_udiv_ctx_t *ctx, const bignum_elem_t d);
+
+/**
+ * @brief Sets rop = op1 / d with the divisor d of ctx.
+ *
+ * rop may be op1.
+ *
+ * @Returns Remainder of the operation.
+**/
+bignum_elem_t bignum_divmod_ui_pre(bignum_t *rop, const bignum_t *op1,
+                                   const bignum_udiv_ctx_t *ctx);
+
+/**
+ * @brief Return op1 % d with the divisor d of ctx.
+**/
+bignum_elem_t bignum_mod_ui_pre(const bignum_t *op1, const bignum_udiv_ctx_t *ctx);
+
+#ifndef BIGNUM_MOD_MULTI_GROUPS
+/**
+ * @brief Number of products of moduli, which bignum_mod_ui_multi()
+ *        reduces by in one pass over a number.
+ *
+ * Every product takes a bignum_udiv_ctx_t and two more values on the
+ * stack.
+ */
+#define BIGNUM_MOD_MULTI_GROUPS 16
+#endif
+
+/**
+ * @brief Set out[i] = op % moduli[i] for count moduli.
+ *
+ * Consecutive moduli are multiplied into products which fit into an
+ * element, and op is reduced by up to BIGNUM_MOD_MULTI_GROUPS products
+ * per pass over its elements. The remainders of the products are then
+ * reduced by their moduli. So with 64 bit elements and moduli below
+ * 2^16, e.g. the primes for a sieve, this takes a quarter of the
+ * divisions of bignum_mod_ui() for every modulus and reads op once
+ * for up to 64 moduli.
+ *
+ * @Returns 0 on success and -1 if a modulus is zero.
+**/
+int bignum_mod_ui_multi(const bignum_t *op, const bignum_elem_t *moduli,
+                        bignum_elem_t *out, size_t count);
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_divmod() and bignum_mod(), if no operand is longer
+ *        than n elements.
+ */
+#define BIGNUM_DIVMOD_SCRATCH(n) (2 * (n) + 1)
+
+/**
+ * @brief Set q = n / d and r = n % d.
+ *
+ * q may be NULL, if only the remainder is needed. Any of q and r may
+ * share memory with n or d. scratch must hold at least
+ * BIGNUM_DIVMOD_SCRATCH(n->length) elements.
+ *
+ * @Returns 0 on success and -1 if d is zero or q or r are too small.
+**/
+int bignum_divmod(bignum_t *q, bignum_t *r, const bignum_t *n, const bignum_t *d,
+                  bignum_elem_t *scratch);
+
+/**
+ * @brief Set r = n % d.
+ *
+ * This is bignum_divmod() without calculating the quotient.
+ *
+ * @Returns 0 on success and -1 if d is zero or r is too small.
+**/
+int bignum_mod(bignum_t *r, const bignum_t *n, const bignum_t *d,
+               bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = op * 2^bits.
+ *
+ * rop may be op. On overflow rop holds the result modulo
+ * base^rop->max_length. This takes time linear in the length of the
+ * result, unlike multiplying by powers of two with bignum_mul_ui().
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+int bignum_lshift(bignum_t *rop, const bignum_t *op, size_t bits);
+
+/**
+ * @brief Set rop = op / 2^bits (rounded down).
+ *
+ * rop may be op. If the result doesn't fit, rop holds it modulo
+ * base^rop->max_length.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+int bignum_rshift(bignum_t *rop, const bignum_t *op, size_t bits);
+
+/**
+ * @brief Set rop = op / 2^bits (rounded down).
+ *
+ * The same as bignum_rshift(), the numbers are unsigned, so truncating
+ * and rounding down are the same.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+int bignum_tdiv_q_2exp(bignum_t *rop, const bignum_t *op, size_t bits);
+
+/**
+ * @brief Set rop = op mod 2^bits.
+ *
+ * rop may be op. If the result doesn't fit, rop holds it modulo
+ * base^rop->max_length.
+ *
+ * @Returns 1, if an overflow occured and 0 otherwise.
+**/
+int bignum_mod_2exp(bignum_t *rop, const bignum_t *op, size_t bits);
+
+/**
+ * @brief Return the number of bits of op without leading zeros.
+ *
+ * This is 0 for op = 0, otherwise op < 2^bignum_bit_length(op).
+**/
+size_t bignum_bit_length(const bignum_t *op);
+
+/**
+ * @brief Return the number of trailing zero bits of op.
+ *
+ * That is the largest k such that 2^k divides op, or 0 for op = 0.
+**/
+size_t bignum_ctz(const bignum_t *op);
+
+/**
+ * @brief Return the number of bits set in op.
+**/
+size_t bignum_popcount(const bignum_t *op);
+
+/**
+ * @brief Return bit number bit of op (0 or 1).
+ *
+ * Bit 0 is the least significant one, bits above the length are 0.
+**/
+int bignum_tstbit(const bignum_t *op, size_t bit);
+
+/**
+ * @brief Set bit number bit of rop.
+ *
+ * @Returns 0 on success and -1 if the bit is beyond rop->max_length
+ *          elements.
+**/
+int bignum_setbit(bignum_t *rop, size_t bit);
+
+/**
+ * @brief Precomputed values for Montgomery arithmetic modulo m.
+ *
+ * A bignum_mont_ctx_t is set up with bignum_mont_init(). Like a bignum_t
+ * it doesn't own any memory: m and r2 are associated with arrays
+ * provided by the caller, which have to stay valid as long as the
+ * context is used.
+ *
+ * Numbers in Montgomery form are represented as x * R mod m with
+ * R = 2^(w * n), where w is the number of bits of a bignum_elem_t
+ * and n is m.length.
+ */
+typedef struct bignum_mont_ctx {
+    /** The odd modulus. */
+    bignum_t m;
+    /** -m^-1 mod 2^w */
+    bignum_elem_t minv;
+    /** R^2 mod m */
+    bignum_t r2;
+} bignum_mont_ctx_t;
+
+/**
+ * @brief Number of elements required for the scratch area of the
+ *        Montgomery functions with a modulus of n elements.
+ */
+#define BIGNUM_MONT_SCRATCH(n) (2 * (n) + 2)
+
+#ifndef BIGNUM_POWM_WINDOW
+/**
+ * @brief Maximum window size (in bits) of bignum_powm().
+ *
+ * bignum_powm() stores 2^(BIGNUM_POWM_WINDOW-1) precomputed powers in
+ * its scratch area.
+ */
+#define BIGNUM_POWM_WINDOW 5
+#endif
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_powm() with a modulus of n elements.
+ */
+#define BIGNUM_POWM_SCRATCH(n) \
+    (((1 << (BIGNUM_POWM_WINDOW - 1)) + 2) * (n) + BIGNUM_MONT_SCRATCH(n))
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_mont_init_scratch() with a modulus of n elements.
+ */
+#define BIGNUM_MONT_INIT_SCRATCH(n) \
+    (2 * (n) + 1 + BIGNUM_DIVMOD_SCRATCH(2 * (n) + 1))
+
+/**
+ * @brief Set up ctx for Montgomery arithmetic modulo m.
+ *
+ * This code prepares a context for calculations modulo m:
+ * @code{.c}
+ * bignum_mont_ctx_t ctx;
+ * bignum_elem_t r2_elements[BIGNUM_2048];
+ * bignum_mont_init(&ctx, &m, r2_elements);
+ * @endcode
+ *
+ * @param ctx: The context to set up.
+ * @param m: The odd modulus. Its elements have to stay unchanged
+ *           while ctx is in use.
+ * @param arr: An array of at least m->length elements, which will hold
+ *             R^2 mod m.
+ *
+ * On the host this uses a scratch area on the stack for moduli up to
+ * BIGNUM_4096 elements, so R^2 mod m takes one division. OpenCL C code
+ * should use bignum_mont_init_scratch().
+ *
+ * @Returns 0 on success and -1 if m is even or zero.
+**/
+int bignum_mont_init(bignum_mont_ctx_t *ctx, const bignum_t *m, bignum_elem_t *arr);
+
+/**
+ * @brief Set up ctx like bignum_mont_init() using the given scratch area.
+ *
+ * scratch must hold at least BIGNUM_MONT_INIT_SCRATCH(m->length)
+ * elements. If scratch is NULL, R^2 mod m is computed by 2 * n * w
+ * modular doublings instead, which takes time proportional to n^2 * w
+ * for a modulus of n elements with w bits each.
+ *
+ * @Returns 0 on success and -1 if m is even or zero.
+**/
+int bignum_mont_init_scratch(bignum_mont_ctx_t *ctx, const bignum_t *m,
+                             bignum_elem_t *arr, bignum_elem_t *scratch);
+
+/**
+ * @brief Set up ctx for Montgomery arithmetic modulo m with R^2 mod m
+ *        already stored in arr.
+ *
+ * This is bignum_mont_init() without calculating R^2 mod m, which takes
+ * a division by m, or O(n^2 * w) time for n elements of w bits without
+ * a scratch area. Use it to set up a context again from the array of an
+ * earlier bignum_mont_init() with the same m, e.g. in a later kernel
+ * launch.
+ *
+ * @param ctx: The context to set up.
+ * @param m: The odd modulus. Its elements have to stay unchanged
+ *           while ctx is in use.
+ * @param arr: m->length elements holding R^2 mod m.
+ *
+ * @Returns 0 on success and -1 if m is even or zero.
+**/
+int bignum_mont_assoc(bignum_mont_ctx_t *ctx, const bignum_t *m, bignum_elem_t *arr);
+
+/**
+ * @brief Set rop = op * R mod m (convert op into Montgomery form).
+ *
+ * op may be larger than m, but not longer. scratch must hold at least
+ * BIGNUM_MONT_SCRATCH(m.length) elements.
+ *
+ * @Returns 0 on success and -1 if rop is too small or op too long.
+**/
+int bignum_mont_to(bignum_t *rop, const bignum_t *op,
+                   const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = op / R mod m (convert op from Montgomery form).
+ *
+ * @Returns 0 on success and -1 if rop is too small or op too long.
+**/
+int bignum_mont_from(bignum_t *rop, const bignum_t *op,
+                     const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = op1 * op2 / R mod m.
+ *
+ * op1 and op2 have to be less than m. rop may be op1 or op2.
+ *
+ * @Returns 0 on success and -1 if rop is too small or an operand too long.
+**/
+int bignum_mont_mul(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+                    const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = op^2 / R mod m.
+ *
+ * @Returns 0 on success and -1 if rop is too small or op too long.
+**/
+int bignum_mont_sqr(bignum_t *rop, const bignum_t *op,
+                    const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = base^exp mod m.
+ *
+ * base and rop are in regular (not Montgomery) form. base may be larger
+ * than m, but not longer. scratch must hold at least
+ * BIGNUM_POWM_SCRATCH(m.length) elements.
+ *
+ * @Returns 0 on success and -1 if rop is too small or base too long.
+**/
+int bignum_powm(bignum_t *rop, const bignum_t *base, const bignum_t *exp,
+                const bignum_mont_ctx_t *ctx, bignum_elem_t *scratch);
+
+/**
+ * @brief Precomputed values for Barrett reduction modulo m.
+ *
+ * Set up with bignum_barrett_init(). Like bignum_mont_ctx_t it doesn't
+ * own memory: m and mu are associated with arrays of the caller.
+ */
+typedef struct bignum_barrett_ctx {
+    /** The modulus of k elements. */
+    bignum_t m;
+    /** base^2k / m */
+    bignum_t mu;
+} bignum_barrett_ctx_t;
+
+#ifndef BIGNUM_BARRETT_THRESHOLD
+/**
+ * @brief Minimum number of elements of a modulus for Barrett reduction
+ *        with Karatsuba products.
+ *
+ * From this size on bignum_barrett_init() finds mu by Newton's iteration
+ * and bignum_mod_barrett() uses full products, both with Karatsuba
+ * multiplication, instead of schoolbook division and truncated products.
+ */
+#define BIGNUM_BARRETT_THRESHOLD (BIGNUM_512 * 32)
+#endif
+
+/**
+ * @brief Number of elements required for the scratch area of the
+ *        Barrett functions with a modulus of k elements.
+ */
+#define BIGNUM_BARRETT_SCRATCH(k) (13 * (k) + 96)
+
+/**
+ * @brief Set up ctx for Barrett reduction modulo m.
+ *
+ * @param ctx: The context to set up.
+ * @param m: The modulus. Its elements have to stay unchanged
+ *           while ctx is in use.
+ * @param arr: An array of at least m->length + 2 elements, which will
+ *             hold mu.
+ * @param scratch: A scratch area of BIGNUM_BARRETT_SCRATCH(m->length)
+ *                 elements.
+ *
+ * @Returns 0 on success and -1 if m is zero.
+**/
+int bignum_barrett_init(bignum_barrett_ctx_t *ctx, const bignum_t *m,
+                        bignum_elem_t *arr, bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop = op mod m.
+ *
+ * op must have at most twice as many elements as m, which holds for
+ * the product of two numbers less than m.
+ *
+ * @Returns 0 on success and -1 if rop is too small or op too long.
+**/
+int bignum_mod_barrett(bignum_t *rop, const bignum_t *op,
+                       const bignum_barrett_ctx_t *ctx, bignum_elem_t *scratch);
+
+/**
+ * @brief Size of a string buffer for bignum_get_str(), which is enough
+ *        for any number of n elements in base 10 and 16, including the
+ *        terminating zero.
+ */
+#define BIGNUM_STR_SIZE(n) ((n) * BIGNUM_ELEM_SIZE * 8 * 30103 / 100000 + 2)
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_get_str() with base 10 for numbers of n elements.
+ */
+#define BIGNUM_GET_STR_SCRATCH(n) (21 * (n) + 64)
+
+#ifndef BIGNUM_GET_STR_THRESHOLD
+/**
+ * @brief Numbers up to this many elements are converted to decimal by
+ *        repeated divisions by the largest power of ten in an element,
+ *        longer ones are split by larger powers of ten first.
+ */
+#define BIGNUM_GET_STR_THRESHOLD 16
+#endif
+
+/**
+ * @brief Write op in base 10 or 16 to str.
+ *
+ * Hexadecimal digits are lower case, there is no prefix and no leading
+ * zeros. The number of digits is estimated from the bit length of op,
+ * so str must be larger than that estimate, which BIGNUM_STR_SIZE()
+ * always is. scratch must hold BIGNUM_GET_STR_SCRATCH(op->length)
+ * elements for base 10 and may be NULL for base 16.
+ *
+ * @param str: The buffer for the digits and the terminating zero.
+ * @param size: The size of str.
+ * @param op: The number to convert.
+ * @param base: 10 or 16.
+ * @param scratch: The scratch area.
+ *
+ * @Returns The number of digits or -1 if base is not supported or str
+ *          is too small.
+**/
+int bignum_get_str(char *str, size_t size, const bignum_t *op, int base,
+                   bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop to the value of the zero terminated string str in
+ *        base 10 or 16.
+ *
+ * str consists of digits only, hexadecimal digits may be upper or lower
+ * case. If the value doesn't fit, rop is set to the value modulo
+ * base^(rop->max_length), where base is BIGNUM_ELEM_MAX + 1.
+ *
+ * @Returns 0 on success, 1 if an overflow occured and -1 if str is empty
+ *          or contains other characters than digits of base.
+**/
+int bignum_set_str(bignum_t *rop, const char *str, int base);
+
+/**
+ * @brief Set rop to the value of count words of size bytes at data.
+ *
+ * The parameters are the ones of mpz_import() of the GNU MP without
+ * nails: order is 1 for the most significant word first and -1 for the
+ * least significant word first, endian is 1 for big-endian, -1 for
+ * little-endian and 0 for the host's byte order of the bytes in a word.
+ * data doesn't have to be aligned.
+ *
+ * A big-endian byte string of len bytes, e.g. a hash or a key, is read
+ * with:
+ * @code{.c}
+ * bignum_import(&x, bytes, len, 1, 1, 0);
+ * @endcode
+ *
+ * If the value doesn't fit, rop is set to the value modulo
+ * base^(rop->max_length), where base is BIGNUM_ELEM_MAX + 1.
+ *
+ * @Returns 0 on success, 1 if an overflow occured and -1 if order, size
+ *          or endian are invalid.
+**/
+int bignum_import(bignum_t *rop, const void *data, size_t count, int order, size_t size,
+                  int endian);
+
+/**
+ * @brief Write op to count words of size bytes at data.
+ *
+ * order, size and endian are the ones of bignum_import(). Unlike
+ * mpz_export() all count words are written, padded with leading zeros,
+ * so fixed size fields can be written directly.
+ *
+ * @Returns 0 on success and -1 if op doesn't fit into count words or
+ *          order, size or endian are invalid.
+**/
+int bignum_export(void *data, size_t count, int order, size_t size, int endian,
+                  const bignum_t *op);
+
+/**
+ * @brief Associate a byte string of size bytes at data with num without
+ *        copying it.
+ *
+ * On little-endian hosts a little-endian byte string (endian -1 or 0)
+ * already is an array of elements and is associated as it is. Big-endian
+ * byte strings (endian 1) are converted in place, so the bytes at data
+ * are changed. Use bignum_import() to keep them.
+ *
+ * data is accessed as bignum_elem_t, so it must be aligned like an
+ * element and shouldn't be accessed through other types as long as it is
+ * associated with num.
+ *
+ * @Returns 0 on success and -1 if data is not aligned, size is not a
+ *          multiple of BIGNUM_ELEM_SIZE or endian is invalid.
+**/
+int bignum_assoc_bytes(bignum_t *num, void *data, const size_t size, int endian);
+
+#ifndef BIGNUM_GCD_THRESHOLD
+/**
+ * @brief Numbers up to this many elements are reduced by the binary
+ *        algorithm in bignum_gcd(), longer ones by Lehmer's algorithm.
+ */
+#define BIGNUM_GCD_THRESHOLD 2
+#endif
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_gcd() with operands of up to n elements.
+ */
+#define BIGNUM_GCD_SCRATCH(n) (6 * (n) + 5)
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_gcdext() with operands of up to n elements.
+ */
+#define BIGNUM_GCDEXT_SCRATCH(n) (15 * (n) + 22)
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_invert() with a modulus of n elements.
+ */
+#define BIGNUM_INVERT_SCRATCH(n) (BIGNUM_GCDEXT_SCRATCH(n) + 2 * (n))
+
+/**
+ * @brief Set rop to the greatest common divisor of op1 and op2.
+ *
+ * gcd(op, 0) is op. rop may share memory with op1 or op2. scratch must
+ * hold at least BIGNUM_GCD_SCRATCH(n) elements, n being the length of
+ * the longer operand.
+ *
+ * @Returns 0 on success and -1 if rop is too small.
+**/
+int bignum_gcd(bignum_t *rop, const bignum_t *op1, const bignum_t *op2,
+               bignum_elem_t *scratch);
+
+/**
+ * @brief Set g = gcd(op1, op2) and s and t, so that
+ *        g = op1 * s - op2 * t.
+ *
+ * The cofactors are not negative, s is at most op2 / g and t at most
+ * op1 / g. s or t may be NULL, if they are not needed. Any of g, s
+ * and t may share memory with op1 or op2. scratch must hold at least
+ * BIGNUM_GCDEXT_SCRATCH(n) elements, n being the length of the longer
+ * operand.
+ *
+ * @Returns 0 on success and -1 if an output is too small or op1 is
+ *          zero and op2 is not (there are no such cofactors).
+**/
+int bignum_gcdext(bignum_t *g, bignum_t *s, bignum_t *t, const bignum_t *op1,
+                  const bignum_t *op2, bignum_elem_t *scratch);
+
+/**
+ * @brief Set rop to the inverse of op modulo m.
+ *
+ * op may be larger than m, but not longer. rop may share memory with
+ * op or m. scratch must hold at least BIGNUM_INVERT_SCRATCH(m->length)
+ * elements.
+ *
+ * @Returns 0 on success, 1 if op has no inverse (gcd(op, m) != 1) and
+ *          -1 if m is zero, op is too long or rop too small.
+**/
+int bignum_invert(bignum_t *rop, const bignum_t *op, const bignum_t *m,
+                  bignum_elem_t *scratch);
+
+/**
+ * @brief Number of primes below 256, which are used for trial division
+ *        and as default bases of bignum_is_probab_prime().
+ */
+#define BIGNUM_SMALL_PRIMES 54
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_miller_rabin_mont() with a modulus of k elements.
+ */
+#define BIGNUM_MILLER_RABIN_SCRATCH(k) (3 * (k) + BIGNUM_POWM_SCRATCH(k))
+
+/**
+ * @brief Number of elements required for the scratch area of
+ *        bignum_miller_rabin() and bignum_is_probab_prime() with n
+ *        of up to k elements.
+ *
+ * This includes R^2 mod n of the Montgomery context.
+ */
+#define BIGNUM_PRIME_SCRATCH(k) ((k) + BIGNUM_MILLER_RABIN_SCRATCH(k))
+
+/**
+ * @brief Trial division of n by the primes below 256.
+ *
+ * This decides all numbers below 2^16.
+ *
+ * @Returns 2 if n is a prime, 1 if n has no factor below 256 and 0
+ *          otherwise (n is composite, 0 or 1).
+**/
+int bignum_trial_division(const bignum_t *n);
+
+/**
+ * @brief One round of the Miller-Rabin test of n = ctx->m with base.
+ *
+ * A composite n passes the round for at most a quarter of all bases.
+ * Several rounds of the same n should share one Montgomery context.
+ * scratch must hold at least BIGNUM_MILLER_RABIN_SCRATCH(n->length)
+ * elements.
+ *
+ * @Returns 1 if n passes (is a prime or a strong pseudoprime to base),
+ *          0 if n is composite and -1 if n is less than 3.
+**/
+int bignum_miller_rabin_mont(const bignum_mont_ctx_t *ctx, bignum_elem_t base,
+                             bignum_elem_t *scratch);
+
+/**
+ * @brief One round of the Miller-Rabin test of n with base.
+ *
+ * This sets up a Montgomery context for n and calls
+ * bignum_miller_rabin_mont(). scratch must hold at least
+ * BIGNUM_PRIME_SCRATCH(n->length) elements.
+ *
+ * @Returns 1 if n passes (is a prime or a strong pseudoprime to base),
+ *          0 if n is composite and -1 if n is even or less than 3.
+**/
+int bignum_miller_rabin(const bignum_t *n, bignum_elem_t base, bignum_elem_t *scratch);
+
+/**
+ * @brief Test whether n is a prime.
+ *
+ * This runs bignum_trial_division() and, if that doesn't decide,
+ * bignum_miller_rabin_mont() with every base until n fails a round,
+ * all with the same Montgomery context. If bases is NULL, the first
+ * rounds primes 2, 3, 5, ... are used, which is deterministic. For
+ * candidates an adversary might have chosen, pass random bases.
+ *
+ * scratch must hold at least BIGNUM_PRIME_SCRATCH(n->length) elements.
+ *
+ * @param n: The number to test.
+ * @param bases: rounds bases or NULL.
+ * @param rounds: The number of Miller-Rabin rounds, at most
+ *                BIGNUM_SMALL_PRIMES if bases is NULL.
+ * @param scratch: The scratch area.
+ *
+ * @Returns 2 if n is a prime (decided by trial division), 1 if n is
+ *          probably a prime, 0 if n is composite and -1 if bases is
+ *          NULL and rounds too large.
+**/
+int bignum_is_probab_prime(const bignum_t *n, const bignum_elem_t *bases, size_t rounds,
+                           bignum_elem_t *scratch);
+
+#ifndef __OPENCL_VERSION__
+/**
+ * @brief The name of the array kernels used on the host.
+ *
+ * On x86-64 the kernels are selected when the program is loaded:
+ * "adx" on CPUs with BMI2 and ADX (mulx, adcx, adox), "generic"
+ * otherwise or if the environment variable BIGNUM_KERNELS is set to
+ * "generic". Build with -D BIGNUM_NO_DISPATCH to always use the
+ * generic kernels.
+**/
+const char *bignum_kernels(void);
+#endif
+
 #endif // __BIGNUM_H
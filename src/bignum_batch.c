@@ -0,0 +1,707 @@
+#ifdef __linux__
+#define _GNU_SOURCE // pthread_setaffinity_np()
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bignum_batch.h"
+
+/*
+ * Work stealing:
+ *  - queue_pop(), queue_steal()
+ *  - worker_main()
+ *  - bignum_batch_run()
+ *
+ * Every worker owns a range of chunks [front, back), packed into one
+ * atomic word. The owner takes chunks from the front, thieves from the
+ * back, both with a compare-and-swap of the whole range. No chunks are
+ * added while a batch runs, so a worker is done once all ranges are
+ * empty.
+**/
+typedef struct batch_worker {
+    pthread_t thread;
+    _Atomic uint64_t range;
+    struct batch_pool *pool;
+    unsigned int id;
+} batch_worker_t;
+
+typedef struct batch_pool {
+    batch_worker_t *workers;
+    unsigned int num_workers;
+    size_t chunk;
+    size_t count;
+    bignum_batch_fn_t fn;
+    void *arg;
+    size_t scratch_elements;
+    int pin;
+    atomic_int error;
+} batch_pool_t;
+
+#define RANGE(front, back) (((uint64_t) (front) << 32) | (uint64_t) (back))
+#define RANGE_FRONT(range) ((size_t) ((range) >> 32))
+#define RANGE_BACK(range) ((size_t) ((range) & 0xffffffff))
+
+static int queue_pop(batch_worker_t *w, size_t *chunk) {
+    // Take the first chunk of w. Returns 0 if there is none.
+    uint64_t range = atomic_load(&w->range);
+    while (RANGE_FRONT(range) < RANGE_BACK(range)) {
+        if (atomic_compare_exchange_weak(&w->range, &range,
+                RANGE(RANGE_FRONT(range) + 1, RANGE_BACK(range)))) {
+            *chunk = RANGE_FRONT(range);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int queue_steal(batch_worker_t *w, size_t *chunk) {
+    // Take the last chunk of w. Returns 0 if there is none.
+    uint64_t range = atomic_load(&w->range);
+    while (RANGE_FRONT(range) < RANGE_BACK(range)) {
+        if (atomic_compare_exchange_weak(&w->range, &range,
+                RANGE(RANGE_FRONT(range), RANGE_BACK(range) - 1))) {
+            *chunk = RANGE_BACK(range) - 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    batch_worker_t *w = arg;
+    batch_pool_t *pool = w->pool;
+    bignum_elem_t *scratch = NULL;
+    size_t chunk, begin, end;
+
+#ifdef __linux__
+    if (pool->pin) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(w->id % CPU_SETSIZE, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+
+    // The scratch area is first touched by this thread.
+    if (pool->scratch_elements > 0) {
+        scratch = malloc(pool->scratch_elements * sizeof(bignum_elem_t));
+        if (scratch == NULL) {
+            // The chunks of this worker are stolen by the others.
+            atomic_store(&pool->error, 1);
+            return NULL;
+        }
+    }
+
+    for (;;) {
+        int found = queue_pop(w, &chunk);
+        for (unsigned int i=1; !found && i < pool->num_workers; i++)
+            found = queue_steal(&pool->workers[(w->id + i) % pool->num_workers], &chunk);
+        if (!found)
+            break;
+
+        begin = chunk * pool->chunk;
+        end = begin + pool->chunk < pool->count ? begin + pool->chunk : pool->count;
+        pool->fn(begin, end, scratch, pool->arg);
+    }
+
+    free(scratch);
+    return NULL;
+}
+
+int bignum_batch_run(const bignum_batch_opts_t *opts, size_t count,
+                     bignum_batch_fn_t fn, void *arg, size_t scratch_elements) {
+    batch_pool_t pool;
+    size_t num_chunks;
+    int *created;
+
+    if (count == 0)
+        return 0;
+
+    pool.chunk = opts != NULL && opts->chunk > 0 ? opts->chunk : BIGNUM_BATCH_CHUNK;
+    pool.num_workers = opts != NULL ? opts->threads : 0;
+    if (pool.num_workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        pool.num_workers = cpus > 0 ? (unsigned int) cpus : 1;
+    }
+
+    // The chunk indices have to fit into 32 bits.
+    if (count / pool.chunk >= 0xffffffff)
+        pool.chunk = count / 0xfffffffe + 1;
+    num_chunks = (count + pool.chunk - 1) / pool.chunk;
+    if (pool.num_workers > num_chunks)
+        pool.num_workers = num_chunks;
+
+    pool.count = count;
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.scratch_elements = scratch_elements;
+    pool.pin = opts != NULL && opts->pin;
+    atomic_init(&pool.error, 0);
+
+    pool.workers = malloc(pool.num_workers * sizeof(batch_worker_t));
+    created = calloc(pool.num_workers, sizeof(int));
+    if (pool.workers == NULL || created == NULL) {
+        free(pool.workers);
+        free(created);
+        return -1;
+    }
+
+    for (unsigned int i=0; i < pool.num_workers; i++) {
+        pool.workers[i].pool = &pool;
+        pool.workers[i].id = i;
+        atomic_init(&pool.workers[i].range,
+                    RANGE(num_chunks * i / pool.num_workers,
+                          num_chunks * (i+1) / pool.num_workers));
+    }
+
+    // The calling thread is worker 0. If a thread can't be started,
+    // its chunks are stolen by the others.
+    for (unsigned int i=1; i < pool.num_workers; i++)
+        created[i] = pthread_create(&pool.workers[i].thread, NULL,
+                                    worker_main, &pool.workers[i]) == 0;
+    worker_main(&pool.workers[0]);
+
+    for (unsigned int i=1; i < pool.num_workers; i++)
+        if (created[i])
+            pthread_join(pool.workers[i].thread, NULL);
+
+    // Chunks are left over, if every worker failed to get scratch memory.
+    for (unsigned int i=0; i < pool.num_workers; i++)
+        if (RANGE_FRONT(atomic_load(&pool.workers[i].range)) <
+            RANGE_BACK(atomic_load(&pool.workers[i].range)))
+            atomic_store(&pool.error, 1);
+
+    free(pool.workers);
+    free(created);
+    return atomic_load(&pool.error) ? -1 : 0;
+}
+
+/*
+ * Batch memory:
+ *  - bignum_batch_alloc()
+ *  - bignum_batch_free()
+**/
+typedef struct batch_args {
+    bignum_elem_t *rop;
+    bignum_elem_t *rem;
+    const bignum_elem_t *op1;
+    const bignum_elem_t *op2;
+    int *overflow;
+    size_t num_elements;
+    bignum_udiv_ctx_t udiv;
+    const bignum_elem_t *moduli;
+    size_t num_moduli;
+} batch_args_t;
+
+static void zero_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    batch_args_t *a = arg;
+    memset(&a->rop[begin * a->num_elements], 0,
+           (end - begin) * a->num_elements * sizeof(bignum_elem_t));
+}
+
+bignum_elem_t *bignum_batch_alloc(const bignum_batch_opts_t *opts,
+                                  size_t num_elements, size_t count) {
+    batch_args_t args;
+
+    if (num_elements == 0 || count > SIZE_MAX / sizeof(bignum_elem_t) / num_elements)
+        return NULL;
+
+    // malloc() leaves the pages untouched, calloc() might not.
+    args.rop = malloc(num_elements * count * sizeof(bignum_elem_t));
+    args.num_elements = num_elements;
+    if (args.rop == NULL)
+        return NULL;
+
+    if (bignum_batch_run(opts, count, zero_chunk, &args, 0) != 0) {
+        free(args.rop);
+        return NULL;
+    }
+    return args.rop;
+}
+
+void bignum_batch_free(bignum_elem_t *batch) {
+    free(batch);
+}
+
+/*
+ * Batch operations:
+ *  - bignum_batch_add(), bignum_batch_mul()
+ *  - bignum_batch_divmod_ui(), bignum_batch_mod_ui()
+ *  - bignum_batch_mod_ui_multi()
+ *
+ * The operands are only read, but bignum_assoc_at() doesn't take
+ * const arrays.
+**/
+static void add_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    batch_args_t *a = arg;
+    bignum_t r, x, y;
+    int overflow;
+
+    for (size_t i=begin; i<end; i++) {
+        bignum_assoc_at(&x, (bignum_elem_t *) a->op1, a->num_elements, i);
+        bignum_assoc_at(&y, (bignum_elem_t *) a->op2, a->num_elements, i);
+        bignum_assoc_at_len(&r, a->rop, a->num_elements, i, 0);
+
+        overflow = bignum_add(&r, &x, &y);
+        bignum_write(&r);
+        if (a->overflow != NULL)
+            a->overflow[i] = overflow;
+    }
+}
+
+static void mul_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    batch_args_t *a = arg;
+    bignum_t r, x, y;
+    int overflow;
+
+    for (size_t i=begin; i<end; i++) {
+        bignum_assoc_at(&x, (bignum_elem_t *) a->op1, a->num_elements, i);
+        bignum_assoc_at(&y, (bignum_elem_t *) a->op2, a->num_elements, i);
+        bignum_assoc_at_len(&r, a->rop, a->num_elements, i, 0);
+
+        overflow = bignum_mul_scratch(&r, &x, &y, scratch);
+        bignum_write(&r);
+        if (a->overflow != NULL)
+            a->overflow[i] = overflow;
+    }
+}
+
+static void divmod_ui_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    batch_args_t *a = arg;
+    bignum_t q, x;
+    bignum_elem_t rem;
+
+    for (size_t i=begin; i<end; i++) {
+        bignum_assoc_at(&x, (bignum_elem_t *) a->op1, a->num_elements, i);
+        bignum_assoc_at_len(&q, a->rop, a->num_elements, i, 0);
+
+        rem = bignum_divmod_ui_pre(&q, &x, &a->udiv);
+        bignum_write(&q);
+        if (a->rem != NULL)
+            a->rem[i] = rem;
+    }
+}
+
+static void mod_ui_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    batch_args_t *a = arg;
+    bignum_t x;
+
+    for (size_t i=begin; i<end; i++) {
+        bignum_assoc_at(&x, (bignum_elem_t *) a->op1, a->num_elements, i);
+        a->rem[i] = bignum_mod_ui_pre(&x, &a->udiv);
+    }
+}
+
+static void mod_ui_multi_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    batch_args_t *a = arg;
+    bignum_t x;
+
+    for (size_t i=begin; i<end; i++) {
+        bignum_assoc_at(&x, (bignum_elem_t *) a->op1, a->num_elements, i);
+        bignum_mod_ui_multi(&x, a->moduli, &a->rem[i * a->num_moduli], a->num_moduli);
+    }
+}
+
+int bignum_batch_add(const bignum_batch_opts_t *opts, bignum_elem_t *rop,
+                     const bignum_elem_t *op1, const bignum_elem_t *op2,
+                     int *overflow, size_t num_elements, size_t count) {
+    batch_args_t args = {.rop = rop, .op1 = op1, .op2 = op2,
+                         .overflow = overflow, .num_elements = num_elements};
+    return bignum_batch_run(opts, count, add_chunk, &args, 0);
+}
+
+int bignum_batch_mul(const bignum_batch_opts_t *opts, bignum_elem_t *rop,
+                     const bignum_elem_t *op1, const bignum_elem_t *op2,
+                     int *overflow, size_t num_elements, size_t count) {
+    batch_args_t args = {.rop = rop, .op1 = op1, .op2 = op2,
+                         .overflow = overflow, .num_elements = num_elements};
+    return bignum_batch_run(opts, count, mul_chunk, &args,
+                            BIGNUM_MUL_SCRATCH(num_elements));
+}
+
+int bignum_batch_divmod_ui(const bignum_batch_opts_t *opts, bignum_elem_t *q,
+                           bignum_elem_t *rem, const bignum_elem_t *op1,
+                           bignum_elem_t d, size_t num_elements, size_t count) {
+    batch_args_t args = {.rop = q, .rem = rem, .op1 = op1, .num_elements = num_elements};
+    if (bignum_udiv_init(&args.udiv, d) != 0)
+        return -1;
+    return bignum_batch_run(opts, count, divmod_ui_chunk, &args, 0);
+}
+
+int bignum_batch_mod_ui(const bignum_batch_opts_t *opts, bignum_elem_t *rem,
+                        const bignum_elem_t *op1, bignum_elem_t d,
+                        size_t num_elements, size_t count) {
+    batch_args_t args = {.rem = rem, .op1 = op1, .num_elements = num_elements};
+    if (bignum_udiv_init(&args.udiv, d) != 0)
+        return -1;
+    return bignum_batch_run(opts, count, mod_ui_chunk, &args, 0);
+}
+
+int bignum_batch_mod_ui_multi(const bignum_batch_opts_t *opts, bignum_elem_t *rem,
+                              const bignum_elem_t *op1, const bignum_elem_t *moduli,
+                              size_t num_moduli, size_t num_elements, size_t count) {
+    batch_args_t args = {.rem = rem, .op1 = op1, .num_elements = num_elements,
+                         .moduli = moduli, .num_moduli = num_moduli};
+    // The chunks can't fail, so zero moduli are rejected here.
+    for (size_t j=0; j<num_moduli; j++) {
+        if (moduli[j] == 0)
+            return -1;
+    }
+    return bignum_batch_run(opts, count, mod_ui_multi_chunk, &args, 0);
+}
+
+/*
+ * Batch GCD:
+ *  - product_chunk()
+ *  - root_chunk(), fraction_chunk(), leaf_gcd_chunk()
+ *  - level_store(), level_load()
+ *  - bignum_batch_gcd()
+ *
+ * Level k of the product tree holds ceil(count / 2^k) products of up
+ * to 2^k moduli in slots of w_k = num_elements * 2^k elements, the last
+ * product of a level may have fewer factors. The root P isn't needed.
+ *
+ * Instead of the remainders P mod N^2 the way back down carries the
+ * fractions t = frac(P / N^2) (Bernstein's scaled remainder tree): If N
+ * has the children N1 and N2, then frac(P / N1^2) = frac(t * N2^2), so
+ * every node costs a squaring and a multiplication but no division. At
+ * the children of the root t = frac(N2 / N1) is found by Barrett's mu.
+ * At the leaves P mod N^2 = t * N^2, which is rounded up.
+ *
+ * A fraction at level k is an integer T = t * base^s_k, s_k = 2^k *
+ * (2 * num_elements + 1), which is rounded down. The errors of the
+ * levels add up to less than 1 / base at the leaves. The slot of a
+ * fraction is exactly the space of the slots of its children, which
+ * are calculated from a copy of it.
+**/
+typedef struct tree_args {
+    const bignum_elem_t *lower;
+    bignum_elem_t *upper;
+    bignum_elem_t *frac;
+    bignum_elem_t *rop;
+    size_t width;
+    size_t slot;
+    size_t lower_count;
+    atomic_int error;
+} tree_args_t;
+
+static void product_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    // Products of the pairs of level k-1, the last one may be single.
+    tree_args_t *a = arg;
+    bignum_t x, y, p;
+
+    for (size_t j=begin; j<end; j++) {
+        bignum_assoc_at(&x, (bignum_elem_t *) a->lower, a->width, 2*j);
+        bignum_assoc_at_len(&p, a->upper, 2 * a->width, j, 0);
+
+        if (2*j + 1 < a->lower_count) {
+            bignum_assoc_at(&y, (bignum_elem_t *) a->lower, a->width, 2*j + 1);
+            bignum_mul_scratch(&p, &x, &y, scratch);
+        }
+        else
+            bignum_set(&p, &x);
+        bignum_write(&p);
+    }
+}
+
+static void root_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    // T = base^s * (N2 mod N1) / N1 for both children N1 of the root
+    // and their siblings N2.
+    //
+    // With N1 of k elements and mu = base^(s+k) / N1, which is mu of
+    // N1 * base^(s-k), T = (N2 mod N1) * mu / base^k is at most one too
+    // small.
+    //
+    // scratch: N2 mod N1 (w), N1 * base^(s-k) (s), mu (s + 2), the
+    // product (w + s + 2), scratch of the functions.
+    tree_args_t *a = arg;
+    size_t w = a->width, s = a->slot, k;
+    bignum_elem_t *mp = &scratch[w];
+    bignum_elem_t *tp = &scratch[2*w + 3*s + 4];
+    bignum_barrett_ctx_t ctx;
+    bignum_t n1, n2, r, m, p, t, f;
+
+    for (size_t i=begin; i<end; i++) {
+        bignum_assoc_at(&n1, (bignum_elem_t *) a->lower, w, i);
+        bignum_assoc_at(&n2, (bignum_elem_t *) a->lower, w, 1 - i);
+        bignum_assoc_len(&r, scratch, w, 0);
+        if (bignum_mod(&r, &n2, &n1, tp) != 0) {
+            atomic_store(&a->error, 1);
+            return;
+        }
+
+        k = n1.length;
+        memset(mp, 0, (s - k) * sizeof(bignum_elem_t));
+        memcpy(&mp[s - k], n1.v, k * sizeof(bignum_elem_t));
+        bignum_assoc_len(&m, mp, s, s);
+        bignum_barrett_init(&ctx, &m, &scratch[w + s], tp);
+
+        bignum_assoc_len(&p, &scratch[w + 2*s + 2], w + s + 2, 0);
+        bignum_mul_scratch(&p, &r, &ctx.mu, tp);
+        bignum_assoc_at_len(&f, a->frac, s, i, 0);
+        bignum_assoc_len(&t, &p.v[k], s, p.length > k ? p.length - k : 0);
+        bignum_set(&f, &t);
+        bignum_write(&f);
+    }
+}
+
+static void fraction_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    // Replace the fractions of level k by those of their children,
+    // frac(t * N2^2) for the child N1 and its sibling N2. A single child
+    // has the same product, its fraction is the parent's with less
+    // precision.
+    //
+    // scratch: copy of the parent (2s), N2^2 (2w), the product (2s + 2w),
+    // scratch of the functions.
+    tree_args_t *a = arg;
+    size_t w = a->width, s = a->slot;
+    bignum_elem_t *tp = &scratch[4*s + 4*w];
+    bignum_t t, n, q, p, f;
+    size_t len;
+
+    for (size_t j=begin; j<end; j++) {
+        if (2*j + 1 >= a->lower_count) {
+            memmove(&a->frac[j * 2*s], &a->frac[j * 2*s + s], s * sizeof(bignum_elem_t));
+            continue;
+        }
+
+        memcpy(scratch, &a->frac[j * 2*s], 2*s * sizeof(bignum_elem_t));
+        bignum_assoc(&t, scratch, 2*s);
+        for (size_t i=0; i<2; i++) {
+            bignum_assoc_at(&n, (bignum_elem_t *) a->lower, w, 2*j + 1 - i);
+            bignum_assoc_len(&q, &scratch[2*s], 2*w, 0);
+            bignum_assoc_len(&p, &scratch[2*s + 2*w], 2*s + 2*w, 0);
+            bignum_sqr_scratch(&q, &n, tp);
+            bignum_mul_scratch(&p, &t, &q, tp);
+
+            // The fraction is the elements s to 2s-1 of the product.
+            len = p.length < s ? 0 : p.length < 2*s ? p.length - s : s;
+            bignum_assoc(&q, &p.v[s], len);
+            bignum_assoc_at_len(&f, a->frac, s, 2*j + i, 0);
+            bignum_set(&f, &q);
+            bignum_write(&f);
+        }
+    }
+}
+
+static void leaf_gcd_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    // rop[i] = gcd((P mod N^2) / N, N) with P mod N^2 = t * N^2 rounded
+    // up. The fraction t may have wrapped around to almost 1, if N^2
+    // divides P.
+    //
+    // scratch: N^2 (2n), the product (4n + 1), P mod N^2 (2n + 1),
+    // quotient (n + 1), remainder (n), scratch of the functions.
+    tree_args_t *a = arg;
+    size_t n = a->width, s = a->slot;
+    bignum_elem_t *tp = &scratch[10*n + 4];
+    bignum_t t, m, m2, p, x, q, r, g;
+    int up;
+
+    for (size_t i=begin; i<end; i++) {
+        bignum_assoc_at(&t, a->frac, s, i);
+        bignum_assoc_at(&m, (bignum_elem_t *) a->lower, n, i);
+        bignum_assoc_len(&m2, scratch, 2*n, 0);
+        bignum_assoc_len(&p, &scratch[2*n], 4*n + 1, 0);
+        bignum_assoc_len(&x, &scratch[6*n + 1], 2*n + 1, 0);
+        bignum_assoc_len(&q, &scratch[8*n + 2], n + 1, 0);
+        bignum_assoc_len(&r, &scratch[9*n + 3], n, 0);
+
+        bignum_sqr_scratch(&m2, &m, tp);
+        bignum_mul_scratch(&p, &t, &m2, tp);
+
+        up = 0;
+        for (size_t j=0; j<s && j<p.length; j++)
+            up |= p.v[j] != 0;
+        bignum_assoc_len(&p, &p.v[s], 2*n + 1, p.length > s ? p.length - s : 0);
+        bignum_add_ui(&x, &p, up);
+        if (bignum_cmp(&x, &m2) == 0)
+            bignum_zero(&x);
+
+        if (bignum_divmod(&q, &r, &x, &m, tp) != 0) {
+            atomic_store(&a->error, 1);
+            return;
+        }
+        bignum_assoc_at_len(&g, a->rop, n, i, 0);
+        bignum_gcd(&g, &q, &m, tp);
+        bignum_write(&g);
+    }
+}
+static int level_store(FILE **file, const bignum_elem_t *level, size_t num_elements,
+                       const char *tmpdir) {
+    // Write a level to a new file in tmpdir, which is deleted right away
+    // and vanishes once it is closed.
+    char *path = malloc(strlen(tmpdir) + sizeof("/bignum_gcd_XXXXXX"));
+    int fd;
+
+    if (path == NULL)
+        return -1;
+    strcpy(path, tmpdir);
+    strcat(path, "/bignum_gcd_XXXXXX");
+    fd = mkstemp(path);
+    if (fd >= 0)
+        unlink(path);
+    free(path);
+    if (fd < 0)
+        return -1;
+
+    *file = fdopen(fd, "w+b");
+    if (*file == NULL) {
+        close(fd);
+        return -1;
+    }
+    if (fwrite(level, sizeof(bignum_elem_t), num_elements, *file) != num_elements ||
+        fflush(*file) != 0)
+        return -1;
+    return 0;
+}
+
+static bignum_elem_t *level_load(FILE **file, size_t num_elements) {
+    // Read a level written by level_store() and close its file.
+    bignum_elem_t *level = malloc(num_elements * sizeof(bignum_elem_t));
+
+    if (level != NULL &&
+        (fseek(*file, 0, SEEK_SET) != 0 ||
+         fread(level, sizeof(bignum_elem_t), num_elements, *file) != num_elements)) {
+        free(level);
+        level = NULL;
+    }
+    fclose(*file);
+    *file = NULL;
+    return level;
+}
+
+int bignum_batch_gcd(const bignum_batch_opts_t *opts, bignum_elem_t *rop,
+                     const bignum_elem_t *moduli, size_t num_elements,
+                     size_t count, const char *tmpdir) {
+    bignum_batch_opts_t tree_opts = {0};
+    bignum_elem_t *levels[sizeof(size_t) * 8 + 1] = {NULL};
+    FILE *files[sizeof(size_t) * 8 + 1] = {NULL};
+    size_t counts[sizeof(size_t) * 8 + 1];
+    bignum_elem_t *frac = NULL;
+    tree_args_t args;
+    size_t w, s, scratch_elements;
+    int height = 0, ret = -1;
+    bignum_t m;
+
+    if (count == 0)
+        return 0;
+    if (num_elements == 0)
+        return -1;
+
+    if (count == 1) {
+        // The empty product is 1.
+        bignum_assoc(&m, (bignum_elem_t *) moduli, num_elements);
+        if (m.length == 0)
+            return -1;
+        bignum_assoc_len(&m, rop, num_elements, 0);
+        bignum_set_ui(&m, 1);
+        bignum_write(&m);
+        return 0;
+    }
+
+    if (opts != NULL)
+        tree_opts = *opts;
+    if (tree_opts.chunk == 0)
+        tree_opts.chunk = 1;
+
+    counts[0] = count;
+    while (counts[height] > 1) {
+        counts[height+1] = (counts[height] + 1) / 2;
+        height++;
+    }
+    // The fractions take (2 * num_elements + 1) * 2^height elements.
+    if (num_elements > (SIZE_MAX / sizeof(bignum_elem_t) / 64) >> height)
+        return -1;
+
+    // Product tree up to the children of the root
+    levels[0] = (bignum_elem_t *) moduli;
+    for (int k=1; k<height; k++) {
+        w = num_elements << (k-1);
+        levels[k] = bignum_batch_alloc(&tree_opts, 2*w, counts[k]);
+        if (levels[k] == NULL)
+            goto done;
+
+        args.lower = levels[k-1];
+        args.upper = levels[k];
+        args.width = w;
+        args.lower_count = counts[k-1];
+        if (bignum_batch_run(&tree_opts, counts[k], product_chunk, &args,
+                             BIGNUM_MUL_SCRATCH(w)) != 0)
+            goto done;
+
+        if (tmpdir != NULL && k > 1) {
+            if (level_store(&files[k-1], levels[k-1], counts[k-1] * w, tmpdir) != 0)
+                goto done;
+            bignum_batch_free(levels[k-1]);
+            levels[k-1] = NULL;
+        }
+    }
+
+    // Fractions of the two children of the root
+    frac = bignum_batch_alloc(&tree_opts, 2 * num_elements + 1, (size_t) 1 << height);
+    if (frac == NULL)
+        goto done;
+
+    w = num_elements << (height-1);
+    s = (2 * num_elements + 1) << (height-1);
+    args.lower = levels[height-1];
+    args.frac = frac;
+    args.width = w;
+    args.slot = s;
+    atomic_init(&args.error, 0);
+    scratch_elements = BIGNUM_BARRETT_SCRATCH(s);
+    if (scratch_elements < BIGNUM_MUL_SCRATCH(s + 2))
+        scratch_elements = BIGNUM_MUL_SCRATCH(s + 2);
+    if (bignum_batch_run(&tree_opts, 2, root_chunk, &args,
+                         2*w + 3*s + 4 + scratch_elements) != 0 ||
+        atomic_load(&args.error))
+        goto done;
+
+    // Down to the leaves
+    for (int k=height-1; k>0; k--) {
+        bignum_batch_free(levels[k]);
+        levels[k] = NULL;
+
+        w = num_elements << (k-1);
+        if (levels[k-1] == NULL) {
+            levels[k-1] = level_load(&files[k-1], counts[k-1] * w);
+            if (levels[k-1] == NULL)
+                goto done;
+        }
+
+        args.lower = levels[k-1];
+        args.width = w;
+        args.slot = (2 * num_elements + 1) << (k-1);
+        args.lower_count = counts[k-1];
+        if (bignum_batch_run(&tree_opts, counts[k], fraction_chunk, &args,
+                             4*args.slot + 4*w + BIGNUM_MUL_SCRATCH(2*args.slot)) != 0)
+            goto done;
+    }
+
+    // gcd((P mod N^2) / N, N) for every modulus N
+    args.lower = moduli;
+    args.rop = rop;
+    args.width = num_elements;
+    args.slot = 2 * num_elements + 1;
+    atomic_init(&args.error, 0);
+    if (bignum_batch_run(&tree_opts, count, leaf_gcd_chunk, &args,
+                         10*num_elements + 4 + BIGNUM_MUL_SCRATCH(2*num_elements + 1)) == 0 &&
+        !atomic_load(&args.error))
+        ret = 0;
+
+done:
+    for (int k=1; k<height; k++) {
+        bignum_batch_free(levels[k]);
+        if (files[k] != NULL)
+            fclose(files[k]);
+    }
+    bignum_batch_free(frac);
+    return ret;
+}
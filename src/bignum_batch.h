@@ -0,0 +1,182 @@
+/**
+ * @file
+ * @brief Multi-threaded batch operations on the host.
+ *
+ * A batch is an array of count numbers of num_elements elements each,
+ * stored one after another as expected by bignum_assoc_at(): Number j
+ * starts at arr[j*num_elements].
+ *
+ * The batch functions split the indices 0 to count-1 into chunks of
+ * opts->chunk indices. Every thread starts with an equal share of the
+ * chunks and processes them from the front. A thread which runs out of
+ * chunks steals from the back of the other threads' shares, so uneven
+ * work (e.g. numbers of different lengths) is balanced at the end.
+ *
+ * Every thread allocates its own scratch area. Output arrays allocated
+ * with bignum_batch_alloc() are first written by the threads, which own
+ * their chunks at the start of a batch, so on NUMA systems their pages
+ * are placed next to those threads (pin the threads with opts->pin to
+ * keep it that way).
+ *
+ * This is host-only code, it needs POSIX threads.
+**/
+#ifndef __BIGNUM_BATCH_H
+#define __BIGNUM_BATCH_H
+
+#include "bignum.h"
+
+#ifndef BIGNUM_BATCH_CHUNK
+/**
+ * @brief Default number of indices per chunk.
+ */
+#define BIGNUM_BATCH_CHUNK 256
+#endif
+
+/**
+ * @brief Options of the batch functions.
+ *
+ * All functions accept NULL for the default options, which can also
+ * be set by zeroing the struct.
+ */
+typedef struct bignum_batch_opts {
+    /** Number of threads or 0 for one per online CPU. */
+    unsigned int threads;
+    /** Number of indices per chunk or 0 for BIGNUM_BATCH_CHUNK. */
+    size_t chunk;
+    /** If nonzero, thread i is pinned to CPU i (Linux only). */
+    int pin;
+} bignum_batch_opts_t;
+
+/**
+ * @brief Function applied to the indices begin to end-1 of a batch.
+ *
+ * scratch is the scratch area of the calling thread, arg is passed
+ * through from bignum_batch_run().
+ */
+typedef void (*bignum_batch_fn_t)(size_t begin, size_t end,
+                                  bignum_elem_t *scratch, void *arg);
+
+/**
+ * @brief Call fn for all chunks of the indices 0 to count-1.
+ *
+ * @param opts: The options or NULL.
+ * @param count: The number of indices.
+ * @param fn: The function to call for every chunk.
+ * @param arg: Passed to fn.
+ * @param scratch_elements: The size of the scratch area of every thread.
+ *
+ * @Returns 0 on success and -1 if no thread could be started or a
+ *          scratch area couldn't be allocated.
+**/
+int bignum_batch_run(const bignum_batch_opts_t *opts, size_t count,
+                     bignum_batch_fn_t fn, void *arg, size_t scratch_elements);
+
+/**
+ * @brief Allocate a zeroed batch of count numbers.
+ *
+ * The memory is zeroed by the threads of bignum_batch_run() (see above).
+ *
+ * @Returns The batch or NULL on errors. Free it with bignum_batch_free().
+**/
+bignum_elem_t *bignum_batch_alloc(const bignum_batch_opts_t *opts,
+                                  size_t num_elements, size_t count);
+
+/**
+ * @brief Free a batch allocated by bignum_batch_alloc().
+**/
+void bignum_batch_free(bignum_elem_t *batch);
+
+/**
+ * @brief rop[i] = op1[i] + op2[i] for all numbers of the batches.
+ *
+ * overflow[i] is set to the return value of bignum_add(), overflow may
+ * be NULL. rop may be op1 or op2.
+ *
+ * @Returns 0 on success and -1 otherwise.
+**/
+int bignum_batch_add(const bignum_batch_opts_t *opts, bignum_elem_t *rop,
+                     const bignum_elem_t *op1, const bignum_elem_t *op2,
+                     int *overflow, size_t num_elements, size_t count);
+
+/**
+ * @brief rop[i] = op1[i] * op2[i] (truncated) for all numbers of the batches.
+ *
+ * overflow[i] is set to the return value of bignum_mul(), overflow may
+ * be NULL. rop must not share memory with op1 or op2.
+ *
+ * @Returns 0 on success and -1 otherwise.
+**/
+int bignum_batch_mul(const bignum_batch_opts_t *opts, bignum_elem_t *rop,
+                     const bignum_elem_t *op1, const bignum_elem_t *op2,
+                     int *overflow, size_t num_elements, size_t count);
+
+/**
+ * @brief q[i] = op1[i] / d and rem[i] = op1[i] % d.
+ *
+ * q may be op1, rem may be NULL.
+ *
+ * @Returns 0 on success and -1 if d is zero or on errors.
+**/
+int bignum_batch_divmod_ui(const bignum_batch_opts_t *opts, bignum_elem_t *q,
+                           bignum_elem_t *rem, const bignum_elem_t *op1,
+                           bignum_elem_t d, size_t num_elements, size_t count);
+
+/**
+ * @brief rem[i] = op1[i] % d.
+ *
+ * @Returns 0 on success and -1 if d is zero or on errors.
+**/
+int bignum_batch_mod_ui(const bignum_batch_opts_t *opts, bignum_elem_t *rem,
+                        const bignum_elem_t *op1, bignum_elem_t d,
+                        size_t num_elements, size_t count);
+
+/**
+ * @brief rem[i*num_moduli + j] = op1[i] % moduli[j].
+ *
+ * Every number is reduced by all moduli with bignum_mod_ui_multi(), e.g.
+ * the small primes for sieving candidates before a primality test.
+ *
+ * @Returns 0 on success and -1 if a modulus is zero or on errors.
+**/
+int bignum_batch_mod_ui_multi(const bignum_batch_opts_t *opts, bignum_elem_t *rem,
+                              const bignum_elem_t *op1, const bignum_elem_t *moduli,
+                              size_t num_moduli, size_t num_elements, size_t count);
+
+/**
+ * @brief Find the moduli which share a factor with other moduli.
+ *
+ * Sets rop[i] = gcd(moduli[i], product of all other moduli), so rop[i]
+ * is 1 for a modulus which shares no factor with the others. This is
+ * Bernstein's batch GCD: A product tree of the moduli is built level by
+ * level, then P mod N^2 of its root P and every node N goes back down as
+ * the fraction P / N^2 - floor(P / N^2) (scaled remainder tree), which
+ * takes two products per node and no divisions. At the leaves rop[i] =
+ * gcd((P mod N^2) / N, N). Every level is a batch run by
+ * bignum_batch_run(). The upper levels have few nodes, which are
+ * calculated by one thread each.
+ *
+ * The whole product tree takes about log2(count) times the memory of the
+ * moduli. If tmpdir is not NULL, every level is written to an unnamed
+ * file in this directory once the next one is calculated, and read back
+ * for the fractions. Then only the fractions (up to about four times the
+ * moduli), two levels and the scratch areas are in memory at a time.
+ *
+ * The nodes are processed in chunks of opts->chunk or a single node.
+ * rop may be moduli.
+ *
+ * @param opts: The options or NULL.
+ * @param rop: A batch of count numbers of num_elements elements.
+ * @param moduli: The moduli, none of them zero.
+ * @param num_elements: Number of elements of every modulus.
+ * @param count: The number of moduli.
+ * @param tmpdir: A directory for the levels of the product tree or NULL
+ *                to keep them in memory.
+ *
+ * @Returns 0 on success and -1 if a modulus is zero, memory couldn't be
+ *          allocated or a file couldn't be written or read.
+**/
+int bignum_batch_gcd(const bignum_batch_opts_t *opts, bignum_elem_t *rop,
+                     const bignum_elem_t *moduli, size_t num_elements,
+                     size_t count, const char *tmpdir);
+
+#endif // __BIGNUM_BATCH_H
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bignum_cl.h"
+
+/*
+ * Cache keys:
+ *  - hash_bytes(), hash_string(), hash_file()
+ *  - cache_key()
+**/
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static unsigned long long hash_bytes(unsigned long long h, const void *data, size_t n) {
+    // 64 bit FNV-1a hash of data, continuing from h.
+    const unsigned char *p = data;
+    for (size_t i=0; i<n; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static unsigned long long hash_string(unsigned long long h, const char *s) {
+    // Hash s including its terminating zero, which separates it from
+    // the following data.
+    return hash_bytes(h, s, strlen(s) + 1);
+}
+
+static int hash_file(unsigned long long *h, const char *path) {
+    // Hash the contents of the file at path.
+    // Returns 0 on success and -1 if the file can't be read.
+    char buf[4096];
+    size_t n;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+
+    *h = hash_string(*h, path);
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        *h = hash_bytes(*h, buf, n);
+    fclose(f);
+    return 0;
+}
+
+static int cache_key(unsigned long long *key, cl_device_id device, const char *source,
+                     const char *options, const char *const *files) {
+    // Hash everything the program binary depends on.
+    // Returns 0 on success and -1 on errors.
+    static const cl_device_info infos[] = {
+        CL_DEVICE_NAME, CL_DEVICE_VENDOR, CL_DEVICE_VERSION, CL_DRIVER_VERSION
+    };
+    char info[1024];
+    unsigned long long h = FNV_OFFSET;
+
+    for (size_t i=0; i < sizeof(infos) / sizeof(infos[0]); i++) {
+        if (clGetDeviceInfo(device, infos[i], sizeof(info), info, NULL) != CL_SUCCESS)
+            return -1;
+        info[sizeof(info) - 1] = '\0';
+        h = hash_string(h, info);
+    }
+
+    h = hash_string(h, options);
+    h = hash_string(h, source);
+    for (size_t i=0; files != NULL && files[i] != NULL; i++)
+        if (hash_file(&h, files[i]) != 0)
+            return -1;
+
+    *key = h;
+    return 0;
+}
+
+/*
+ * Cache files:
+ *  - load_binary()
+ *  - store_binary()
+**/
+static unsigned char *load_binary(const char *path, size_t *size) {
+    // Read the file at path into a new buffer.
+    // Returns NULL, if there is no such file.
+    unsigned char *binary;
+    long n;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    if (fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    binary = malloc(n);
+    if (binary != NULL && fread(binary, 1, n, f) != (size_t) n) {
+        free(binary);
+        binary = NULL;
+    }
+    fclose(f);
+    *size = n;
+    return binary;
+}
+
+static void store_binary(cl_program program, const char *path) {
+    // Write the binary of program to path. Concurrent processes may
+    // build the same program, so the binary is written to a temporary
+    // file first and renamed to path, which replaces it atomically.
+    char tmp_path[4096];
+    unsigned char *binary;
+    size_t size;
+    cl_uint num_devices;
+    FILE *f;
+
+    // The program is built for a single device.
+    if (clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(num_devices),
+                         &num_devices, NULL) != CL_SUCCESS || num_devices != 1)
+        return;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size),
+                         &size, NULL) != CL_SUCCESS || size == 0)
+        return;
+
+    binary = malloc(size);
+    if (binary == NULL)
+        return;
+
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary),
+                         &binary, NULL) == CL_SUCCESS &&
+        snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long) getpid()) <
+            (int) sizeof(tmp_path)) {
+        f = fopen(tmp_path, "wb");
+        if (f != NULL) {
+            int ok = fwrite(binary, 1, size, f) == size;
+            if (fclose(f) == 0 && ok)
+                rename(tmp_path, path);
+            else
+                remove(tmp_path);
+        }
+    }
+    free(binary);
+}
+
+static void print_build_log(cl_program program, cl_device_id device) {
+    size_t length;
+    char *log;
+
+    if (clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG,
+                              0, NULL, &length) != CL_SUCCESS)
+        return;
+    log = malloc(length);
+    if (log == NULL)
+        return;
+    if (clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG,
+                              length, log, NULL) == CL_SUCCESS)
+        fprintf(stderr, "Build log:\n%s\n", log);
+    free(log);
+}
+
+/*
+ * Building programs:
+ *  - bignum_cl_options()
+ *  - bignum_cl_build()
+ *  - bignum_cl_build_kernels()
+**/
+int bignum_cl_options(char *buf, size_t size, const char *src_dir,
+                      const char *elem_type, size_t batch_elements) {
+    int n = snprintf(buf, size, "-I \"%s\"", src_dir);
+
+    if (n >= 0 && (size_t) n < size && elem_type != NULL)
+        n += snprintf(&buf[n], size - n, " -D \"BIGNUM_ELEM_TYPE=%s\"", elem_type);
+    if (n >= 0 && (size_t) n < size && batch_elements > 0)
+        n += snprintf(&buf[n], size - n, " -D BIGNUM_BATCH_ELEMENTS=%zu", batch_elements);
+
+    if (n < 0 || (size_t) n >= size)
+        return -1;
+    return 0;
+}
+
+cl_program bignum_cl_build(cl_context context, cl_device_id device,
+                           const char *source, const char *options,
+                           const char *const *files, const char *cache_dir,
+                           cl_int *errcode_ret) {
+    char path[4096];
+    unsigned long long key;
+    unsigned char *binary = NULL;
+    size_t size;
+    cl_program program;
+    cl_int ret, status;
+
+    if (errcode_ret == NULL)
+        errcode_ret = &ret;
+
+    if (cache_dir != NULL && cache_key(&key, device, source, options, files) == 0 &&
+        snprintf(path, sizeof(path), "%s/bignum-%016llx.bin", cache_dir, key) <
+            (int) sizeof(path))
+        binary = load_binary(path, &size);
+    else
+        cache_dir = NULL;
+
+    if (binary != NULL) {
+        program = clCreateProgramWithBinary(context, 1, &device, &size,
+            (const unsigned char **) &binary, &status, &ret);
+        free(binary);
+
+        if (ret == CL_SUCCESS && status == CL_SUCCESS) {
+            ret = clBuildProgram(program, 1, &device, options, NULL, NULL);
+            if (ret == CL_SUCCESS) {
+                *errcode_ret = CL_SUCCESS;
+                return program;
+            }
+        }
+        // The binary is outdated or broken, build from source and
+        // replace it.
+        if (program != NULL)
+            clReleaseProgram(program);
+    }
+
+    size = strlen(source);
+    program = clCreateProgramWithSource(context, 1, &source, &size, errcode_ret);
+    if (*errcode_ret != CL_SUCCESS)
+        return NULL;
+
+    *errcode_ret = clBuildProgram(program, 1, &device, options, NULL, NULL);
+    if (*errcode_ret != CL_SUCCESS) {
+        print_build_log(program, device);
+        clReleaseProgram(program);
+        return NULL;
+    }
+
+    if (cache_dir != NULL)
+        store_binary(program, path);
+    return program;
+}
+
+cl_program bignum_cl_build_kernels(cl_context context, cl_device_id device,
+                                   const char *src_dir, const char *elem_type,
+                                   size_t batch_elements, const char *cache_dir,
+                                   cl_int *errcode_ret) {
+    static const char *source = "#include \"bignum_kernels.cl\"\n";
+    static const char *names[] = {"bignum_kernels.cl", "bignum.c", "bignum.h"};
+    char options[1024];
+    char paths[3][4096];
+    const char *files[4];
+
+    if (bignum_cl_options(options, sizeof(options), src_dir,
+                          elem_type, batch_elements) != 0) {
+        if (errcode_ret != NULL)
+            *errcode_ret = CL_INVALID_VALUE;
+        return NULL;
+    }
+
+    for (size_t i=0; i<3; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/%s", src_dir, names[i]);
+        files[i] = paths[i];
+    }
+    files[3] = NULL;
+
+    return bignum_cl_build(context, device, source, options, files,
+                           cache_dir, errcode_ret);
+}
+
+/*
+ * Batch primality test:
+ *  - launch()
+ *  - bignum_cl_is_probab_prime()
+**/
+static cl_int launch(cl_command_queue queue, cl_kernel kernel, size_t work_items,
+                     size_t local_size) {
+    // Run kernel over work_items rounded up to a multiple of local_size.
+    size_t global_size = work_items;
+    if (local_size > 0)
+        global_size = (work_items + local_size - 1) / local_size * local_size;
+    return clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+                                  local_size > 0 ? &local_size : NULL, 0, NULL, NULL);
+}
+
+cl_int bignum_cl_is_probab_prime(cl_command_queue queue, cl_program program,
+                                 cl_mem bitmap, cl_mem candidates, cl_ulong count,
+                                 const cl_uint *bases, size_t rounds, size_t local_size) {
+    const cl_uint zero = 0;
+    cl_context context;
+    cl_kernel trial = NULL, round = NULL;
+    cl_mem indices[2] = {NULL, NULL}, counter = NULL, r2 = NULL;
+    cl_uint survivors = 0;
+    cl_ulong index_count;
+    cl_int first, last, ret;
+    size_t size;
+
+    if (count == 0)
+        return CL_SUCCESS;
+    if (count > 0xffffffff || (bases == NULL && rounds > 0))
+        return CL_INVALID_VALUE;
+
+    ret = clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+    if (ret == CL_SUCCESS)
+        trial = clCreateKernel(program, "bignum_batch_trial_division", &ret);
+    if (ret == CL_SUCCESS)
+        round = clCreateKernel(program, "bignum_batch_miller_rabin", &ret);
+    for (int i=0; i<2 && ret == CL_SUCCESS; i++)
+        indices[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, count * sizeof(cl_uint),
+                                    NULL, &ret);
+    if (ret == CL_SUCCESS)
+        counter = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &ret);
+    // R^2 mod n of every candidate is kept between the rounds, it is an
+    // interleaved batch of the same size as the candidates.
+    if (ret == CL_SUCCESS)
+        ret = clGetMemObjectInfo(candidates, CL_MEM_SIZE, sizeof(size), &size, NULL);
+    if (ret == CL_SUCCESS && rounds > 0)
+        r2 = clCreateBuffer(context, CL_MEM_READ_WRITE, size, NULL, &ret);
+    if (ret != CL_SUCCESS)
+        goto done;
+
+    // Trial division, the undecided candidates go to indices[0].
+    last = rounds == 0;
+    clSetKernelArg(trial, 0, sizeof(cl_mem), &bitmap);
+    clSetKernelArg(trial, 1, sizeof(cl_mem), &indices[0]);
+    clSetKernelArg(trial, 2, sizeof(cl_mem), &counter);
+    clSetKernelArg(trial, 3, sizeof(cl_mem), &candidates);
+    clSetKernelArg(trial, 4, sizeof(last), &last);
+    clSetKernelArg(trial, 5, sizeof(count), &count);
+
+    ret = clEnqueueFillBuffer(queue, bitmap, &zero, sizeof(zero), 0,
+                              (count + 31) / 32 * sizeof(cl_uint), 0, NULL, NULL);
+    if (ret == CL_SUCCESS)
+        ret = clEnqueueWriteBuffer(queue, counter, CL_TRUE, 0, sizeof(zero), &zero, 0, NULL, NULL);
+    if (ret == CL_SUCCESS)
+        ret = launch(queue, trial, count, local_size);
+    if (ret == CL_SUCCESS)
+        ret = clEnqueueReadBuffer(queue, counter, CL_TRUE, 0, sizeof(survivors), &survivors,
+                                  0, NULL, NULL);
+
+    // Every round only launches work-items for the candidates which
+    // passed the round before, their indices alternate between the
+    // two buffers.
+    for (size_t r=0; r<rounds && survivors > 0 && ret == CL_SUCCESS; r++) {
+        index_count = survivors;
+        first = r == 0;
+        last = r + 1 == rounds;
+        clSetKernelArg(round, 0, sizeof(cl_mem), &bitmap);
+        clSetKernelArg(round, 1, sizeof(cl_mem), &indices[(r + 1) % 2]);
+        clSetKernelArg(round, 2, sizeof(cl_mem), &counter);
+        clSetKernelArg(round, 3, sizeof(cl_mem), &indices[r % 2]);
+        clSetKernelArg(round, 4, sizeof(index_count), &index_count);
+        clSetKernelArg(round, 5, sizeof(cl_mem), &candidates);
+        clSetKernelArg(round, 6, sizeof(cl_mem), &r2);
+        clSetKernelArg(round, 7, sizeof(cl_uint), &bases[r]);
+        clSetKernelArg(round, 8, sizeof(first), &first);
+        clSetKernelArg(round, 9, sizeof(last), &last);
+        clSetKernelArg(round, 10, sizeof(count), &count);
+
+        ret = clEnqueueWriteBuffer(queue, counter, CL_TRUE, 0, sizeof(zero), &zero, 0, NULL, NULL);
+        if (ret == CL_SUCCESS)
+            ret = launch(queue, round, index_count, local_size);
+        if (ret == CL_SUCCESS)
+            ret = clEnqueueReadBuffer(queue, counter, CL_TRUE, 0, sizeof(survivors),
+                                      &survivors, 0, NULL, NULL);
+    }
+    if (ret == CL_SUCCESS)
+        ret = clFinish(queue);
+
+done:
+    for (int i=0; i<2; i++) {
+        if (indices[i] != NULL)
+            clReleaseMemObject(indices[i]);
+    }
+    if (counter != NULL)
+        clReleaseMemObject(counter);
+    if (r2 != NULL)
+        clReleaseMemObject(r2);
+    if (trial != NULL)
+        clReleaseKernel(trial);
+    if (round != NULL)
+        clReleaseKernel(round);
+    return ret;
+}
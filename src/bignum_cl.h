@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @brief Host helpers to build the bignum library into OpenCL programs.
+ *
+ * # Program binary cache
+ *
+ * Building bignum.c from source takes seconds on some OpenCL drivers.
+ * bignum_cl_build() stores the binary of a successful build in a cache
+ * directory and loads it with clCreateProgramWithBinary() on later runs.
+ *
+ * A cached binary is identified by a hash of the device name, the
+ * device and driver versions, the build options, the source and the
+ * contents of all files included by the source. So changing any of
+ * these (including BIGNUM_ELEM_TYPE in the options) builds and caches
+ * a new binary, old ones are never used again.
+ *
+ * This code builds the batch kernels with 32 bit elements and caches
+ * the binary in /tmp/bignum:
+ * @code{.c}
+ * cl_int ret;
+ * cl_program program = bignum_cl_build_kernels(context, device, "src",
+ *     "unsigned int", 0, "/tmp/bignum", &ret);
+ * @endcode
+**/
+#ifndef __BIGNUM_CL_H
+#define __BIGNUM_CL_H
+
+#include <stddef.h>
+
+#include <CL/cl.h>
+
+/**
+ * @brief Write the build options for the bignum library to buf.
+ *
+ * @param buf: Buffer for the options.
+ * @param size: Size of buf in bytes.
+ * @param src_dir: The directory of bignum.c, which is added with -I.
+ * @param elem_type: Value of BIGNUM_ELEM_TYPE, e.g. "unsigned int",
+ *                   or NULL for the default.
+ * @param batch_elements: Value of BIGNUM_BATCH_ELEMENTS for
+ *                        bignum_kernels.cl or 0 for the default.
+ *
+ * @Returns 0 on success and -1 if buf is too small.
+**/
+int bignum_cl_options(char *buf, size_t size, const char *src_dir,
+                      const char *elem_type, size_t batch_elements);
+
+/**
+ * @brief Build source for device or load it from the cache.
+ *
+ * @param context: The context of the program.
+ * @param device: The device to build for.
+ * @param source: The program source.
+ * @param options: The build options.
+ * @param files: NULL terminated list of files included by source. Their
+ *               contents are part of the cache key. May be NULL.
+ * @param cache_dir: An existing directory for cached binaries or NULL
+ *                   to always build from source.
+ * @param errcode_ret: Set to CL_SUCCESS or the error code of the
+ *                     failing OpenCL call, if not NULL.
+ *
+ * The build log of a failed build is written to stderr. A cached binary
+ * which can't be loaded is replaced by a new build.
+ *
+ * @Returns The built program or NULL on errors.
+**/
+cl_program bignum_cl_build(cl_context context, cl_device_id device,
+                           const char *source, const char *options,
+                           const char *const *files, const char *cache_dir,
+                           cl_int *errcode_ret);
+
+/**
+ * @brief Build the kernels of bignum_kernels.cl using the cache.
+ *
+ * The parameters are those of bignum_cl_options() and bignum_cl_build().
+ *
+ * @Returns The built program or NULL on errors.
+**/
+cl_program bignum_cl_build_kernels(cl_context context, cl_device_id device,
+                                   const char *src_dir, const char *elem_type,
+                                   size_t batch_elements, const char *cache_dir,
+                                   cl_int *errcode_ret);
+
+/**
+ * @brief Test a batch of candidates for primality on the device.
+ *
+ * This is bignum_is_probab_prime() for every candidate: The kernel
+ * bignum_batch_trial_division() is followed by one launch of
+ * bignum_batch_miller_rabin() per base. Each launch only covers the
+ * candidates which are still undecided, their indices are compacted on
+ * the device and the number of survivors is read back for the size of
+ * the next launch. So most work-items of the expensive rounds test
+ * probable primes instead of idling after an early composite.
+ *
+ * The first round stores R^2 mod n of every candidate in a temporary
+ * buffer of the size of candidates, so the later rounds don't set up
+ * their Montgomery contexts again.
+ *
+ * @param queue: The command queue. The function returns after all
+ *               commands are finished.
+ * @param program: bignum_kernels.cl, e.g. by bignum_cl_build_kernels().
+ * @param bitmap: A buffer of (count + 31) / 32 cl_uints. Bit i % 32 of
+ *                word i / 32 is set for a (probable) prime candidate i
+ *                and cleared otherwise.
+ * @param candidates: An interleaved batch of count numbers of
+ *                    BIGNUM_BATCH_ELEMENTS elements.
+ * @param count: The number of candidates, less than 2^32.
+ * @param bases: rounds bases, which must fit into an element.
+ * @param rounds: The number of Miller-Rabin rounds.
+ * @param local_size: The local work size or 0 to let OpenCL choose.
+ *
+ * @Returns CL_SUCCESS or the error code of the failing OpenCL call.
+**/
+cl_int bignum_cl_is_probab_prime(cl_command_queue queue, cl_program program,
+                                 cl_mem bitmap, cl_mem candidates, cl_ulong count,
+                                 const cl_uint *bases, size_t rounds, size_t local_size);
+
+#endif // __BIGNUM_CL_H
@@ -0,0 +1,257 @@
+/**
+ * @file
+ * @brief Batch kernels on interleaved arrays of numbers.
+ *
+ * Every work-item handles the number at its global id. The numbers
+ * are stored interleaved (see bignum_load_interleaved()), so the
+ * work-items of a work-group access consecutive addresses.
+ *
+ * All numbers of a batch have BIGNUM_BATCH_ELEMENTS elements, which can
+ * be set with -D BIGNUM_BATCH_ELEMENTS=... when building the program.
+ * The number of numbers is passed to every kernel as count, the global
+ * work size may be larger than that.
+ *
+ * Build this file with -I pointing to the src/ directory.
+**/
+#include "bignum.c"
+
+#ifndef BIGNUM_BATCH_ELEMENTS
+#define BIGNUM_BATCH_ELEMENTS BIGNUM_2048
+#endif
+
+static void batch_load(bignum_t *num, bignum_elem_t *arr,
+                       const global bignum_elem_t *batch, ulong count, size_t index) {
+    // bignum_load_interleaved() from global memory.
+    size_t length = 0;
+    for (size_t i=0; i < BIGNUM_BATCH_ELEMENTS; i++) {
+        arr[i] = batch[i*count + index];
+        if (arr[i] != 0)
+            length = i + 1;
+    }
+    bignum_assoc_len(num, arr, BIGNUM_BATCH_ELEMENTS, length);
+}
+
+static void batch_store(global bignum_elem_t *batch, const bignum_t *num,
+                        ulong count, size_t index) {
+    // bignum_store_interleaved() to global memory.
+    for (size_t i=0; i < BIGNUM_BATCH_ELEMENTS; i++)
+        batch[i*count + index] = i < num->length ? num->v[i] : 0;
+}
+
+/**
+ * @brief rop[i] = op1[i] + op2[i], overflow[i] is set to the carry.
+**/
+kernel void bignum_batch_add(global bignum_elem_t *rop,
+                             const global bignum_elem_t *op1,
+                             const global bignum_elem_t *op2,
+                             global int *overflow, const ulong count) {
+    size_t index = get_global_id(0);
+    if (index >= count)
+        return;
+
+    bignum_t a, b, r;
+    bignum_elem_t a_elem[BIGNUM_BATCH_ELEMENTS];
+    bignum_elem_t b_elem[BIGNUM_BATCH_ELEMENTS];
+    bignum_elem_t r_elem[BIGNUM_BATCH_ELEMENTS];
+
+    batch_load(&a, a_elem, op1, count, index);
+    batch_load(&b, b_elem, op2, count, index);
+    bignum_assoc_len(&r, r_elem, BIGNUM_BATCH_ELEMENTS, 0);
+
+    overflow[index] = bignum_add(&r, &a, &b);
+    batch_store(rop, &r, count, index);
+}
+
+/**
+ * @brief rop[i] = op1[i] * op2[i] (truncated), overflow[i] is set if
+ *        the product didn't fit.
+**/
+kernel void bignum_batch_mul(global bignum_elem_t *rop,
+                             const global bignum_elem_t *op1,
+                             const global bignum_elem_t *op2,
+                             global int *overflow, const ulong count) {
+    size_t index = get_global_id(0);
+    if (index >= count)
+        return;
+
+    bignum_t a, b, r;
+    bignum_elem_t a_elem[BIGNUM_BATCH_ELEMENTS];
+    bignum_elem_t b_elem[BIGNUM_BATCH_ELEMENTS];
+    bignum_elem_t r_elem[BIGNUM_BATCH_ELEMENTS];
+
+    batch_load(&a, a_elem, op1, count, index);
+    batch_load(&b, b_elem, op2, count, index);
+    bignum_assoc_len(&r, r_elem, BIGNUM_BATCH_ELEMENTS, 0);
+
+    // A Karatsuba scratch area per work-item would exceed the private
+    // memory of most devices, so this multiplies by schoolbook.
+    overflow[index] = bignum_mul_scratch(&r, &a, &b, NULL);
+    batch_store(rop, &r, count, index);
+}
+
+/**
+ * @brief rem[i] = op1[i] % d.
+**/
+kernel void bignum_batch_mod_ui(global bignum_elem_t *rem,
+                                const global bignum_elem_t *op1,
+                                const bignum_elem_t d, const ulong count) {
+    size_t index = get_global_id(0);
+    if (index >= count)
+        return;
+
+    bignum_t a;
+    bignum_elem_t a_elem[BIGNUM_BATCH_ELEMENTS];
+    bignum_udiv_ctx_t ctx;
+
+    batch_load(&a, a_elem, op1, count, index);
+    bignum_udiv_init(&ctx, d);
+    rem[index] = bignum_mod_ui_pre(&a, &ctx);
+}
+
+#ifndef BIGNUM_BATCH_MODULI
+#define BIGNUM_BATCH_MODULI 64
+#endif
+
+/**
+ * @brief rem[j*count + i] = op1[i] % moduli[j] for num_moduli moduli.
+ *
+ * The remainders are interleaved like the numbers. The moduli are
+ * copied to private memory and passed to bignum_mod_ui_multi() in
+ * chunks of BIGNUM_BATCH_MODULI, so op1[i] is read once per chunk.
+ * The moduli mustn't be zero.
+**/
+kernel void bignum_batch_mod_ui_multi(global bignum_elem_t *rem,
+                                      const global bignum_elem_t *op1,
+                                      const global bignum_elem_t *moduli,
+                                      const ulong num_moduli, const ulong count) {
+    size_t index = get_global_id(0);
+    if (index >= count)
+        return;
+
+    bignum_t a;
+    bignum_elem_t a_elem[BIGNUM_BATCH_ELEMENTS];
+    bignum_elem_t mod[BIGNUM_BATCH_MODULI], out[BIGNUM_BATCH_MODULI];
+    size_t chunk;
+
+    batch_load(&a, a_elem, op1, count, index);
+    for (size_t j=0; j<num_moduli; j+=chunk) {
+        chunk = num_moduli - j < BIGNUM_BATCH_MODULI ? num_moduli - j : BIGNUM_BATCH_MODULI;
+        for (size_t k=0; k<chunk; k++)
+            mod[k] = moduli[j+k];
+        bignum_mod_ui_multi(&a, mod, out, chunk);
+        for (size_t k=0; k<chunk; k++)
+            rem[(j+k)*count + index] = out[k];
+    }
+}
+
+/**
+ * @brief result[i] = bignum_cmp(op1[i], op2[i]).
+ *
+ * The comparison runs directly on global memory, since it only reads
+ * the elements from the top down to the first difference.
+**/
+kernel void bignum_batch_cmp(global int *result,
+                             const global bignum_elem_t *op1,
+                             const global bignum_elem_t *op2,
+                             const ulong count) {
+    size_t index = get_global_id(0);
+    if (index >= count)
+        return;
+
+    int ret = 0;
+    bignum_elem_t a, b;
+    for (size_t i=BIGNUM_BATCH_ELEMENTS; i>0 && ret == 0; i--) {
+        a = op1[(i-1)*count + index];
+        b = op2[(i-1)*count + index];
+        ret = (a > b) - (a < b);
+    }
+    result[index] = ret;
+}
+
+/**
+ * @brief Trial division of the candidates, the first step of a batch
+ *        primality test.
+ *
+ * The candidates are tested with bignum_trial_division(). Primes are
+ * marked in bitmap (bit i % 32 of word i / 32 for candidate i), which
+ * has to be zeroed before. The indices of the candidates which aren't
+ * decided are appended to survivors, survivor_count has to be zeroed
+ * before. If last is set, they are marked in bitmap instead.
+ *
+ * Only the survivors go on to bignum_batch_miller_rabin(), so the
+ * work-items of the next round don't idle on composites.
+**/
+kernel void bignum_batch_trial_division(global uint *bitmap, global uint *survivors,
+                                        global uint *survivor_count,
+                                        const global bignum_elem_t *candidates,
+                                        const int last, const ulong count) {
+    size_t index = get_global_id(0);
+    if (index >= count)
+        return;
+
+    bignum_t n;
+    bignum_elem_t n_elem[BIGNUM_BATCH_ELEMENTS];
+
+    batch_load(&n, n_elem, candidates, count, index);
+    int ret = bignum_trial_division(&n);
+    if (ret == 2 || (ret == 1 && last))
+        atomic_or(&bitmap[index / 32], 1u << (index % 32));
+    else if (ret == 1)
+        survivors[atomic_inc(survivor_count)] = index;
+}
+
+/**
+ * @brief One Miller-Rabin round of the candidates in indices.
+ *
+ * Work-item i tests candidate indices[i] with bignum_miller_rabin_mont().
+ * The indices of the candidates which pass are appended to survivors
+ * (survivor_count has to be zeroed before) for the next round, or
+ * marked in bitmap in the last round. Launch this with a global work
+ * size of at least index_count, the survivor count of the round before.
+ *
+ * r2 is an interleaved batch like candidates. In the first round R^2 mod
+ * n of the Montgomery context of every candidate is stored there, the
+ * later rounds set their context up from it with bignum_mont_assoc().
+ *
+ * The scratch area of BIGNUM_PRIME_SCRATCH(BIGNUM_BATCH_ELEMENTS)
+ * elements is private memory. Building with a smaller
+ * BIGNUM_POWM_WINDOW reduces it.
+**/
+kernel void bignum_batch_miller_rabin(global uint *bitmap, global uint *survivors,
+                                      global uint *survivor_count,
+                                      const global uint *indices, const ulong index_count,
+                                      const global bignum_elem_t *candidates,
+                                      global bignum_elem_t *r2,
+                                      const uint base, const int first, const int last,
+                                      const ulong count) {
+    size_t i = get_global_id(0);
+    if (i >= index_count)
+        return;
+
+    size_t index = indices[i];
+    bignum_t n, r;
+    bignum_mont_ctx_t ctx;
+    bignum_elem_t n_elem[BIGNUM_BATCH_ELEMENTS];
+    bignum_elem_t scratch[BIGNUM_PRIME_SCRATCH(BIGNUM_BATCH_ELEMENTS)];
+
+    // R^2 mod n comes first in the scratch area, as in bignum_miller_rabin().
+    batch_load(&n, n_elem, candidates, count, index);
+    if (first) {
+        if (bignum_mont_init_scratch(&ctx, &n, scratch,
+                                     &scratch[BIGNUM_BATCH_ELEMENTS]) != 0)
+            return;
+        batch_store(r2, &ctx.r2, count, index);
+    }
+    else {
+        batch_load(&r, scratch, r2, count, index);
+        bignum_mont_assoc(&ctx, &n, scratch);
+    }
+
+    if (bignum_miller_rabin_mont(&ctx, (bignum_elem_t) base,
+                                 &scratch[BIGNUM_BATCH_ELEMENTS]) != 1)
+        return;
+    if (last)
+        atomic_or(&bitmap[index / 32], 1u << (index % 32));
+    else
+        survivors[atomic_inc(survivor_count)] = index;
+}
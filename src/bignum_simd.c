@@ -0,0 +1,431 @@
+#include <stdint.h>
+
+#include "bignum_simd.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BIGNUM_SIMD_X86
+#include <immintrin.h>
+#endif
+
+enum simd_op { OP_ADD, OP_MUL_UI, OP_MUL };
+
+static bignum_simd_isa_t selected = BIGNUM_SIMD_AUTO;
+
+/*
+ * Scalar fallback:
+ *  - scalar_op()
+**/
+static void scalar_op(enum simd_op op, bignum_elem_t *rop, const bignum_elem_t *op1,
+                      const bignum_elem_t *op2, bignum_elem_t ui, int *overflow,
+                      size_t n, size_t count, size_t j) {
+    // Calculate number j with the functions of bignum.h.
+    bignum_elem_t x_elem[BIGNUM_SIMD_MAX_ELEMENTS], y_elem[BIGNUM_SIMD_MAX_ELEMENTS];
+    bignum_elem_t z_elem[BIGNUM_SIMD_MAX_ELEMENTS];
+    bignum_t x, y, z;
+    int ret;
+
+    bignum_load_interleaved(&x, x_elem, op1, n, count, j);
+    if (op != OP_MUL_UI)
+        bignum_load_interleaved(&y, y_elem, op2, n, count, j);
+    bignum_assoc_len(&z, z_elem, n, 0);
+
+    if (op == OP_ADD)
+        ret = bignum_add(&z, &x, &y);
+    else if (op == OP_MUL_UI)
+        ret = bignum_mul_ui(&z, &x, ui);
+    else
+        ret = bignum_mul(&z, &x, &y);
+
+    bignum_store_interleaved(rop, &z, count, j);
+    if (overflow != NULL)
+        overflow[j] = ret;
+}
+
+#ifdef BIGNUM_SIMD_X86
+/*
+ * AVX2, 4 numbers per vector:
+ *  - add_avx2()
+ *  - mul_avx2()
+ *
+ * The products are calculated in digits of 32 bits. _mm256_mul_epu32()
+ * gives the full 64 bit product of two digits, whose halves are added
+ * to the columns i+j and i+j+1. A column has at most 4*n summands below
+ * 2^32, so it doesn't overflow before the carries are propagated.
+**/
+#define DIGITS_32 (2*BIGNUM_SIMD_MAX_ELEMENTS)
+
+__attribute__((target("avx2")))
+static void add_avx2(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                     int *overflow, size_t n, size_t count, size_t j) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    // All ones in lanes with a carry.
+    __m256i carry = zero;
+
+    for (size_t i=0; i<n; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) &op1[i*count + j]);
+        __m256i b = _mm256_loadu_si256((const __m256i *) &op2[i*count + j]);
+        __m256i s = _mm256_add_epi64(a, b);
+        // AVX2 only compares signed numbers, flipping the sign bits
+        // gives the unsigned comparison s < a.
+        __m256i c = _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(s, sign));
+        s = _mm256_sub_epi64(s, carry);
+        carry = _mm256_or_si256(c, _mm256_and_si256(carry, _mm256_cmpeq_epi64(s, zero)));
+        _mm256_storeu_si256((__m256i *) &rop[i*count + j], s);
+    }
+
+    if (overflow != NULL) {
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(carry));
+        for (int l=0; l<4; l++)
+            overflow[j + l] = (mask >> l) & 1;
+    }
+}
+
+__attribute__((target("avx2")))
+static void mul_avx2(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                     bignum_elem_t ui, int *overflow, size_t n, size_t count, size_t j) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask = _mm256_set1_epi64x(0xffffffff);
+    __m256i a[DIGITS_32], b[DIGITS_32], acc[DIGITS_32 + 1];
+    __m256i upper = zero, ovf = zero, carry = zero;
+    size_t d = 2*n, bn = 2;
+
+    for (size_t i=0; i<n; i++) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) &op1[i*count + j]);
+        a[2*i] = _mm256_and_si256(x, mask);
+        a[2*i + 1] = _mm256_srli_epi64(x, 32);
+    }
+    if (op2 != NULL) {
+        for (size_t i=0; i<n; i++) {
+            __m256i x = _mm256_loadu_si256((const __m256i *) &op2[i*count + j]);
+            b[2*i] = _mm256_and_si256(x, mask);
+            b[2*i + 1] = _mm256_srli_epi64(x, 32);
+        }
+        bn = d;
+    }
+    else {
+        b[0] = _mm256_set1_epi64x(ui & 0xffffffff);
+        b[1] = _mm256_set1_epi64x((unsigned long long) ui >> 32);
+    }
+
+    for (size_t k=0; k<=d; k++)
+        acc[k] = zero;
+
+    // Only the columns below d are kept, the carry into column d and
+    // the products of the columns above give the overflow.
+    for (size_t i=0; i<d; i++) {
+        for (size_t k=0; k<bn && i+k<d; k++) {
+            __m256i p = _mm256_mul_epu32(a[i], b[k]);
+            acc[i+k] = _mm256_add_epi64(acc[i+k], _mm256_and_si256(p, mask));
+            acc[i+k+1] = _mm256_add_epi64(acc[i+k+1], _mm256_srli_epi64(p, 32));
+        }
+        // The product of two digits is nonzero iff both are.
+        if (d-i < bn)
+            upper = _mm256_or_si256(upper, b[d-i]);
+        ovf = _mm256_or_si256(ovf, _mm256_mul_epu32(a[i], upper));
+    }
+
+    for (size_t k=0; k<d; k++) {
+        __m256i t = _mm256_add_epi64(acc[k], carry);
+        acc[k] = _mm256_and_si256(t, mask);
+        carry = _mm256_srli_epi64(t, 32);
+    }
+    ovf = _mm256_or_si256(ovf, _mm256_add_epi64(acc[d], carry));
+
+    for (size_t i=0; i<n; i++)
+        _mm256_storeu_si256((__m256i *) &rop[i*count + j],
+            _mm256_or_si256(acc[2*i], _mm256_slli_epi64(acc[2*i + 1], 32)));
+
+    if (overflow != NULL) {
+        int nonzero = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(ovf, zero)));
+        for (int l=0; l<4; l++)
+            overflow[j + l] = (nonzero >> l) & 1;
+    }
+}
+
+/*
+ * AVX-512, 8 numbers per vector:
+ *  - add_avx512()
+ *  - mul_avx512()
+ *  - mul_avx512ifma()
+ *
+ * mul_avx512() works like mul_avx2(). mul_avx512ifma() uses digits of
+ * 52 bits, _mm512_madd52lo_epu64() and _mm512_madd52hi_epu64() add the
+ * halves of the 104 bit products directly to the columns. A column has
+ * at most 2*DIGITS_52 summands below 2^52.
+**/
+#define DIGITS_52 ((64*BIGNUM_SIMD_MAX_ELEMENTS + 51) / 52)
+#define MASK_52 0xfffffffffffffULL
+
+static void store_overflow(int *overflow, __mmask8 mask, size_t j) {
+    if (overflow != NULL)
+        for (int l=0; l<8; l++)
+            overflow[j + l] = (mask >> l) & 1;
+}
+
+__attribute__((target("avx512f")))
+static void add_avx512(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                       int *overflow, size_t n, size_t count, size_t j) {
+    const __m512i one = _mm512_set1_epi64(1);
+    __mmask8 carry = 0;
+
+    for (size_t i=0; i<n; i++) {
+        __m512i a = _mm512_loadu_si512(&op1[i*count + j]);
+        __m512i b = _mm512_loadu_si512(&op2[i*count + j]);
+        __m512i s = _mm512_add_epi64(a, b);
+        __mmask8 c = _mm512_cmplt_epu64_mask(s, a);
+        s = _mm512_mask_add_epi64(s, carry, s, one);
+        carry = c | _mm512_mask_cmpeq_epu64_mask(carry, s, _mm512_setzero_si512());
+        _mm512_storeu_si512(&rop[i*count + j], s);
+    }
+    store_overflow(overflow, carry, j);
+}
+
+__attribute__((target("avx512f")))
+static void mul_avx512(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                       bignum_elem_t ui, int *overflow, size_t n, size_t count, size_t j) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i mask = _mm512_set1_epi64(0xffffffff);
+    __m512i a[DIGITS_32], b[DIGITS_32], acc[DIGITS_32 + 1];
+    __m512i upper = zero, carry = zero;
+    __mmask8 ovf = 0;
+    size_t d = 2*n, bn = 2;
+
+    for (size_t i=0; i<n; i++) {
+        __m512i x = _mm512_loadu_si512(&op1[i*count + j]);
+        a[2*i] = _mm512_and_si512(x, mask);
+        a[2*i + 1] = _mm512_srli_epi64(x, 32);
+    }
+    if (op2 != NULL) {
+        for (size_t i=0; i<n; i++) {
+            __m512i x = _mm512_loadu_si512(&op2[i*count + j]);
+            b[2*i] = _mm512_and_si512(x, mask);
+            b[2*i + 1] = _mm512_srli_epi64(x, 32);
+        }
+        bn = d;
+    }
+    else {
+        b[0] = _mm512_set1_epi64(ui & 0xffffffff);
+        b[1] = _mm512_set1_epi64((unsigned long long) ui >> 32);
+    }
+
+    for (size_t k=0; k<=d; k++)
+        acc[k] = zero;
+
+    for (size_t i=0; i<d; i++) {
+        for (size_t k=0; k<bn && i+k<d; k++) {
+            __m512i p = _mm512_mul_epu32(a[i], b[k]);
+            acc[i+k] = _mm512_add_epi64(acc[i+k], _mm512_and_si512(p, mask));
+            acc[i+k+1] = _mm512_add_epi64(acc[i+k+1], _mm512_srli_epi64(p, 32));
+        }
+        if (d-i < bn)
+            upper = _mm512_or_si512(upper, b[d-i]);
+        ovf |= _mm512_test_epi64_mask(a[i], a[i]) & _mm512_test_epi64_mask(upper, upper);
+    }
+
+    for (size_t k=0; k<d; k++) {
+        __m512i t = _mm512_add_epi64(acc[k], carry);
+        acc[k] = _mm512_and_si512(t, mask);
+        carry = _mm512_srli_epi64(t, 32);
+    }
+    carry = _mm512_add_epi64(acc[d], carry);
+    ovf |= _mm512_test_epi64_mask(carry, carry);
+
+    for (size_t i=0; i<n; i++)
+        _mm512_storeu_si512(&rop[i*count + j],
+            _mm512_or_si512(acc[2*i], _mm512_slli_epi64(acc[2*i + 1], 32)));
+    store_overflow(overflow, ovf, j);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i shift_right(__m512i x, size_t s) {
+    // x >> s, which is zero for s >= 64.
+    return _mm512_srl_epi64(x, _mm_cvtsi64_si128((long long) s));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i shift_left(__m512i x, size_t s) {
+    // x << s, which is zero for s >= 64.
+    return _mm512_sll_epi64(x, _mm_cvtsi64_si128((long long) s));
+}
+
+__attribute__((target("avx512f,avx512ifma")))
+static void mul_avx512ifma(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                           bignum_elem_t ui, int *overflow, size_t n, size_t count, size_t j) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i mask = _mm512_set1_epi64(MASK_52);
+    __m512i x[BIGNUM_SIMD_MAX_ELEMENTS + 1];
+    __m512i a[DIGITS_52], b[DIGITS_52], acc[DIGITS_52 + 1];
+    __m512i upper = zero, carry = zero;
+    __mmask8 ovf = 0;
+    // d digits hold the 64*n bits of the result, the top digit only
+    // the lowest top bits.
+    size_t d = (64*n + 51) / 52, top = 64*n - 52*(d - 1), bn = 2;
+
+    // Digit k consists of the bits 52*k to 52*k+51, which start at bit
+    // s of element i and may continue in element i+1.
+    x[n] = zero;
+    for (size_t i=0; i<n; i++)
+        x[i] = _mm512_loadu_si512(&op1[i*count + j]);
+    for (size_t k=0, i, s; k<d; k++) {
+        i = 52*k / 64;
+        s = 52*k % 64;
+        a[k] = _mm512_and_si512(mask, _mm512_or_si512(shift_right(x[i], s),
+                                                      shift_left(x[i+1], 64 - s)));
+    }
+    if (op2 != NULL) {
+        for (size_t i=0; i<n; i++)
+            x[i] = _mm512_loadu_si512(&op2[i*count + j]);
+        for (size_t k=0, i, s; k<d; k++) {
+            i = 52*k / 64;
+            s = 52*k % 64;
+            b[k] = _mm512_and_si512(mask, _mm512_or_si512(shift_right(x[i], s),
+                                                          shift_left(x[i+1], 64 - s)));
+        }
+        bn = d;
+    }
+    else {
+        b[0] = _mm512_set1_epi64(ui & MASK_52);
+        b[1] = _mm512_set1_epi64((unsigned long long) ui >> 52);
+    }
+
+    for (size_t k=0; k<=d; k++)
+        acc[k] = zero;
+
+    for (size_t i=0; i<d; i++) {
+        for (size_t k=0; k<bn && i+k<d; k++) {
+            acc[i+k] = _mm512_madd52lo_epu64(acc[i+k], a[i], b[k]);
+            acc[i+k+1] = _mm512_madd52hi_epu64(acc[i+k+1], a[i], b[k]);
+        }
+        if (d-i < bn)
+            upper = _mm512_or_si512(upper, b[d-i]);
+        ovf |= _mm512_test_epi64_mask(a[i], a[i]) & _mm512_test_epi64_mask(upper, upper);
+    }
+
+    for (size_t k=0; k<d; k++) {
+        __m512i t = _mm512_add_epi64(acc[k], carry);
+        acc[k] = _mm512_and_si512(t, mask);
+        carry = _mm512_srli_epi64(t, 52);
+    }
+    carry = _mm512_or_si512(_mm512_add_epi64(acc[d], carry), shift_right(acc[d-1], top));
+    ovf |= _mm512_test_epi64_mask(carry, carry);
+
+    // Element i consists of the bits 64*i to 64*i+63, which start at
+    // bit s of digit k and continue in the digits k+1 and k+2. The bits
+    // of the top digit above the result are shifted out of element n-1.
+    acc[d] = zero;
+    for (size_t i=0, k, s; i<n; i++) {
+        k = 64*i / 52;
+        s = 64*i % 52;
+        __m512i y = _mm512_or_si512(shift_right(acc[k], s), shift_left(acc[k+1], 52 - s));
+        if (k+2 < d)
+            y = _mm512_or_si512(y, shift_left(acc[k+2], 104 - s));
+        _mm512_storeu_si512(&rop[i*count + j], y);
+    }
+    store_overflow(overflow, ovf, j);
+}
+
+static int isa_supported(bignum_simd_isa_t isa) {
+    if (BIGNUM_ELEM_SIZE != 8)
+        return isa == BIGNUM_SIMD_SCALAR;
+
+    __builtin_cpu_init();
+    switch (isa) {
+    case BIGNUM_SIMD_SCALAR:
+        return 1;
+    case BIGNUM_SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case BIGNUM_SIMD_AVX512F:
+        return __builtin_cpu_supports("avx512f");
+    case BIGNUM_SIMD_AVX512IFMA:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+    default:
+        return 0;
+    }
+}
+#else
+static int isa_supported(bignum_simd_isa_t isa) {
+    return isa == BIGNUM_SIMD_SCALAR;
+}
+#endif
+
+/*
+ * Dispatching:
+ *  - bignum_simd_select(), bignum_simd_selected()
+ *  - simd_run()
+**/
+int bignum_simd_select(bignum_simd_isa_t isa) {
+    if (isa != BIGNUM_SIMD_AUTO && !isa_supported(isa))
+        return -1;
+    selected = isa;
+    return 0;
+}
+
+bignum_simd_isa_t bignum_simd_selected(void) {
+    if (selected != BIGNUM_SIMD_AUTO)
+        return selected;
+    for (bignum_simd_isa_t isa = BIGNUM_SIMD_AVX512IFMA; isa > BIGNUM_SIMD_SCALAR; isa--)
+        if (isa_supported(isa))
+            return isa;
+    return BIGNUM_SIMD_SCALAR;
+}
+
+static int simd_run(enum simd_op op, bignum_elem_t *rop, const bignum_elem_t *op1,
+                    const bignum_elem_t *op2, bignum_elem_t ui, int *overflow,
+                    size_t n, size_t count) {
+    // Calculate full vectors with the selected instruction set and the
+    // numbers left over with scalar_op().
+    bignum_simd_isa_t isa = n > 0 ? bignum_simd_selected() : BIGNUM_SIMD_SCALAR;
+    size_t j = 0;
+
+    if (n > BIGNUM_SIMD_MAX_ELEMENTS)
+        return -1;
+
+#ifdef BIGNUM_SIMD_X86
+    if (isa == BIGNUM_SIMD_AVX2) {
+        for (; j+4 <= count; j+=4) {
+            if (op == OP_ADD)
+                add_avx2(rop, op1, op2, overflow, n, count, j);
+            else
+                mul_avx2(rop, op1, op2, ui, overflow, n, count, j);
+        }
+    }
+    else if (isa != BIGNUM_SIMD_SCALAR) {
+        for (; j+8 <= count; j+=8) {
+            if (op == OP_ADD)
+                add_avx512(rop, op1, op2, overflow, n, count, j);
+            else if (isa == BIGNUM_SIMD_AVX512IFMA)
+                mul_avx512ifma(rop, op1, op2, ui, overflow, n, count, j);
+            else
+                mul_avx512(rop, op1, op2, ui, overflow, n, count, j);
+        }
+    }
+#else
+    (void) isa;
+#endif
+
+    for (; j<count; j++)
+        scalar_op(op, rop, op1, op2, ui, overflow, n, count, j);
+    return 0;
+}
+
+/*
+ * Batch operations:
+ *  - bignum_simd_add()
+ *  - bignum_simd_mul_ui()
+ *  - bignum_simd_mul()
+**/
+int bignum_simd_add(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                    int *overflow, size_t num_elements, size_t count) {
+    return simd_run(OP_ADD, rop, op1, op2, 0, overflow, num_elements, count);
+}
+
+int bignum_simd_mul_ui(bignum_elem_t *rop, const bignum_elem_t *op1, bignum_elem_t op2,
+                       int *overflow, size_t num_elements, size_t count) {
+    return simd_run(OP_MUL_UI, rop, op1, NULL, op2, overflow, num_elements, count);
+}
+
+int bignum_simd_mul(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                    int *overflow, size_t num_elements, size_t count) {
+    return simd_run(OP_MUL, rop, op1, op2, 0, overflow, num_elements, count);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file
+ * @brief SIMD batch operations on interleaved batches on the host.
+ *
+ * Like the OpenCL kernels, which calculate one number per work-item,
+ * these functions calculate one number per SIMD lane: Element i of the
+ * numbers j to j+7 is stored at batch[i*count + j] to batch[i*count + j+7]
+ * in an interleaved batch (see bignum_load_interleaved()), so a vector
+ * load reads the same element of 4 (AVX2) or 8 (AVX-512) numbers and
+ * every lane has its own carry chain.
+ *
+ * The products are calculated in digits of 32 bits (AVX2, AVX-512F),
+ * whose products fit into the 64 bit lanes, or 52 bits with the
+ * multiply-add instructions of AVX-512 IFMA. The columns of a product
+ * are summed without carries, which are propagated once at the end.
+ *
+ * The instruction set is chosen at runtime from the features of the CPU.
+ * Numbers which don't fill a vector at the end of a batch and machines
+ * without these instruction sets use the scalar functions of bignum.h.
+ *
+ * This is host-only code, the SIMD variants need GCC or Clang on x86-64
+ * and BIGNUM_ELEM_SIZE = 8.
+**/
+#ifndef __BIGNUM_SIMD_H
+#define __BIGNUM_SIMD_H
+
+#include "bignum.h"
+
+/**
+ * @brief The maximum number of elements of the numbers.
+ */
+#define BIGNUM_SIMD_MAX_ELEMENTS BIGNUM_4096
+
+/**
+ * @brief Instruction sets of the SIMD functions.
+ */
+typedef enum bignum_simd_isa {
+    BIGNUM_SIMD_AUTO = -1,
+    BIGNUM_SIMD_SCALAR = 0,
+    BIGNUM_SIMD_AVX2,
+    BIGNUM_SIMD_AVX512F,
+    BIGNUM_SIMD_AVX512IFMA
+} bignum_simd_isa_t;
+
+/**
+ * @brief Choose the instruction set of the SIMD functions.
+ *
+ * By default (BIGNUM_SIMD_AUTO) the best one supported by the CPU is
+ * used. This is a global setting, don't change it while SIMD functions
+ * are running.
+ *
+ * @Returns 0 on success and -1 if the CPU or the compiler doesn't
+ *          support isa.
+**/
+int bignum_simd_select(bignum_simd_isa_t isa);
+
+/**
+ * @brief The instruction set used by the SIMD functions.
+**/
+bignum_simd_isa_t bignum_simd_selected(void);
+
+/**
+ * @brief rop[j] = op1[j] + op2[j] for all numbers of interleaved batches.
+ *
+ * overflow[j] is set to the return value of bignum_add(), overflow may
+ * be NULL. rop may be op1 or op2.
+ *
+ * @Returns 0 on success and -1 if num_elements is larger than
+ *          BIGNUM_SIMD_MAX_ELEMENTS.
+**/
+int bignum_simd_add(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                    int *overflow, size_t num_elements, size_t count);
+
+/**
+ * @brief rop[j] = op1[j] * op2 (truncated) for all numbers of an
+ *        interleaved batch.
+ *
+ * overflow[j] is set to the return value of bignum_mul_ui(), overflow
+ * may be NULL. rop may be op1.
+ *
+ * @Returns 0 on success and -1 if num_elements is larger than
+ *          BIGNUM_SIMD_MAX_ELEMENTS.
+**/
+int bignum_simd_mul_ui(bignum_elem_t *rop, const bignum_elem_t *op1, bignum_elem_t op2,
+                       int *overflow, size_t num_elements, size_t count);
+
+/**
+ * @brief rop[j] = op1[j] * op2[j] (truncated) for all numbers of
+ *        interleaved batches.
+ *
+ * overflow[j] is set to the return value of bignum_mul(), overflow may
+ * be NULL. rop may be op1 or op2.
+ *
+ * @Returns 0 on success and -1 if num_elements is larger than
+ *          BIGNUM_SIMD_MAX_ELEMENTS.
+**/
+int bignum_simd_mul(bignum_elem_t *rop, const bignum_elem_t *op1, const bignum_elem_t *op2,
+                    int *overflow, size_t num_elements, size_t count);
+
+#endif // __BIGNUM_SIMD_H
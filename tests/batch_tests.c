@@ -0,0 +1,319 @@
+/**
+ * @file
+ * @brief Tests of bignum_batch.h and bignum_simd.h, which only run on the host.
+ *
+ * These are appended to the tests of tests.c by `make batch_tests` and
+ * use its helper functions. Tests of bignum.h whose numbers are too
+ * large for the private memory of an OpenCL work-item live here too.
+**/
+#include "bignum_batch.h"
+#include "bignum_simd.h"
+
+/**
+ * @brief Large moduli use Newton's iteration for mu and full products,
+ *        which give the same results as division.
+**/
+int test_mod_barrett_large() {
+    const size_t k = BIGNUM_BARRETT_THRESHOLD;
+    bignum_t m, a, e, q, x, y;
+    bignum_barrett_ctx_t ctx;
+    bignum_elem_t m_elem[BIGNUM_BARRETT_THRESHOLD];
+    bignum_elem_t a_elem[2*BIGNUM_BARRETT_THRESHOLD];
+    bignum_elem_t e_elem[2*BIGNUM_BARRETT_THRESHOLD + 1];
+    bignum_elem_t q_elem[BIGNUM_BARRETT_THRESHOLD + 2];
+    bignum_elem_t x_elem[BIGNUM_BARRETT_THRESHOLD];
+    bignum_elem_t y_elem[BIGNUM_BARRETT_THRESHOLD];
+    bignum_elem_t mu_elem[BIGNUM_BARRETT_THRESHOLD + 2];
+    bignum_elem_t scratch[BIGNUM_BARRETT_SCRATCH(BIGNUM_BARRETT_THRESHOLD)];
+
+    bignum_elem_t seed = 98765;
+    for (size_t i=0; i<2*k; i++) {
+        seed = seed * 1103515245 + 12345;
+        a_elem[i] = i % 5 == 0 ? BIGNUM_ELEM_MAX : seed;
+        if (i < k)
+            m_elem[i] = seed ^ (seed >> 3);
+    }
+    // Not normalized, so the shifts are tested too.
+    m_elem[k-1] = 3;
+    for (size_t i=0; i<2*k; i++)
+        e_elem[i] = 0;
+    e_elem[2*k] = 1;
+
+    bignum_assoc(&m, m_elem, k);
+    bignum_assoc(&a, a_elem, 2*k);
+    bignum_assoc(&e, e_elem, 2*k + 1);
+    bignum_assoc(&q, q_elem, k + 2);
+    bignum_assoc(&x, x_elem, k);
+    bignum_assoc(&y, y_elem, k);
+
+    int ret = bignum_barrett_init(&ctx, &m, mu_elem, scratch) == 0;
+    bignum_divmod(&q, &y, &e, &m, scratch);
+    ret = ret && assert_equal_bignum(&ctx.mu, &q);
+
+    ret = ret && assert_equal_int(bignum_mod_barrett(&x, &a, &ctx, scratch), 0);
+    bignum_mod(&y, &a, &m, scratch);
+    return ret && assert_equal_bignum(&x, &y);
+}
+
+static void count_chunk(size_t begin, size_t end, bignum_elem_t *scratch, void *arg) {
+    // Count how often every index is passed.
+    bignum_elem_t *seen = arg;
+    for (size_t i=begin; i<end; i++)
+        __atomic_fetch_add(&seen[i], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Every index of a batch is passed to the function exactly once,
+ *        regardless of the number of threads and the chunk size.
+**/
+int test_batch_run_covers_all() {
+    bignum_elem_t seen[1000];
+    bignum_batch_opts_t opts = {0};
+    int ret = 1;
+
+    for (unsigned int threads=1; threads<=8; threads*=2) {
+        for (size_t chunk=1; chunk<=64; chunk*=4) {
+            for (size_t i=0; i<1000; i++)
+                seen[i] = 0;
+            opts.threads = threads;
+            opts.chunk = chunk;
+
+            ret = ret && assert_equal_int(bignum_batch_run(&opts, 1000, count_chunk, seen, 0), 0);
+            for (size_t i=0; i<1000; i++)
+                ret = ret && assert_equal_elem(seen[i], 1);
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief The batch operations give the same results as the single
+ *        number functions.
+**/
+int test_batch_ops() {
+    const size_t n = BIGNUM_512;
+    const size_t count = 333;
+    bignum_batch_opts_t opts = {.threads = 4, .chunk = 7};
+    bignum_elem_t *a = bignum_batch_alloc(&opts, n, count);
+    bignum_elem_t *b = bignum_batch_alloc(&opts, n, count);
+    bignum_elem_t *r = bignum_batch_alloc(&opts, n, count);
+    bignum_elem_t rem[333], x_elem[BIGNUM_512];
+    int overflow[333];
+    bignum_t x, y, z;
+    int ret = 1;
+
+    if (a == NULL || b == NULL || r == NULL)
+        return 0;
+
+    // Numbers of different lengths, so the threads have uneven work.
+    for (size_t i=0; i<count; i++) {
+        for (size_t j=0; j < i % n + 1; j++) {
+            a[i*n + j] = i * 0x9e3779b97f4a7c15 + j;
+            b[i*n + j] = BIGNUM_ELEM_MAX - i - j;
+        }
+    }
+
+    ret = ret && assert_equal_int(bignum_batch_mul(&opts, r, a, b, overflow, n, count), 0);
+    for (size_t i=0; i<count && ret; i++) {
+        bignum_assoc_at(&x, a, n, i);
+        bignum_assoc_at(&y, b, n, i);
+        bignum_assoc(&z, x_elem, n);
+        ret = assert_equal_int(overflow[i], bignum_mul(&z, &x, &y));
+        bignum_assoc_at(&x, r, n, i);
+        ret = ret && assert_equal_bignum(&x, &z);
+    }
+
+    ret = ret && assert_equal_int(bignum_batch_add(&opts, r, r, a, NULL, n, count), 0);
+    ret = ret && assert_equal_int(bignum_batch_mod_ui(&opts, rem, r, 1000003, n, count), 0);
+    for (size_t i=0; i<count && ret; i++) {
+        bignum_assoc_at(&x, r, n, i);
+        ret = assert_equal_elem(rem[i], bignum_mod_ui(&x, 1000003));
+    }
+
+    bignum_elem_t moduli[100];
+    bignum_elem_t *rems = bignum_batch_alloc(&opts, 100, count);
+    for (size_t j=0; j<100; j++)
+        moduli[j] = 2*j + 3;
+    ret = ret && rems != NULL;
+    ret = ret && assert_equal_int(bignum_batch_mod_ui_multi(&opts, rems, r, moduli, 100, n, count), 0);
+    for (size_t i=0; i<count && ret; i++) {
+        bignum_assoc_at(&x, r, n, i);
+        for (size_t j=0; j<100 && ret; j++)
+            ret = assert_equal_elem(rems[i*100 + j], bignum_mod_ui(&x, moduli[j]));
+    }
+    moduli[99] = 0;
+    ret = ret && assert_equal_int(bignum_batch_mod_ui_multi(&opts, rems, r, moduli, 100, n, count), -1);
+    bignum_batch_free(rems);
+
+    ret = ret && assert_equal_int(bignum_batch_divmod_ui(&opts, r, NULL, r, 1000003, n, count), 0);
+    ret = ret && assert_equal_int(bignum_batch_mod_ui(&opts, rem, r, 0, n, count), -1);
+
+    bignum_batch_free(a);
+    bignum_batch_free(b);
+    bignum_batch_free(r);
+    return ret;
+}
+
+static void fill_simd_operand(bignum_elem_t *batch, size_t n, size_t count, unsigned long long seed) {
+    // Random interleaved numbers of all lengths, some of them with all
+    // bits set to produce long carry chains.
+    unsigned long long state = seed;
+    for (size_t j=0; j<count; j++) {
+        size_t length = j % (n + 1);
+        for (size_t i=0; i<n; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            if (i >= length)
+                batch[i*count + j] = 0;
+            else if (j % 5 == 0)
+                batch[i*count + j] = BIGNUM_ELEM_MAX;
+            else
+                batch[i*count + j] = state;
+        }
+    }
+}
+
+/**
+ * @brief Every instruction set supported by the CPU gives the results
+ *        of bignum_add(), bignum_mul_ui() and bignum_mul().
+**/
+int test_simd_ops() {
+    static const size_t sizes[] = {1, 2, 3, BIGNUM_512, BIGNUM_2048 + 1, BIGNUM_4096};
+    static const bignum_elem_t factors[] = {0, 3, BIGNUM_ELEM_MAX, (bignum_elem_t) 0xfedcba9876543210};
+    const size_t count = 21;
+    static bignum_elem_t a[BIGNUM_4096*21], b[BIGNUM_4096*21], r[BIGNUM_4096*21];
+    bignum_elem_t x_elem[BIGNUM_4096], y_elem[BIGNUM_4096], z_elem[BIGNUM_4096];
+    bignum_elem_t r_elem[BIGNUM_4096];
+    int overflow[21];
+    bignum_t x, y, z, s;
+    int ret = 1;
+
+    for (bignum_simd_isa_t isa = BIGNUM_SIMD_SCALAR; isa <= BIGNUM_SIMD_AVX512IFMA; isa++) {
+        if (bignum_simd_select(isa) != 0)
+            continue;
+
+        for (size_t t=0; t < sizeof(sizes) / sizeof(sizes[0]) && ret; t++) {
+            size_t n = sizes[t];
+            fill_simd_operand(a, n, count, 88172645463325252ULL + t);
+            fill_simd_operand(b, n, count, 1234567 + t);
+
+            ret = ret && assert_equal_int(bignum_simd_add(r, a, b, overflow, n, count), 0);
+            for (size_t j=0; j<count && ret; j++) {
+                bignum_load_interleaved(&x, x_elem, a, n, count, j);
+                bignum_load_interleaved(&y, y_elem, b, n, count, j);
+                bignum_load_interleaved(&s, r_elem, r, n, count, j);
+                bignum_assoc_len(&z, z_elem, n, 0);
+                ret = assert_equal_int(overflow[j], bignum_add(&z, &x, &y));
+                ret = ret && assert_equal_bignum(&s, &z);
+            }
+
+            for (size_t f=0; f < sizeof(factors) / sizeof(factors[0]); f++) {
+                ret = ret && assert_equal_int(bignum_simd_mul_ui(r, a, factors[f], overflow, n, count), 0);
+                for (size_t j=0; j<count && ret; j++) {
+                    bignum_load_interleaved(&x, x_elem, a, n, count, j);
+                    bignum_load_interleaved(&s, r_elem, r, n, count, j);
+                    bignum_assoc_len(&z, z_elem, n, 0);
+                    ret = assert_equal_int(overflow[j], bignum_mul_ui(&z, &x, factors[f]));
+                    ret = ret && assert_equal_bignum(&s, &z);
+                }
+            }
+
+            // rop may be an operand.
+            ret = ret && assert_equal_int(bignum_simd_mul(r, a, b, overflow, n, count), 0);
+            ret = ret && assert_equal_int(bignum_simd_mul(a, a, b, NULL, n, count), 0);
+            for (size_t j=0; j<count && ret; j++) {
+                bignum_load_interleaved(&x, x_elem, a, n, count, j);
+                bignum_load_interleaved(&s, r_elem, r, n, count, j);
+                ret = assert_equal_bignum(&s, &x);
+            }
+            fill_simd_operand(a, n, count, 88172645463325252ULL + t);
+            for (size_t j=0; j<count && ret; j++) {
+                bignum_load_interleaved(&x, x_elem, a, n, count, j);
+                bignum_load_interleaved(&y, y_elem, b, n, count, j);
+                bignum_load_interleaved(&s, r_elem, r, n, count, j);
+                bignum_assoc_len(&z, z_elem, n, 0);
+                ret = assert_equal_int(overflow[j], bignum_mul(&z, &x, &y));
+                ret = ret && assert_equal_bignum(&s, &z);
+            }
+        }
+    }
+
+    ret = ret && assert_equal_int(bignum_simd_add(r, a, b, NULL, BIGNUM_4096 + 1, 1), -1);
+    bignum_simd_select(BIGNUM_SIMD_AUTO);
+    return ret;
+}
+
+/**
+ * @brief Batch GCD finds the factors shared with other moduli, also
+ *        with the product tree on disk and rop = moduli.
+**/
+int test_batch_gcd() {
+    const size_t n = BIGNUM_512;
+    const size_t count = 37;
+    bignum_batch_opts_t opts = {.threads = 3};
+    bignum_elem_t moduli[37 * BIGNUM_512], rop[37 * BIGNUM_512], copy[37 * BIGNUM_512];
+    bignum_elem_t f_elem[37][BIGNUM_512 / 2], g_elem[BIGNUM_512 / 2];
+    bignum_elem_t x_elem[BIGNUM_512], y_elem[2*BIGNUM_512], z_elem[BIGNUM_512];
+    bignum_elem_t scratch[BIGNUM_MUL_SCRATCH(BIGNUM_512) + BIGNUM_GCD_SCRATCH(BIGNUM_512)];
+    bignum_t f, g, m, x, y, z;
+    int ret = 1;
+
+    // Products of two odd factors, some of them shared, one modulus
+    // used twice and one modulus 1.
+    bignum_elem_t seed = 4242;
+    for (size_t i=0; i<count; i++) {
+        for (size_t j=0; j < n/2; j++) {
+            seed = seed * 1103515245 + 12345;
+            f_elem[i][j] = seed;
+            seed = seed * 1103515245 + 12345;
+            g_elem[j] = seed;
+        }
+        f_elem[i][0] |= 1;
+        g_elem[0] |= 1;
+        bignum_assoc(&f, i % 7 == 3 ? f_elem[i-3] : f_elem[i], n/2);
+        bignum_assoc(&g, g_elem, n/2);
+        bignum_assoc_at_len(&m, moduli, n, i, 0);
+        bignum_mul_scratch(&m, &f, &g, scratch);
+        bignum_write(&m);
+    }
+    for (size_t j=0; j<n; j++) {
+        moduli[20*n + j] = moduli[11*n + j];
+        moduli[30*n + j] = j == 0;
+    }
+
+    for (int variant=0; variant<3 && ret; variant++) {
+        for (size_t i=0; i < count*n; i++)
+            copy[i] = moduli[i];
+        bignum_elem_t *out = variant == 2 ? copy : rop;
+        ret = assert_equal_int(bignum_batch_gcd(&opts, out, copy, n, count,
+                                                variant == 1 ? "/tmp" : NULL), 0);
+
+        // gcd(N_i, product of the others mod N_i)
+        for (size_t i=0; i<count && ret; i++) {
+            bignum_assoc_at(&m, moduli, n, i);
+            bignum_assoc(&x, x_elem, n);
+            bignum_set_ui(&x, 1);
+            for (size_t j=0; j<count; j++) {
+                if (j == i)
+                    continue;
+                bignum_assoc_at(&z, moduli, n, j);
+                bignum_assoc(&y, y_elem, 2*n);
+                bignum_mul_scratch(&y, &x, &z, scratch);
+                bignum_mod(&x, &y, &m, scratch);
+            }
+            bignum_assoc(&z, z_elem, n);
+            bignum_gcd(&z, &x, &m, scratch);
+            bignum_assoc_at(&x, out, n, i);
+            ret = assert_equal_bignum(&x, &z);
+        }
+    }
+
+    // Zero moduli are rejected, a single modulus shares nothing.
+    for (size_t j=0; j<n; j++)
+        copy[5*n + j] = 0;
+    ret = ret && assert_equal_int(bignum_batch_gcd(&opts, rop, copy, n, count, NULL), -1);
+    ret = ret && assert_equal_int(bignum_batch_gcd(NULL, rop, moduli, n, 1, NULL), 0);
+    bignum_assoc(&x, rop, n);
+    return ret && assert_equal_int(bignum_cmp_ui(&x, 1), 0);
+}
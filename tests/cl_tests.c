@@ -8,7 +8,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <CL/cl.h>
+#include "bignum_cl.h"
 
 #include "tests_info.c.tmp" // kernel_names, etc.
 
@@ -69,42 +69,16 @@ int main() {
     if (ret != CL_SUCCESS)
         exit_with_error(ret, "clCreateContext() failed.");
 
-    size_t source_length = strlen(testsource);
-    cl_program program = clCreateProgramWithSource(
-        context, 1, (const char**) &testsource, &source_length, &ret);
-    if (ret != CL_SUCCESS)
-        exit_with_error(ret, "clCreateProgramWithSource() failed");
-
     /*
-     *  Build program and check for errors.
+     *  Build program, the binary is cached in $BIGNUM_CL_CACHE if set.
      */
-    ret = clBuildProgram(program, 1, &device_id,
-        "-I \"src/\" -I \"tests\"", NULL, NULL);
-
-    // Get build info, no matter if the compile was successful or not:
-    size_t length;
-    cl_int errorcode2;
-
-    int info_ret = clGetProgramBuildInfo(program, device_id,
-        CL_PROGRAM_BUILD_LOG, 0, NULL, &length);
-    if (info_ret != CL_SUCCESS)
-        exit_with_error(info_ret, "clGetProgramBuildInfo() (fetch length) failed.");
-
-    char *log = malloc(sizeof(char) * length);
-    if (log == NULL)
-        exit_with_error(1, "Couldn't allocate memory for build log.");
-
-    info_ret  = clGetProgramBuildInfo(program, device_id,
-        CL_PROGRAM_BUILD_LOG, length, log, NULL);
-    if (info_ret != CL_SUCCESS)
-        exit_with_error(info_ret, "clGetProgramBuildInfo() (fetch log) failed.");
-
-    // Print log and free memory.
-    printf("Build log:\n%s\n", log);
-    free(log);
-
-    if (ret != CL_SUCCESS)
-        exit_with_error(ret, "clBuildProgram() failed.");
+    const char *files[] = {
+        "src/bignum.c", "src/bignum.h", "tests/tests.c", "tests/tests_wrappers.cl.tmp", NULL
+    };
+    cl_program program = bignum_cl_build(context, device_id, testsource,
+        "-I \"src/\" -I \"tests\"", files, getenv("BIGNUM_CL_CACHE"), &ret);
+    if (program == NULL)
+        exit_with_error(ret, "Building the program failed.");
 
     cl_command_queue queue = clCreateCommandQueue(context, device_id, 0, &ret);
     if (ret != CL_SUCCESS)
@@ -42,6 +42,25 @@ int assert_equal_elem(bignum_elem_t actual, bignum_elem_t expected) {
     return ret == 1;
 }
 
+int assert_equal_str(const char *actual, const char *expected) {
+    int i = 0;
+    while (actual[i] != '\0' && actual[i] == expected[i])
+        i++;
+    int ret = actual[i] == expected[i];
+    if (ret != 1) {
+        // OpenCL C can't print strings with %s, which aren't literals.
+        printf(" * assert_equal_str() failed at index %d:\n", i);
+        printf(" * Actual  : ");
+        for (int j=0; actual[j] != '\0'; j++)
+            printf("%c", actual[j]);
+        printf("\n * Expected: ");
+        for (int j=0; expected[j] != '\0'; j++)
+            printf("%c", expected[j]);
+        printf("\n");
+    }
+    return ret == 1;
+}
+
 // All tests return 1 for success and 0 for failure.
 
 /**
@@ -151,6 +170,10 @@ int test_zero_data() {
     bignum_elem_t data[4] = {1, 2, 3, 4};
     bignum_assoc(&x, data, 3);
     bignum_zero(&x);
+#ifdef BIGNUM_LAZY_ZERO
+    // The memory is only zeroed when it is written.
+    bignum_write(&x);
+#endif
     return data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 4;
 }
 
@@ -165,6 +188,10 @@ int test_zero_data_wrong_length() {
     bignum_assoc(&x, data, 3);
     x.length = 1;
     bignum_zero(&x);
+#ifdef BIGNUM_LAZY_ZERO
+    // The memory is only zeroed when it is written.
+    bignum_write(&x);
+#endif
     return data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 4;
 }
 
@@ -407,3 +434,1299 @@ int test_divmod_ui_carry() {
     return assert_equal_bignum(&x, &c) &&
            assert_equal_elem(y, r);
 }
+
+/**
+ * @brief Karatsuba multiplication yields the same result as
+ *        schoolbook multiplication.
+**/
+int test_mul_karatsuba() {
+    bignum_t a, b, x, y;
+    bignum_elem_t a_elem[BIGNUM_2048];
+    bignum_elem_t b_elem[BIGNUM_2048];
+    bignum_elem_t x_elem[BIGNUM_4096];
+    bignum_elem_t y_elem[BIGNUM_4096];
+    bignum_elem_t scratch[BIGNUM_MUL_SCRATCH(BIGNUM_2048)];
+
+    bignum_elem_t seed = 12345;
+    for (int i=0; i<BIGNUM_2048; i++) {
+        seed = seed * 1103515245 + 12345;
+        a_elem[i] = seed;
+        seed = seed * 1103515245 + 12345;
+        b_elem[i] = i % 5 == 0 ? BIGNUM_ELEM_MAX : seed;
+    }
+
+    bignum_assoc(&a, a_elem, BIGNUM_2048);
+    bignum_assoc(&b, b_elem, BIGNUM_2048 - 3);
+    bignum_assoc(&x, x_elem, BIGNUM_4096);
+    bignum_assoc(&y, y_elem, BIGNUM_4096);
+
+    int ret1 = bignum_mul_scratch(&x, &a, &b, scratch);
+    int ret2 = bignum_mul_scratch(&y, &a, &b, NULL);
+    return assert_equal_bignum(&x, &y) &&
+           assert_equal_int(ret1, 0) &&
+           assert_equal_int(ret2, 0);
+}
+
+/**
+ * @brief Karatsuba multiplication into a too small rop keeps the
+ *        lower elements and reports the overflow.
+**/
+int test_mul_karatsuba_overflow() {
+    bignum_t a, x, y;
+    bignum_elem_t a_elem[BIGNUM_2048];
+    bignum_elem_t x_elem[BIGNUM_2048];
+    bignum_elem_t y_elem[BIGNUM_2048];
+    bignum_elem_t scratch[BIGNUM_MUL_SCRATCH(BIGNUM_2048)];
+
+    for (int i=0; i<BIGNUM_2048; i++)
+        a_elem[i] = BIGNUM_ELEM_MAX - i;
+
+    bignum_assoc(&a, a_elem, BIGNUM_2048);
+    bignum_assoc(&x, x_elem, BIGNUM_2048);
+    bignum_assoc(&y, y_elem, BIGNUM_2048);
+
+    int ret1 = bignum_mul_scratch(&x, &a, &a, scratch);
+    int ret2 = bignum_mul_scratch(&y, &a, &a, NULL);
+    return assert_equal_bignum(&x, &y) &&
+           assert_equal_int(ret1, 1) &&
+           assert_equal_int(ret2, 1);
+}
+
+int test_mul_ui_carry_no_overflow() {
+    bignum_t a, c, x;
+    bignum_elem_t a_elem[4] = {BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX, 0, 0};
+    bignum_elem_t c_elem[4] = {BIGNUM_ELEM_MAX - 7, BIGNUM_ELEM_MAX, 7, 0};
+    bignum_elem_t x_elem[4];
+
+    bignum_assoc(&a, a_elem, 4);
+    bignum_assoc(&c, c_elem, 4);
+    bignum_assoc(&x, x_elem, 4);
+
+    int ret = bignum_mul_ui(&x, &a, 8);
+    return assert_equal_bignum(&x, &c) &&
+           assert_equal_int(ret, 0);
+}
+
+int test_mul_ui_overflow() {
+    bignum_t a, c, x;
+    bignum_elem_t a_elem[2] = {3, BIGNUM_ELEM_MAX};
+    bignum_elem_t c_elem[2] = {24, BIGNUM_ELEM_MAX - 7};
+    bignum_elem_t x_elem[2];
+
+    bignum_assoc(&a, a_elem, 2);
+    bignum_assoc(&c, c_elem, 2);
+    bignum_assoc(&x, x_elem, 2);
+
+    int ret = bignum_mul_ui(&x, &a, 8);
+    return assert_equal_bignum(&x, &c) &&
+           assert_equal_int(ret, 1);
+}
+
+/**
+ * @brief Montgomery arithmetic requires an odd modulus.
+**/
+int test_mont_init_even() {
+    bignum_t m;
+    bignum_mont_ctx_t ctx;
+    bignum_elem_t m_elem[2] = {10, 1};
+    bignum_elem_t r2_elem[2];
+
+    bignum_assoc(&m, m_elem, 2);
+    return assert_equal_int(bignum_mont_init(&ctx, &m, r2_elem), -1);
+}
+
+/**
+ * @brief R^2 mod m is the same by division and by modular doubling.
+**/
+int test_mont_init_scratch() {
+    bignum_t m;
+    bignum_mont_ctx_t ctx1, ctx2;
+    bignum_elem_t m_elem[3] = {BIGNUM_ELEM_MAX - 2, 5, 7};
+    bignum_elem_t r2_elem1[3];
+    bignum_elem_t r2_elem2[3];
+    bignum_elem_t scratch[BIGNUM_MONT_INIT_SCRATCH(3)];
+
+    bignum_assoc(&m, m_elem, 3);
+
+    int ret1 = bignum_mont_init_scratch(&ctx1, &m, r2_elem1, scratch);
+    int ret2 = bignum_mont_init_scratch(&ctx2, &m, r2_elem2, NULL);
+    return assert_equal_bignum(&ctx1.r2, &ctx2.r2) &&
+           assert_equal_int(ret1, 0) &&
+           assert_equal_int(ret2, 0);
+}
+
+/**
+ * @brief Multiplying in Montgomery form and converting back yields
+ *        op1 * op2 mod m.
+**/
+int test_mont_mul() {
+    // m = 2^(2w - 1) - 1 for w bits per element, so base^2 = 2 (mod m).
+    bignum_t m, a, b, c, x;
+    bignum_mont_ctx_t ctx;
+    bignum_elem_t m_elem[2] = {BIGNUM_ELEM_MAX, (bignum_elem_t) BIGNUM_ELEM_MAX >> 1};
+    bignum_elem_t a_elem[2] = {5, 7};
+    bignum_elem_t b_elem[2] = {11, 13};
+    bignum_elem_t c_elem[2] = {237, 142};
+    bignum_elem_t x_elem[2];
+    bignum_elem_t r2_elem[2];
+    bignum_elem_t scratch[BIGNUM_MONT_SCRATCH(2)];
+
+    bignum_assoc(&m, m_elem, 2);
+    bignum_assoc(&a, a_elem, 2);
+    bignum_assoc(&b, b_elem, 2);
+    bignum_assoc(&c, c_elem, 2);
+    bignum_assoc(&x, x_elem, 2);
+
+    bignum_mont_init(&ctx, &m, r2_elem);
+    bignum_mont_to(&a, &a, &ctx, scratch);
+    bignum_mont_to(&b, &b, &ctx, scratch);
+    bignum_mont_mul(&x, &a, &b, &ctx, scratch);
+    bignum_mont_from(&x, &x, &ctx, scratch);
+
+    return assert_equal_bignum(&x, &c);
+}
+
+int test_powm_small() {
+    bignum_t m, a, e, c, x;
+    bignum_mont_ctx_t ctx;
+    bignum_elem_t m_elem[1] = {251};
+    bignum_elem_t a_elem[1] = {3};
+    bignum_elem_t e_elem[1] = {200};
+    bignum_elem_t c_elem[1] = {149};
+    bignum_elem_t x_elem[1];
+    bignum_elem_t r2_elem[1];
+    bignum_elem_t scratch[BIGNUM_POWM_SCRATCH(1)];
+
+    bignum_assoc(&m, m_elem, 1);
+    bignum_assoc(&a, a_elem, 1);
+    bignum_assoc(&e, e_elem, 1);
+    bignum_assoc(&c, c_elem, 1);
+    bignum_assoc(&x, x_elem, 1);
+
+    bignum_mont_init(&ctx, &m, r2_elem);
+    int ret = bignum_powm(&x, &a, &e, &ctx, scratch);
+    return assert_equal_bignum(&x, &c) && assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief Fermat's little theorem holds for the prime 2^127 - 1.
+**/
+int test_powm_fermat() {
+    bignum_t m, a, e, x;
+    bignum_mont_ctx_t ctx;
+    bignum_elem_t m_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t a_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t e_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t x_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t r2_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t scratch[BIGNUM_POWM_SCRATCH(16 / BIGNUM_ELEM_SIZE)];
+    size_t n = 16 / BIGNUM_ELEM_SIZE;
+
+    // m = 2^127 - 1 and e = m - 1 on 128 bits of elements.
+    for (size_t i=0; i<n; i++) {
+        m_elem[i] = BIGNUM_ELEM_MAX;
+        e_elem[i] = BIGNUM_ELEM_MAX;
+        a_elem[i] = 0;
+    }
+    m_elem[n-1] = (bignum_elem_t) BIGNUM_ELEM_MAX >> 1;
+    e_elem[n-1] = (bignum_elem_t) BIGNUM_ELEM_MAX >> 1;
+    e_elem[0] = BIGNUM_ELEM_MAX - 1;
+    a_elem[0] = 3;
+
+    bignum_assoc(&m, m_elem, n);
+    bignum_assoc(&a, a_elem, n);
+    bignum_assoc(&e, e_elem, n);
+    bignum_assoc(&x, x_elem, n);
+
+    bignum_mont_init(&ctx, &m, r2_elem);
+    bignum_powm(&x, &a, &e, &ctx, scratch);
+    return assert_equal_int(bignum_cmp_ui(&x, 1), 0);
+}
+
+/*
+ * A dividend and a divisor with the highest bit set for the single
+ * element divisions. The results are checked by multiplying back, so
+ * the tests work with every element size.
+**/
+#define DIVMOD_UI_LARGE_A {15, 0, 3, BIGNUM_ELEM_MAX - 1}
+#define DIVMOD_UI_LARGE_D ((bignum_elem_t) BIGNUM_ELEM_MAX / 16 * 9)
+
+int assert_divmod_ui(bignum_t *a, bignum_t *q, bignum_elem_t d, bignum_elem_t r) {
+    // Check that a = q * d + r with r < d.
+    bignum_t x, y;
+    bignum_elem_t x_elem[8];
+    bignum_elem_t y_elem[1] = {r};
+
+    bignum_assoc(&x, x_elem, 8);
+    bignum_assoc(&y, y_elem, 1);
+    return assert_equal_int(r < d, 1) &&
+           assert_equal_int(bignum_mul_ui(&x, q, d), 0) &&
+           assert_equal_int(bignum_add(&x, &x, &y), 0) &&
+           assert_equal_bignum(&x, a);
+}
+
+/**
+ * @brief Dividing by a divisor close to the element base yields the
+ *        correct quotient and remainder.
+**/
+int test_divmod_ui_large_divisor() {
+    bignum_t a, x;
+
+    bignum_elem_t a_elem[4] = DIVMOD_UI_LARGE_A;
+    bignum_elem_t b = DIVMOD_UI_LARGE_D;
+    bignum_elem_t x_elem[4];
+
+    bignum_assoc(&a, a_elem, 4);
+    bignum_assoc(&x, x_elem, 4);
+
+    bignum_elem_t y = bignum_divmod_ui(&x, &a, b);
+
+    return assert_divmod_ui(&a, &x, b, y) &&
+           assert_equal_elem(bignum_mod_ui(&a, b), y);
+}
+
+int test_divmod() {
+    bignum_t n, d, q, r, x, y;
+    bignum_elem_t n_elem[5] = {1, 2, 3, 4, BIGNUM_ELEM_MAX};
+    bignum_elem_t d_elem[3] = {7, 9, BIGNUM_ELEM_MAX - 4};
+    bignum_elem_t q_elem[3] = {15, 4, 1};
+    bignum_elem_t r_elem[3] = {BIGNUM_ELEM_MAX - 103, BIGNUM_ELEM_MAX - 161, 34};
+    bignum_elem_t x_elem[4];
+    bignum_elem_t y_elem[4];
+    bignum_elem_t scratch[BIGNUM_DIVMOD_SCRATCH(5)];
+
+    bignum_assoc(&n, n_elem, 5);
+    bignum_assoc(&d, d_elem, 3);
+    bignum_assoc(&q, q_elem, 3);
+    bignum_assoc(&r, r_elem, 3);
+    bignum_assoc(&x, x_elem, 4);
+    bignum_assoc(&y, y_elem, 4);
+
+    int ret = bignum_divmod(&x, &y, &n, &d, scratch);
+    return assert_equal_bignum(&x, &q) &&
+           assert_equal_bignum(&y, &r) &&
+           assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief bignum_mod() doesn't need a quotient and may write the
+ *        remainder to the dividend.
+**/
+int test_mod_in_place() {
+    bignum_t n, d, r;
+    bignum_elem_t n_elem[5] = {1, 2, 3, 4, BIGNUM_ELEM_MAX};
+    bignum_elem_t d_elem[3] = {7, 9, BIGNUM_ELEM_MAX - 4};
+    bignum_elem_t r_elem[3] = {BIGNUM_ELEM_MAX - 103, BIGNUM_ELEM_MAX - 161, 34};
+    bignum_elem_t scratch[BIGNUM_DIVMOD_SCRATCH(5)];
+
+    bignum_assoc(&n, n_elem, 5);
+    bignum_assoc(&d, d_elem, 3);
+    bignum_assoc(&r, r_elem, 3);
+
+    int ret = bignum_mod(&n, &n, &d, scratch);
+    return assert_equal_bignum(&n, &r) &&
+           assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief A dividend shorter than the divisor is the remainder, even if
+ *        the quotient is written to the dividend.
+**/
+int test_divmod_short_in_place() {
+    bignum_t n, d, r, x;
+    bignum_elem_t n_elem[2] = {5, 6};
+    bignum_elem_t d_elem[3] = {1, 2, 3};
+    bignum_elem_t r_elem[2];
+    bignum_elem_t x_elem[2] = {5, 6};
+    bignum_elem_t scratch[BIGNUM_DIVMOD_SCRATCH(3)];
+
+    bignum_assoc(&n, n_elem, 2);
+    bignum_assoc(&d, d_elem, 3);
+    bignum_assoc(&r, r_elem, 2);
+    bignum_assoc(&x, x_elem, 2);
+
+    int ret = bignum_divmod(&n, &r, &n, &d, scratch);
+    return assert_equal_bignum(&r, &x) &&
+           assert_equal_int(n.length, 0) &&
+           assert_equal_int(ret, 0);
+}
+
+int test_divmod_by_zero() {
+    bignum_t n, d, q, r;
+    bignum_elem_t n_elem[2] = {1, 2};
+    bignum_elem_t q_elem[2];
+    bignum_elem_t r_elem[2];
+    bignum_elem_t scratch[BIGNUM_DIVMOD_SCRATCH(2)];
+
+    bignum_assoc(&n, n_elem, 2);
+    bignum_assoc(&d, NULL, 0);
+    bignum_assoc(&q, q_elem, 2);
+    bignum_assoc(&r, r_elem, 2);
+
+    return assert_equal_int(bignum_divmod(&q, &r, &n, &d, scratch), -1);
+}
+
+/**
+ * @brief A precomputed divisor can be used for several divisions.
+**/
+int test_divmod_ui_pre() {
+    bignum_t a, x;
+    bignum_udiv_ctx_t ctx;
+
+    bignum_elem_t a_elem[4] = DIVMOD_UI_LARGE_A;
+    bignum_elem_t x_elem[4];
+
+    bignum_assoc(&a, a_elem, 4);
+    bignum_assoc(&x, x_elem, 4);
+
+    bignum_udiv_init(&ctx, DIVMOD_UI_LARGE_D);
+    bignum_elem_t y = bignum_divmod_ui_pre(&x, &a, &ctx);
+    bignum_elem_t z = bignum_mod_ui_pre(&a, &ctx);
+
+    return assert_divmod_ui(&a, &x, DIVMOD_UI_LARGE_D, y) &&
+           assert_equal_elem(z, y);
+}
+
+/**
+ * @brief Dividing in place with a precomputed small divisor works.
+**/
+int test_divmod_ui_pre_in_place() {
+    bignum_t a, c;
+    bignum_udiv_ctx_t ctx;
+
+    bignum_elem_t a_elem[4] = {102, 2665, 4223, 82};
+    bignum_elem_t c_elem[4] = {2, 65, 103, 2};
+
+    bignum_assoc(&a, a_elem, 4);
+    bignum_assoc(&c, c_elem, 4);
+
+    bignum_udiv_init(&ctx, 41);
+    bignum_elem_t y = bignum_divmod_ui_pre(&a, &a, &ctx);
+
+    return assert_equal_bignum(&a, &c) &&
+           assert_equal_elem(y, 20);
+}
+
+/**
+ * @brief The remainders of many moduli in one pass match bignum_mod_ui().
+**/
+int test_mod_ui_multi() {
+    bignum_t a;
+    bignum_elem_t a_elem[32 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t moduli[40], out[40];
+    char a_hex[] = "f3a9c2e17b5d4086a1c3e5f7092b4d6f8e1a3c5b7d9f0e2c4a6b8d0f1e3c5a79";
+    int ret = 1;
+
+    bignum_assoc(&a, a_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&a, a_hex, 16);
+
+    // Small moduli, which are grouped into products, and a few large ones.
+    for (size_t i=0; i<36; i++)
+        moduli[i] = 2*i + 1;
+    moduli[36] = BIGNUM_ELEM_MAX;
+    moduli[37] = 7;
+    moduli[38] = BIGNUM_ELEM_MAX - 4;
+    moduli[39] = 2;
+
+    ret = assert_equal_int(bignum_mod_ui_multi(&a, moduli, out, 40), 0);
+    for (size_t i=0; i<40 && ret; i++)
+        ret = assert_equal_elem(out[i], bignum_mod_ui(&a, moduli[i]));
+
+    bignum_zero(&a);
+    ret = ret && assert_equal_int(bignum_mod_ui_multi(&a, moduli, out, 40), 0);
+    for (size_t i=0; i<40 && ret; i++)
+        ret = assert_equal_elem(out[i], 0);
+
+    moduli[20] = 0;
+    return ret && assert_equal_int(bignum_mod_ui_multi(&a, moduli, out, 40), -1);
+}
+
+int test_udiv_init_zero() {
+    bignum_udiv_ctx_t ctx;
+    return assert_equal_int(bignum_udiv_init(&ctx, 0), -1);
+}
+
+/**
+ * @brief Shifts move bits across elements, in place and with overflow.
+**/
+int test_shift() {
+    bignum_t a, r, c;
+    bignum_elem_t a_elem[32 / BIGNUM_ELEM_SIZE], r_elem[32 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t c_elem[32 / BIGNUM_ELEM_SIZE], t_elem[16 / BIGNUM_ELEM_SIZE];
+    char a_hex[] = "1f3a9c2e17b5d4086a1c3e5f7092b4d6f";
+    char l_hex[] = "3e75385c2f6ba810d4387cbee12569ade0000000000000000000";
+    char r_hex[] = "7cea70b85ed7502";
+    char t_hex[] = "75385c2f6ba810d4387cbee12569ade0";
+
+    bignum_assoc(&a, a_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&r, r_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&c, c_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&a, a_hex, 16);
+
+    bignum_set_str(&c, l_hex, 16);
+    int ret = assert_equal_int(bignum_lshift(&r, &a, 77), 0) &&
+              assert_equal_bignum(&r, &c);
+    bignum_set_str(&c, r_hex, 16);
+    ret = ret && assert_equal_int(bignum_rshift(&r, &r, 147), 0) &&
+          assert_equal_bignum(&r, &c) &&
+          assert_equal_int(bignum_tdiv_q_2exp(&r, &a, 70), 0) &&
+          assert_equal_bignum(&r, &c) &&
+          assert_equal_int(bignum_rshift(&r, &a, 129), 0) &&
+          assert_equal_int(r.length, 0);
+
+    // Only 128 bits fit into r.
+    bignum_assoc(&r, t_elem, 16 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&c, t_hex, 16);
+    ret = ret && assert_equal_int(bignum_lshift(&r, &a, 5), 1) &&
+          assert_equal_bignum(&r, &c) &&
+          assert_equal_int(bignum_rshift(&r, &a, 0), 1);
+
+    bignum_set(&c, &a);
+    return ret && assert_equal_int(bignum_lshift(&a, &a, 0), 0) &&
+           assert_equal_bignum(&a, &c);
+}
+
+/**
+ * @brief The remainder modulo 2^bits keeps the lowest bits.
+**/
+int test_mod_2exp() {
+    bignum_t a, r, c;
+    bignum_elem_t a_elem[32 / BIGNUM_ELEM_SIZE], r_elem[32 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t c_elem[32 / BIGNUM_ELEM_SIZE], t_elem[1];
+    char a_hex[] = "1f3a9c2e17b5d4086a1c3e5f7092b4d6f";
+    char m_hex[] = "6a1c3e5f7092b4d6f";
+    char z_hex[] = "100000000000000000000000000000000";
+
+    bignum_assoc(&a, a_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&r, r_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&c, c_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&a, a_hex, 16);
+
+    bignum_set_str(&c, m_hex, 16);
+    int ret = assert_equal_int(bignum_mod_2exp(&r, &a, 70), 0) &&
+              assert_equal_bignum(&r, &c) &&
+              assert_equal_int(bignum_mod_2exp(&r, &a, 1000), 0) &&
+              assert_equal_bignum(&r, &a);
+
+    // The low 128 bits of 2^128 are zero.
+    bignum_set_str(&c, z_hex, 16);
+    ret = ret && assert_equal_int(bignum_mod_2exp(&c, &c, 128), 0) &&
+          assert_equal_int(c.length, 0);
+
+    bignum_assoc(&r, t_elem, 1);
+    return ret && assert_equal_int(bignum_mod_2exp(&r, &a, 70), 1) &&
+           assert_equal_elem(r.v[0], a.v[0]);
+}
+
+/**
+ * @brief Bit length, trailing zeros, population count and single bits.
+**/
+int test_bits() {
+    bignum_t a;
+    bignum_elem_t a_elem[32 / BIGNUM_ELEM_SIZE];
+    char a_hex[] = "3e75385c2f6ba810d4387cbee12569ade0000000000000000000";
+
+    bignum_assoc(&a, a_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_zero(&a);
+    int ret = assert_equal_int(bignum_bit_length(&a), 0) &&
+              assert_equal_int(bignum_ctz(&a), 0) &&
+              assert_equal_int(bignum_popcount(&a), 0) &&
+              assert_equal_int(bignum_tstbit(&a, 5), 0);
+
+    bignum_set_str(&a, a_hex, 16);
+    ret = ret && assert_equal_int(bignum_bit_length(&a), 206) &&
+          assert_equal_int(bignum_ctz(&a), 77) &&
+          assert_equal_int(bignum_popcount(&a), 68) &&
+          assert_equal_int(bignum_tstbit(&a, 77), 1) &&
+          assert_equal_int(bignum_tstbit(&a, 81), 0) &&
+          assert_equal_int(bignum_tstbit(&a, 205), 1) &&
+          assert_equal_int(bignum_tstbit(&a, 206), 0) &&
+          assert_equal_int(bignum_tstbit(&a, 100000), 0);
+
+    ret = ret && assert_equal_int(bignum_setbit(&a, 3), 0) &&
+          assert_equal_int(bignum_ctz(&a), 3) &&
+          assert_equal_int(bignum_setbit(&a, 255), 0) &&
+          assert_equal_int(bignum_bit_length(&a), 256) &&
+          assert_equal_int(bignum_popcount(&a), 70) &&
+          assert_equal_int(bignum_setbit(&a, 256), -1);
+
+    // Setting a bit above the length zeroes the elements in between.
+    bignum_set_ui(&a, 1);
+    a.v[1] = 7;
+    return ret && assert_equal_int(bignum_setbit(&a, 130), 0) &&
+           assert_equal_int(bignum_popcount(&a), 2) &&
+           assert_equal_int(bignum_bit_length(&a), 131);
+}
+
+int test_mullo() {
+    bignum_t a, x;
+    bignum_elem_t a_elem[3] = {BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX};
+    bignum_elem_t x_elem[3];
+
+    bignum_assoc(&a, a_elem, 3);
+    bignum_assoc(&x, x_elem, 3);
+
+    // (base^3 - 1)^2 = base^6 - 2 * base^3 + 1
+    int ret = bignum_mullo(&x, &a, &a, 3);
+    return assert_equal_int(bignum_cmp_ui(&x, 1), 0) &&
+           assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief bignum_mulhi() is exact or one too small.
+**/
+int test_mulhi() {
+    bignum_t a, c, d, x;
+    bignum_elem_t a_elem[3] = {BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX};
+    bignum_elem_t c_elem[3] = {BIGNUM_ELEM_MAX - 1, BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX};
+    bignum_elem_t d_elem[3] = {BIGNUM_ELEM_MAX - 2, BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX};
+    bignum_elem_t x_elem[3];
+    bignum_elem_t scratch[BIGNUM_MULHI_SCRATCH(3)];
+
+    bignum_assoc(&a, a_elem, 3);
+    bignum_assoc(&c, c_elem, 3);
+    bignum_assoc(&d, d_elem, 3);
+    bignum_assoc(&x, x_elem, 3);
+
+    bignum_mulhi(&x, &a, &a, 3, scratch);
+    if (bignum_cmp(&x, &d) == 0)
+        return 1;
+    return assert_equal_bignum(&x, &c);
+}
+
+int test_mod_barrett() {
+    bignum_t m, a, c, x;
+    bignum_barrett_ctx_t ctx;
+    bignum_elem_t m_elem[3] = {7, 9, BIGNUM_ELEM_MAX - 4};
+    bignum_elem_t a_elem[6] = {1, 2, 3, 4, BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX - 1};
+    bignum_elem_t c_elem[3] = {
+        BIGNUM_ELEM_MAX - 68, BIGNUM_ELEM_MAX - 158, BIGNUM_ELEM_MAX - 65
+    };
+    bignum_elem_t x_elem[3];
+    bignum_elem_t mu_elem[5];
+    bignum_elem_t scratch[BIGNUM_BARRETT_SCRATCH(3)];
+
+    bignum_assoc(&m, m_elem, 3);
+    bignum_assoc(&a, a_elem, 6);
+    bignum_assoc(&c, c_elem, 3);
+    bignum_assoc(&x, x_elem, 3);
+
+    bignum_barrett_init(&ctx, &m, mu_elem, scratch);
+    int ret = bignum_mod_barrett(&x, &a, &ctx, scratch);
+    return assert_equal_bignum(&x, &c) &&
+           assert_equal_int(ret, 0);
+}
+
+int test_sqr() {
+    bignum_t a, c, x;
+    bignum_elem_t a_elem[4] = {1, 2, 3, 4};
+    bignum_elem_t c_elem[8] = {
+        1,                      // 0
+        2*1*2,                  // 1
+        2*1*3 + 2*2,            // 2
+        2*1*4 + 2*2*3,          // 3
+        2*2*4 + 3*3,            // 4
+        2*3*4,                  // 5
+        4*4,                    // 6
+        0                       // 7
+    };
+    bignum_elem_t x_elem[8];
+
+    bignum_assoc(&a, a_elem, 4);
+    bignum_assoc(&c, c_elem, 8);
+    bignum_assoc(&x, x_elem, 8);
+
+    int ret = bignum_sqr(&x, &a);
+    return assert_equal_bignum(&x, &c) &&
+           assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief Karatsuba squaring yields the same result as multiplication.
+**/
+int test_sqr_karatsuba() {
+    bignum_t a, x, y;
+    bignum_elem_t a_elem[BIGNUM_4096];
+    bignum_elem_t x_elem[2*BIGNUM_4096];
+    bignum_elem_t y_elem[2*BIGNUM_4096];
+    bignum_elem_t scratch[BIGNUM_MUL_SCRATCH(BIGNUM_4096)];
+
+    bignum_elem_t seed = 54321;
+    for (int i=0; i<BIGNUM_4096; i++) {
+        seed = seed * 1103515245 + 12345;
+        a_elem[i] = i % 7 == 0 ? BIGNUM_ELEM_MAX : seed;
+    }
+
+    bignum_assoc(&a, a_elem, BIGNUM_4096);
+    bignum_assoc(&x, x_elem, 2*BIGNUM_4096);
+    bignum_assoc(&y, y_elem, 2*BIGNUM_4096);
+
+    int ret = bignum_sqr_scratch(&x, &a, scratch);
+    bignum_mul_scratch(&y, &a, &a, NULL);
+    return assert_equal_bignum(&x, &y) &&
+           assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief Squaring into a too small rop keeps the lower elements
+ *        and reports the overflow.
+**/
+int test_sqr_overflow() {
+    bignum_t a, c, x;
+    bignum_elem_t a_elem[2] = {0, BIGNUM_ELEM_MAX};
+    bignum_elem_t c_elem[3] = {0, 0, 1};
+    bignum_elem_t x_elem[3];
+
+    bignum_assoc(&a, a_elem, 2);
+    bignum_assoc(&c, c_elem, 3);
+    bignum_assoc(&x, x_elem, 3);
+
+    int ret = bignum_sqr(&x, &a);
+    return assert_equal_bignum(&x, &c) &&
+           assert_equal_int(ret, 1);
+}
+
+/**
+ * @brief Numbers can be loaded from and stored to interleaved batches.
+**/
+int test_interleaved() {
+    bignum_t a, b, x;
+    // Three numbers of two elements: {1, 2}, {3, 0} and {5, 6}
+    bignum_elem_t batch[6] = {1, 3, 5, 2, 0, 6};
+    bignum_elem_t a_elem[2];
+    bignum_elem_t b_elem[2];
+    bignum_elem_t x_elem[2] = {3, 0};
+
+    bignum_load_interleaved(&a, a_elem, batch, 2, 3, 1);
+    bignum_load_interleaved(&b, b_elem, batch, 2, 3, 2);
+    bignum_assoc(&x, x_elem, 2);
+
+    int ret = assert_equal_bignum(&a, &x) &&
+              assert_equal_int(b.length, 2) &&
+              assert_equal_elem(b_elem[1], 6);
+
+    bignum_add(&b, &b, &a);
+    bignum_store_interleaved(batch, &b, 3, 0);
+    return ret &&
+           assert_equal_elem(batch[0], 8) &&
+           assert_equal_elem(batch[3], 6) &&
+           assert_equal_elem(batch[2], 5);
+}
+
+/**
+ * @brief A carry rippling through all elements ends up in a new
+ *        element and is not reported as overflow.
+**/
+int test_add_carry_chain() {
+    bignum_t a, b, c, x;
+    bignum_elem_t a_elem[4] = {BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX, 0};
+    bignum_elem_t b_elem[4] = {1, 0, 0, 0};
+    bignum_elem_t c_elem[4] = {0, 0, 0, 1};
+    bignum_elem_t x_elem[4];
+
+    bignum_assoc(&a, a_elem, 4);
+    bignum_assoc(&b, b_elem, 4);
+    bignum_assoc(&c, c_elem, 4);
+    bignum_assoc(&x, x_elem, 4);
+
+    int ret = bignum_add(&x, &b, &a);
+    return assert_equal_bignum(&x, &c) &&
+           assert_equal_int(x.length, 4) &&
+           assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief Adding two maximal elements with an incoming carry
+ *        doesn't lose the carry.
+**/
+int test_add_carry_wraparound() {
+    bignum_t a, b, c, x;
+    bignum_elem_t a_elem[3] = {BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX, 0};
+    bignum_elem_t b_elem[3] = {1, BIGNUM_ELEM_MAX, 0};
+    bignum_elem_t c_elem[3] = {0, BIGNUM_ELEM_MAX, 1};
+    bignum_elem_t x_elem[3];
+
+    bignum_assoc(&a, a_elem, 3);
+    bignum_assoc(&b, b_elem, 3);
+    bignum_assoc(&c, c_elem, 3);
+    bignum_assoc(&x, x_elem, 3);
+
+    int ret = bignum_add(&x, &a, &b);
+    return assert_equal_bignum(&x, &c) &&
+           assert_equal_int(ret, 0);
+}
+
+/**
+ * @brief Adding a single element sets all elements of the result
+ *        and reports a carry out of the last element as overflow.
+**/
+int test_add_ui_carry() {
+    bignum_t a, c, x;
+    bignum_elem_t a_elem[2] = {BIGNUM_ELEM_MAX - 1, 7};
+    bignum_elem_t c_elem[2] = {1, 8};
+    bignum_elem_t x_elem[2] = {5, 5};
+
+    bignum_assoc(&a, a_elem, 2);
+    bignum_assoc(&c, c_elem, 2);
+    bignum_assoc(&x, x_elem, 2);
+
+    int ret = bignum_add_ui(&x, &a, 3);
+    ret = assert_equal_bignum(&x, &c) && assert_equal_int(ret, 0);
+
+    a_elem[0] = BIGNUM_ELEM_MAX;
+    a_elem[1] = BIGNUM_ELEM_MAX;
+    bignum_assoc(&a, a_elem, 2);
+    int overflow = bignum_add_ui(&x, &a, 1);
+    return ret &&
+           assert_equal_int(overflow, 1) &&
+           assert_equal_int(x.length, 0);
+}
+
+/**
+ * @brief The fixed-size addition matches bignum_add() including
+ *        the overflow.
+**/
+int test_fixed_add() {
+    bignum_t a, x;
+    bignum_elem_t a_elem[BIGNUM_512];
+    bignum_elem_t b_elem[BIGNUM_512];
+    bignum_elem_t x_elem[BIGNUM_512];
+
+    for (size_t i=0; i<BIGNUM_512; i++) {
+        a_elem[i] = BIGNUM_ELEM_MAX;
+        b_elem[i] = 0;
+    }
+    b_elem[0] = 1;
+
+    int ret = bignum512_add(x_elem, a_elem, b_elem);
+    bignum_assoc(&x, x_elem, BIGNUM_512);
+    ret = assert_equal_int(ret, 1) && assert_equal_int(x.length, 0);
+
+    // a = base^(n-1) - 1, a + 1 fits.
+    a_elem[BIGNUM_512-1] = 0;
+    int overflow = bignum512_add(a_elem, a_elem, b_elem);
+    bignum_assoc(&a, a_elem, BIGNUM_512);
+    return ret &&
+           assert_equal_int(overflow, 0) &&
+           assert_equal_int(a.length, BIGNUM_512) &&
+           assert_equal_elem(a_elem[BIGNUM_512-1], 1) &&
+           assert_equal_elem(a_elem[0], 0);
+}
+
+/**
+ * @brief The fixed-size multiplication and squaring match
+ *        bignum_mul() and bignum_sqr().
+**/
+int test_fixed_mul_sqr() {
+    bignum_t a, b, c, x;
+    bignum_elem_t a_elem[BIGNUM_1024];
+    bignum_elem_t b_elem[BIGNUM_1024];
+    bignum_elem_t c_elem[BIGNUM_1024];
+    bignum_elem_t x_elem[BIGNUM_1024];
+    int ret = 1;
+
+    // Both operands have half of the elements, so the product fits.
+    for (size_t i=0; i<BIGNUM_1024; i++) {
+        a_elem[i] = i < BIGNUM_512 ? BIGNUM_ELEM_MAX - i : 0;
+        b_elem[i] = i < BIGNUM_512 ? i * 0x9e3779b9 + 7 : 0;
+    }
+    bignum_assoc(&a, a_elem, BIGNUM_1024);
+    bignum_assoc(&b, b_elem, BIGNUM_1024);
+    bignum_assoc(&c, c_elem, BIGNUM_1024);
+
+    ret = ret && assert_equal_int(bignum1024_mul(x_elem, a_elem, b_elem), 0);
+    bignum_mul(&c, &a, &b);
+    bignum_assoc(&x, x_elem, BIGNUM_1024);
+    ret = ret && assert_equal_bignum(&x, &c);
+
+    ret = ret && assert_equal_int(bignum1024_sqr(x_elem, a_elem), 0);
+    bignum_sqr(&c, &a);
+    bignum_assoc(&x, x_elem, BIGNUM_1024);
+    ret = ret && assert_equal_bignum(&x, &c);
+
+    // Two more elements in a make both overflow.
+    a_elem[BIGNUM_512+1] = 1;
+    ret = ret && assert_equal_int(bignum1024_mul(x_elem, a_elem, b_elem), 1);
+    return ret && assert_equal_int(bignum1024_sqr(x_elem, a_elem), 1);
+}
+
+/**
+ * @brief Numbers associated with a known length ignore the elements
+ *        above it.
+**/
+int test_assoc_len() {
+    bignum_t a, b, c, x;
+    bignum_elem_t a_elem[4] = {1, 2, 99, 99};
+    bignum_elem_t b_elem[4] = {3, 4, 5, 0};
+    bignum_elem_t c_elem[4] = {4, 6, 5, 0};
+    bignum_elem_t x_elem[4] = {7, 7, 7, 7};
+
+    bignum_assoc_len(&a, a_elem, 4, 2);
+    bignum_assoc(&b, b_elem, 4);
+    bignum_assoc(&c, c_elem, 4);
+    bignum_assoc_len(&x, x_elem, 4, 0);
+
+    int ret = assert_equal_int(a.length, 2) &&
+              assert_equal_int(x.length, 0);
+
+    bignum_add(&x, &a, &b);
+    bignum_write(&x);
+    bignum_sync(&x);
+
+    bignum_assoc_at_len(&a, c_elem, 2, 1, 5);
+    return ret &&
+           assert_equal_bignum(&x, &c) &&
+           assert_equal_int(a.length, 2) &&
+           assert_equal_elem(a.v[0], 5);
+}
+
+/**
+ * @brief bignum_addmul_ui() accumulates in place and stores the carry,
+ *        if rop has room for it.
+**/
+int test_addmul_ui() {
+    bignum_t a, c, x;
+    bignum_elem_t a_elem[3] = {BIGNUM_ELEM_MAX, BIGNUM_ELEM_MAX, 0};
+    bignum_elem_t c_elem[3] = {4, 0, 3};
+    bignum_elem_t x_elem[3] = {7, 0, 0};
+
+    bignum_assoc(&a, a_elem, 3);
+    bignum_assoc(&c, c_elem, 3);
+    bignum_assoc(&x, x_elem, 3);
+
+    // 7 + (base^2 - 1) * 3 = 3 * base^2 + 4
+    int ret = assert_equal_elem(bignum_addmul_ui(&x, &a, 3), 0) &&
+              assert_equal_bignum(&x, &c);
+
+    // rop == op1: x + x * (base - 1) = x * base, the top element is
+    // carried out.
+    bignum_elem_t carry = bignum_addmul_ui(&x, &x, BIGNUM_ELEM_MAX);
+    return ret &&
+           assert_equal_elem(carry, 3) &&
+           assert_equal_int(x.length, 2) &&
+           assert_equal_elem(x_elem[0], 0) &&
+           assert_equal_elem(x_elem[1], 4);
+}
+
+/**
+ * @brief bignum_submul_ui() subtracts in place and returns the borrow
+ *        of a negative result.
+**/
+int test_submul_ui() {
+    bignum_t a, x;
+    bignum_elem_t a_elem[2] = {5, 1};
+    bignum_elem_t x_elem[2] = {20, 3};
+
+    bignum_assoc(&a, a_elem, 2);
+    bignum_assoc(&x, x_elem, 2);
+
+    // (3 * base + 20) - 3 * (base + 5) = 5
+    int ret = assert_equal_elem(bignum_submul_ui(&x, &a, 3), 0) &&
+              assert_equal_int(x.length, 1) &&
+              assert_equal_elem(x_elem[0], 5);
+
+    // 5 - (base + 5) = -base, which is base^2 - base with borrow 1.
+    bignum_elem_t borrow = bignum_submul_ui(&x, &a, 1);
+    return ret &&
+           assert_equal_elem(borrow, 1) &&
+           assert_equal_int(x.length, 2) &&
+           assert_equal_elem(x_elem[0], 0) &&
+           assert_equal_elem(x_elem[1], BIGNUM_ELEM_MAX);
+}
+
+/**
+ * @brief bignum_get_str() and bignum_set_str() convert between strings
+ *        in base 10 or 16 and numbers.
+**/
+int test_str() {
+    bignum_t x, y;
+    bignum_elem_t x_elem[16 / BIGNUM_ELEM_SIZE], y_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t scratch[BIGNUM_GET_STR_SCRATCH(16 / BIGNUM_ELEM_SIZE)];
+    char str[BIGNUM_STR_SIZE(16 / BIGNUM_ELEM_SIZE)];
+    char dec[] = "123456789012345678901234567890";
+    char hex[] = "18ee90ff6c373e0ee4e3f0ad2";
+    char hex_upper[] = "0018EE90FF6C373E0EE4E3F0AD2";
+    char zero[] = "0";
+
+    bignum_assoc(&x, x_elem, 16 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&y, y_elem, 16 / BIGNUM_ELEM_SIZE);
+
+    int ret = assert_equal_int(bignum_set_str(&x, dec, 10), 0) &&
+              assert_equal_int(bignum_get_str(str, sizeof(str), &x, 16, NULL), 25) &&
+              assert_equal_str(str, hex) &&
+              assert_equal_int(bignum_get_str(str, sizeof(str), &x, 10, scratch), 30) &&
+              assert_equal_str(str, dec) &&
+              assert_equal_int(bignum_set_str(&y, hex_upper, 16), 0) &&
+              assert_equal_bignum(&y, &x);
+
+    bignum_zero(&x);
+    return ret &&
+           assert_equal_int(bignum_get_str(str, sizeof(str), &x, 10, scratch), 1) &&
+           assert_equal_str(str, zero) &&
+           assert_equal_int(bignum_get_str(str, sizeof(str), &x, 16, NULL), 1) &&
+           assert_equal_str(str, zero);
+}
+
+/**
+ * @brief Long numbers are converted to decimal by splitting them with
+ *        powers of ten, which doesn't lose any inner zeros or nines.
+**/
+int test_str_split() {
+    bignum_t x;
+    bignum_elem_t x_elem[BIGNUM_2048];
+    bignum_elem_t scratch[BIGNUM_GET_STR_SCRATCH(BIGNUM_2048)];
+    char str[BIGNUM_STR_SIZE(BIGNUM_2048)];
+    char expected[402];
+    int ret = 1;
+
+    bignum_assoc(&x, x_elem, BIGNUM_2048);
+
+    // 10^400 and 10^401 - 1 take about 1330 bits.
+    expected[0] = '1';
+    for (int i=1; i<=400; i++)
+        expected[i] = '0';
+    expected[401] = '\0';
+    ret = ret && assert_equal_int(bignum_set_str(&x, expected, 10), 0) &&
+          assert_equal_int(bignum_get_str(str, sizeof(str), &x, 10, scratch), 401) &&
+          assert_equal_str(str, expected);
+
+    for (int i=0; i<=400; i++)
+        expected[i] = '9';
+    ret = ret && assert_equal_int(bignum_set_str(&x, expected, 10), 0) &&
+          assert_equal_int(bignum_get_str(str, sizeof(str), &x, 10, scratch), 401) &&
+          assert_equal_str(str, expected);
+    return ret;
+}
+
+/**
+ * @brief bignum_set_str() rejects invalid strings and truncates values,
+ *        which are too large. bignum_get_str() needs room for all digits.
+**/
+int test_str_errors() {
+    bignum_t x, y;
+    bignum_elem_t x_elem[1], y_elem[1] = {1};
+    char empty[] = "";
+    char invalid[] = "12a";
+    // 2^128 + 1 and 2^156
+    char dec[] = "340282366920938463463374607431768211457";
+    char hex[] = "1000000000000000000000000000000000000000";
+    char str[3];
+
+    bignum_assoc(&x, x_elem, 1);
+    bignum_assoc(&y, y_elem, 1);
+
+    return assert_equal_int(bignum_set_str(&x, empty, 10), -1) &&
+           assert_equal_int(bignum_set_str(&x, invalid, 10), -1) &&
+           assert_equal_int(bignum_set_str(&x, invalid, 8), -1) &&
+           assert_equal_int(bignum_set_str(&x, dec, 10), 1) &&
+           assert_equal_bignum(&x, &y) &&
+           assert_equal_int(bignum_set_str(&x, hex, 16), 1) &&
+           assert_equal_int(x.length, 0) &&
+           assert_equal_int(bignum_set_ui(&x, BIGNUM_ELEM_MAX), 0) &&
+           assert_equal_int(bignum_get_str(str, sizeof(str), &x, 10, NULL), -1) &&
+           assert_equal_int(bignum_get_str(str, sizeof(str), &x, 8, NULL), -1);
+}
+
+/**
+ * @brief bignum_import() and bignum_export() read and write byte strings
+ *        and words of any size and byte order.
+**/
+int test_import_export() {
+    bignum_t x, y, z;
+    bignum_elem_t x_elem[32 / BIGNUM_ELEM_SIZE], y_elem[32 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t z_elem[16 / BIGNUM_ELEM_SIZE];
+    // 0x0102...13, 19 bytes big-endian
+    unsigned char bytes[19];
+    unsigned char buf[32];
+    char hex[] = "0102030405060708090a0b0c0d0e0f10111213";
+    char hex_low[] = "0405060708090a0b0c0d0e0f10111213";
+    int ret = 1;
+
+    for (int i=0; i<19; i++)
+        bytes[i] = i + 1;
+    bignum_assoc(&y, y_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&z, z_elem, 16 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&y, hex, 16);
+
+    // Byte strings in both byte orders
+    bignum_assoc(&x, x_elem, 32 / BIGNUM_ELEM_SIZE);
+    ret = ret && assert_equal_int(bignum_import(&x, bytes, 19, 1, 1, 0), 0) &&
+          assert_equal_bignum(&x, &y) &&
+          assert_equal_int(bignum_export(buf, 19, -1, 1, 0, &x), 0);
+    for (int i=0; ret && i<19; i++)
+        ret = assert_equal_int(buf[i], bytes[18-i]);
+    bignum_zero(&x);
+    ret = ret && assert_equal_int(bignum_import(&x, buf, 19, -1, 1, 1), 0) &&
+          assert_equal_bignum(&x, &y);
+
+    // Big-endian elements, most significant first, padded with zeros
+    ret = ret && assert_equal_int(bignum_export(buf, 32 / BIGNUM_ELEM_SIZE, 1, BIGNUM_ELEM_SIZE, 1, &y), 0);
+    for (int i=0; ret && i<32; i++)
+        ret = assert_equal_int(buf[i], i < 13 ? 0 : bytes[i - 13]);
+    bignum_zero(&x);
+    ret = ret && assert_equal_int(bignum_import(&x, buf, 32 / BIGNUM_ELEM_SIZE, 1, BIGNUM_ELEM_SIZE, 1), 0) &&
+          assert_equal_bignum(&x, &y);
+
+    // Big-endian words of 3 bytes, least significant first
+    ret = ret && assert_equal_int(bignum_export(buf, 7, -1, 3, 1, &y), 0) &&
+          assert_equal_int(buf[0], 0x11) && assert_equal_int(buf[1], 0x12) &&
+          assert_equal_int(buf[2], 0x13) && assert_equal_int(buf[18], 0) &&
+          assert_equal_int(buf[19], 0) && assert_equal_int(buf[20], 0x01);
+    bignum_zero(&x);
+    ret = ret && assert_equal_int(bignum_import(&x, buf, 7, -1, 3, 1), 0) &&
+          assert_equal_bignum(&x, &y);
+
+    // Errors and overflows
+    bignum_set_str(&y, hex_low, 16);
+    return ret &&
+           assert_equal_int(bignum_import(&z, bytes, 19, 1, 1, 0), 1) &&
+           assert_equal_bignum(&z, &y) &&
+           assert_equal_int(bignum_export(buf, 5, 1, 3, 1, &x), -1) &&
+           assert_equal_int(bignum_export(buf, 19, 0, 1, 0, &x), -1) &&
+           assert_equal_int(bignum_import(&x, bytes, 19, 1, 0, 0), -1) &&
+           assert_equal_int(bignum_import(&x, bytes, 19, 1, 1, 2), -1);
+}
+
+/**
+ * @brief bignum_assoc_bytes() associates aligned byte strings in place.
+**/
+int test_assoc_bytes() {
+    bignum_t x, y;
+    bignum_elem_t arr[32 / BIGNUM_ELEM_SIZE], y_elem[32 / BIGNUM_ELEM_SIZE];
+    unsigned char *bytes = (unsigned char *) arr;
+    char hex[] = "201f1e1d1c1b1a191817161514131211100f0e0d0c0b0a090807060504030201";
+    int ret;
+
+    bignum_assoc(&y, y_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&y, hex, 16);
+
+    for (int i=0; i<32; i++)
+        bytes[i] = i + 1;
+    ret = assert_equal_int(bignum_assoc_bytes(&x, bytes, 32, -1), 0) &&
+          assert_equal_int(x.max_length, 32 / BIGNUM_ELEM_SIZE) &&
+          assert_equal_bignum(&x, &y);
+
+    for (int i=0; i<32; i++)
+        bytes[i] = 32 - i;
+    ret = ret && assert_equal_int(bignum_assoc_bytes(&x, bytes, 32, 1), 0) &&
+          assert_equal_bignum(&x, &y) &&
+          assert_equal_int(bytes[0], 1) && assert_equal_int(bytes[31], 32);
+
+    return ret &&
+           assert_equal_int(bignum_assoc_bytes(&x, bytes, 32, 2), -1) &&
+           (BIGNUM_ELEM_SIZE == 1 ||
+            (assert_equal_int(bignum_assoc_bytes(&x, bytes, 31, -1), -1) &&
+             assert_equal_int(bignum_assoc_bytes(&x, bytes + 1, 8, -1), -1)));
+}
+
+int test_gcd() {
+    bignum_t a, b, g, r;
+    bignum_elem_t a_elem[48 / BIGNUM_ELEM_SIZE], b_elem[48 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t g_elem[48 / BIGNUM_ELEM_SIZE], r_elem[48 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t scratch[BIGNUM_GCD_SCRATCH(48 / BIGNUM_ELEM_SIZE)];
+    char a_hex[] = "2a2e9e2cdb64c51b2eb75d703cd81901b4555d7773814e4b9181c543195e84d20";
+    char b_hex[] = "16e8dadf4b7095574888887c1f19ee31dcdfb7b1e5f5368d76ad04f04939d8760";
+    char g_hex[] = "d60343825474420e0";
+
+    bignum_assoc(&a, a_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&b, b_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&g, g_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&r, r_elem, 48 / BIGNUM_ELEM_SIZE);
+
+    bignum_set_str(&a, a_hex, 16);
+    bignum_set_str(&b, b_hex, 16);
+    bignum_set_str(&g, g_hex, 16);
+    int ret = assert_equal_int(bignum_gcd(&r, &a, &b, scratch), 0) &&
+              assert_equal_bignum(&r, &g) &&
+              assert_equal_int(bignum_gcd(&r, &b, &a, scratch), 0) &&
+              assert_equal_bignum(&r, &g);
+
+    // gcd(a, 0) = a, gcd(0, 0) = 0
+    bignum_zero(&b);
+    ret = ret && assert_equal_int(bignum_gcd(&r, &a, &b, scratch), 0) &&
+          assert_equal_bignum(&r, &a) &&
+          assert_equal_int(bignum_gcd(&r, &b, &b, scratch), 0) &&
+          assert_equal_int(r.length, 0);
+
+    // Small operands and the result in place of an operand.
+    bignum_set_ui(&a, 84);
+    bignum_set_ui(&b, 120);
+    return ret && assert_equal_int(bignum_gcd(&a, &a, &b, scratch), 0) &&
+           assert_equal_int(bignum_cmp_ui(&a, 12), 0);
+}
+
+int test_gcdext() {
+    bignum_t a, b, g, s, t, x, y;
+    bignum_elem_t a_elem[48 / BIGNUM_ELEM_SIZE], b_elem[48 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t g_elem[48 / BIGNUM_ELEM_SIZE], s_elem[48 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t t_elem[48 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t x_elem[96 / BIGNUM_ELEM_SIZE], y_elem[96 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t scratch[BIGNUM_GCDEXT_SCRATCH(48 / BIGNUM_ELEM_SIZE)];
+    char a_hex[] = "2a2e9e2cdb64c51b2eb75d703cd81901b4555d7773814e4b9181c543195e84d20";
+    char b_hex[] = "16e8dadf4b7095574888887c1f19ee31dcdfb7b1e5f5368d76ad04f04939d8760";
+    char g_hex[] = "d60343825474420e0";
+
+    bignum_assoc(&a, a_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&b, b_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&g, g_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&s, s_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&t, t_elem, 48 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&x, x_elem, 96 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&y, y_elem, 96 / BIGNUM_ELEM_SIZE);
+
+    bignum_set_str(&a, a_hex, 16);
+    bignum_set_str(&b, b_hex, 16);
+    int ret = assert_equal_int(bignum_gcdext(&g, &s, &t, &a, &b, scratch), 0);
+
+    // a * s = b * t + g
+    bignum_mul(&x, &a, &s);
+    bignum_mul(&y, &b, &t);
+    bignum_add(&y, &y, &g);
+    ret = ret && assert_equal_bignum(&x, &y) &&
+          assert_equal_int(bignum_set_str(&x, g_hex, 16), 0) &&
+          assert_equal_bignum(&g, &x);
+
+    // The cofactors may be omitted.
+    ret = ret && assert_equal_int(bignum_gcdext(&x, NULL, &t, &b, &a, scratch), 0) &&
+          assert_equal_bignum(&x, &g) &&
+          assert_equal_int(bignum_gcdext(&x, &s, NULL, &b, &a, scratch), 0) &&
+          assert_equal_bignum(&x, &g);
+
+    // gcd(a, 0) = a * 1 - 0 * 0, but gcd(0, b) has no such cofactors.
+    bignum_zero(&b);
+    ret = ret && assert_equal_int(bignum_gcdext(&g, &s, &t, &a, &b, scratch), 0) &&
+          assert_equal_bignum(&g, &a) &&
+          assert_equal_int(bignum_cmp_ui(&s, 1), 0) &&
+          assert_equal_int(t.length, 0);
+    return ret && assert_equal_int(bignum_gcdext(&g, &s, &t, &b, &a, scratch), -1);
+}
+
+int test_invert() {
+    bignum_t m, x, r, y;
+    bignum_elem_t m_elem[32 / BIGNUM_ELEM_SIZE], x_elem[32 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t r_elem[32 / BIGNUM_ELEM_SIZE], y_elem[32 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t scratch[BIGNUM_INVERT_SCRATCH(32 / BIGNUM_ELEM_SIZE)];
+    char m_hex[] = "2c692933b91e572ebe718df3b74e9fbc056855fcb33444b25199d6011bb55f9";
+    char x_hex[] = "e0c54cb0e4bd1aa3f1fed0c435ff602bda6fd5ca040ad67e72";
+    char r_hex[] = "628fbb8b9c859eb1b12ab6289a7f9b8b8b67fc0fce7768d1c3ee8a9621eb6";
+
+    bignum_assoc(&m, m_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&x, x_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&r, r_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_assoc(&y, y_elem, 32 / BIGNUM_ELEM_SIZE);
+
+    bignum_set_str(&m, m_hex, 16);
+    bignum_set_str(&x, x_hex, 16);
+    bignum_set_str(&y, r_hex, 16);
+    int ret = assert_equal_int(bignum_invert(&r, &x, &m, scratch), 0) &&
+              assert_equal_bignum(&r, &y);
+
+    // 6 has no inverse modulo 9, everything is 0 modulo 1.
+    bignum_set_ui(&x, 6);
+    bignum_set_ui(&m, 9);
+    ret = ret && assert_equal_int(bignum_invert(&r, &x, &m, scratch), 1);
+    bignum_set_ui(&m, 1);
+    ret = ret && assert_equal_int(bignum_invert(&r, &x, &m, scratch), 0) &&
+          assert_equal_int(r.length, 0);
+
+    bignum_zero(&m);
+    return ret && assert_equal_int(bignum_invert(&r, &x, &m, scratch), -1);
+}
+
+/**
+ * @brief Trial division decides the numbers below 2^16.
+**/
+int test_trial_division() {
+    bignum_t n;
+    bignum_elem_t n_elem[4 / BIGNUM_ELEM_SIZE + 1];
+    char p_hex[] = "fff1";    // 65521, the largest prime below 2^16
+    char c_hex[] = "f619";    // 251^2
+    char q_hex[] = "10001";   // 65537
+
+    bignum_assoc(&n, n_elem, 4 / BIGNUM_ELEM_SIZE + 1);
+    bignum_zero(&n);
+    int ret = assert_equal_int(bignum_trial_division(&n), 0);
+    bignum_set_ui(&n, 1);
+    ret = ret && assert_equal_int(bignum_trial_division(&n), 0);
+    bignum_set_ui(&n, 2);
+    ret = ret && assert_equal_int(bignum_trial_division(&n), 2);
+    bignum_set_ui(&n, 251);
+    ret = ret && assert_equal_int(bignum_trial_division(&n), 2);
+    bignum_set_ui(&n, 253);
+    ret = ret && assert_equal_int(bignum_trial_division(&n), 0);
+
+    bignum_set_str(&n, p_hex, 16);
+    ret = ret && assert_equal_int(bignum_trial_division(&n), 2);
+    bignum_set_str(&n, c_hex, 16);
+    ret = ret && assert_equal_int(bignum_trial_division(&n), 0);
+    bignum_set_str(&n, q_hex, 16);
+    return ret && assert_equal_int(bignum_trial_division(&n), 1);
+}
+
+/**
+ * @brief Miller-Rabin finds composites and strong pseudoprimes fail
+ *        with enough bases.
+**/
+int test_is_probab_prime() {
+    bignum_t n;
+    bignum_elem_t n_elem[32 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t scratch[BIGNUM_PRIME_SCRATCH(32 / BIGNUM_ELEM_SIZE)];
+    bignum_elem_t bases[2] = {2, 3};
+    char p_hex[] = "7fffffffffffffffffffffffffffffff";         // 2^127 - 1
+    char c_hex[] = "3ffffffffffffffdffffffe000000000000001";   // (2^61 - 1) * (2^89 - 1)
+    char psp23_hex[] = "14f5d5";    // 829 * 1657, a strong pseudoprime to 2 and 3
+    char psp235_hex[] = "18271b1";  // 2251 * 11251, to 2, 3 and 5
+
+    bignum_assoc(&n, n_elem, 32 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&n, p_hex, 16);
+    int ret = assert_equal_int(bignum_is_probab_prime(&n, NULL, 10, scratch), 1) &&
+              assert_equal_int(bignum_is_probab_prime(&n, NULL, BIGNUM_SMALL_PRIMES + 1, scratch), -1);
+    bignum_set_str(&n, c_hex, 16);
+    ret = ret && assert_equal_int(bignum_is_probab_prime(&n, NULL, 10, scratch), 0);
+
+    bignum_set_str(&n, psp23_hex, 16);
+    ret = ret && assert_equal_int(bignum_is_probab_prime(&n, bases, 2, scratch), 1) &&
+          assert_equal_int(bignum_is_probab_prime(&n, NULL, 3, scratch), 0);
+    bignum_set_str(&n, psp235_hex, 16);
+    ret = ret && assert_equal_int(bignum_is_probab_prime(&n, NULL, 3, scratch), 1) &&
+          assert_equal_int(bignum_is_probab_prime(&n, NULL, 4, scratch), 0);
+
+    // Even numbers can't be tested by Miller-Rabin, small ones by trial division.
+    bignum_set_ui(&n, 4);
+    ret = ret && assert_equal_int(bignum_miller_rabin(&n, 2, scratch), -1) &&
+          assert_equal_int(bignum_is_probab_prime(&n, NULL, 10, scratch), 0);
+    bignum_set_ui(&n, 97);
+    return ret && assert_equal_int(bignum_is_probab_prime(&n, NULL, 10, scratch), 2);
+}
+
+/**
+ * @brief A Montgomery context set up again from a stored R^2 mod n
+ *        gives the same Miller-Rabin rounds.
+**/
+int test_miller_rabin_mont() {
+    bignum_t n;
+    bignum_mont_ctx_t ctx;
+    bignum_elem_t n_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t r2_elem[16 / BIGNUM_ELEM_SIZE];
+    bignum_elem_t scratch[BIGNUM_PRIME_SCRATCH(16 / BIGNUM_ELEM_SIZE)];
+    char psp23_hex[] = "14f5d5";    // 829 * 1657, a strong pseudoprime to 2 and 3
+
+    bignum_assoc(&n, n_elem, 16 / BIGNUM_ELEM_SIZE);
+    bignum_set_str(&n, psp23_hex, 16);
+
+    int ret = assert_equal_int(bignum_mont_init(&ctx, &n, scratch), 0);
+    for (size_t i=0; i<n.length; i++)
+        r2_elem[i] = scratch[i];
+    ret = ret && assert_equal_int(bignum_mont_assoc(&ctx, &n, r2_elem), 0) &&
+          assert_equal_int(bignum_miller_rabin_mont(&ctx, 2, scratch), 1) &&
+          assert_equal_int(bignum_miller_rabin_mont(&ctx, 3, scratch), 1) &&
+          assert_equal_int(bignum_miller_rabin_mont(&ctx, 5, scratch), 0) &&
+          assert_equal_int(bignum_miller_rabin(&n, 5, scratch), 0);
+
+    // 1 isn't tested, even moduli have no context.
+    bignum_set_ui(&n, 1);
+    ret = ret && assert_equal_int(bignum_mont_assoc(&ctx, &n, r2_elem), 0) &&
+          assert_equal_int(bignum_miller_rabin_mont(&ctx, 2, scratch), -1);
+    bignum_set_ui(&n, 6);
+    return ret && assert_equal_int(bignum_mont_assoc(&ctx, &n, r2_elem), -1);
+}